@@ -0,0 +1,165 @@
+#ifndef  BITMASK_INC
+#define  BITMASK_INC
+
+#include <cstdint>
+#include <cstddef>
+
+namespace sereno
+{
+    /** \brief  The word-level operations available to combine two bit masks */
+    enum BitmaskOp
+    {
+        BITMASK_OP_COPY   = 0, //this = other
+        BITMASK_OP_OR     = 1, //this = this | other
+        BITMASK_OP_AND    = 2, //this = this & other
+        BITMASK_OP_ANDNOT = 3, //this = this & ~other
+        BITMASK_OP_XOR    = 4  //this = this ^ other
+    };
+
+    /** \brief  Fixed-size bit mask. Bit x is stored in the byte x/8 at the bit x%8 (see data()), the layout used by volumetric masks.
+     * The storage is made of 64-bit words so that combinations, counts and searches handle 64 bits at once.
+     * The bits beyond size() are always 0 */
+    class Bitmask
+    {
+        public:
+            /** \brief  Constructor
+             * \param nbBits the number of bits of the mask
+             * \param value the initial value of all the bits */
+            Bitmask(size_t nbBits = 0, bool value = false);
+
+            /** \brief  Copy constructor
+             * \param copy the bit mask to copy */
+            Bitmask(const Bitmask& copy);
+
+            /** \brief  Movement constructor
+             * \param mvt the bit mask to move */
+            Bitmask(Bitmask&& mvt);
+
+            /** \brief  Destructor */
+            ~Bitmask();
+
+            /** \brief  Copy operator
+             * \param copy the bit mask to copy
+             * \return   *this */
+            Bitmask& operator=(const Bitmask& copy);
+
+            /** \brief  Movement operator
+             * \param mvt the bit mask to move
+             * \return   *this */
+            Bitmask& operator=(Bitmask&& mvt);
+
+            /** \brief  Change the number of bits of the mask. All the bits are reset
+             * \param nbBits the new number of bits
+             * \param value the value of all the bits */
+            void resize(size_t nbBits, bool value = false);
+
+            /** \brief  Set all the bits
+             * \param value the value to set */
+            void reset(bool value);
+
+            /** \brief  Get the number of bits of the mask
+             * \return   the number of bits */
+            size_t size() const {return m_nbBits;}
+
+            /** \brief  Get the number of bytes needed to store the mask, i.e., the size of data()
+             * \return   (size()+7)/8 */
+            size_t getNbBytes() const {return (m_nbBits+7)/8;}
+
+            /** \brief  Get the number of 64-bit words storing the mask, i.e., the size of getWords()
+             * \return   (size()+63)/64 */
+            size_t getNbWords() const {return (m_nbBits+63)/64;}
+
+            /** \brief  Get the mask as bytes. Bit x is stored in data()[x/8] at the bit x%8
+             * \return   the mask bytes. Size: getNbBytes() */
+            uint8_t* data() {return (uint8_t*)m_words;}
+
+            /** \brief  Get the mask as bytes. Bit x is stored in data()[x/8] at the bit x%8
+             * \return   the mask bytes. Size: getNbBytes() */
+            const uint8_t* data() const {return (const uint8_t*)m_words;}
+
+            /** \brief  Get the words storing the mask. The bit order inside a word depends on the platform endianness, only bitwise operations are portable
+             * \return   the mask words. Size: getNbWords() */
+            uint64_t* getWords() {return m_words;}
+
+            /** \brief  Get the words storing the mask. The bit order inside a word depends on the platform endianness, only bitwise operations are portable
+             * \return   the mask words. Size: getNbWords() */
+            const uint64_t* getWords() const {return m_words;}
+
+            /** \brief  Get a bit
+             * \param x the bit to get
+             * \return   the bit value */
+            bool get(size_t x) const {return data()[x/8] & (1 << (x%8));}
+
+            /** \brief  Set a bit. Not thread-safe if other threads modify bits of the same byte
+             * \param x the bit to modify
+             * \param b the value to set */
+            void set(size_t x, bool b)
+            {
+                if(b)
+                    data()[x/8] |= (1 << (x%8));
+                else
+                    data()[x/8] &= ~(1 << (x%8));
+            }
+
+            /** \brief  Set the bits [begin, end[
+             * \param begin the first bit to set
+             * \param end the last bit to set (excluded). Clamped to size()
+             * \param value the value to set */
+            void setRange(size_t begin, size_t end, bool value);
+
+            /** \brief  Count the bits set to 1
+             * \return   the number of bits set to 1 */
+            size_t count() const;
+
+            /** \brief  Is any bit set to 1?
+             * \return   true if at least one bit is set to 1, false otherwise */
+            bool any() const;
+
+            /** \brief  Are all the bits set to 1?
+             * \return   true if all the bits are set to 1 (or if the mask is empty), false otherwise */
+            bool all() const;
+
+            /** \brief  Are all the bits set to 0?
+             * \return   !any() */
+            bool none() const {return !any();}
+
+            /** \brief  Combine another bit mask with this one, 64 bits at a time
+             * \param other the mask to combine with. If the sizes differ, only the min(size(), other.size()) first bits are combined
+             * \param op the operation to apply */
+            void combine(const Bitmask& other, BitmaskOp op) {combine(other.data(), other.size(), op);}
+
+            /** \brief  Combine a raw bit mask (same layout as data()) with this one, 64 bits at a time
+             * \param other the mask to combine with. Size: (nbBits+7)/8. No alignment is required
+             * \param nbBits the number of bits of other. Only the min(size()-offset, nbBits) first bits are combined
+             * \param op the operation to apply
+             * \param offset the bit of this mask matching the first bit of other. Must be a multiple of 64 */
+            void combine(const uint8_t* other, size_t nbBits, BitmaskOp op, size_t offset = 0);
+
+            /** \brief  Find the first bit set to 1 in [from, end[
+             * \param from the first bit to look at
+             * \param end the last bit to look at (excluded). Clamped to size()
+             * \return   the position of the bit found, or min(end, size()) if none */
+            size_t findNext(size_t from, size_t end = SIZE_MAX) const;
+
+            /** \brief  Call a function on each bit set to 1 in [begin, end[, in increasing order. Words set to 0 are skipped at once
+             * \param begin the first bit to look at
+             * \param end the last bit to look at (excluded). Clamped to size()
+             * \param func the function to call: func(size_t bitID) */
+            template <typename Func>
+            void forEachSet(size_t begin, size_t end, const Func& func) const
+            {
+                if(end > m_nbBits)
+                    end = m_nbBits;
+                for(size_t x = findNext(begin, end); x < end; x = findNext(x+1, end))
+                    func(x);
+            }
+        private:
+            /** \brief  Set to 0 the bits of the last word beyond size() */
+            void clearTail();
+
+            uint64_t* m_words  = NULL; /*!< The mask storage*/
+            size_t    m_nbBits = 0;    /*!< The number of bits*/
+    };
+}
+
+#endif
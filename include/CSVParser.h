@@ -6,6 +6,7 @@
 #include <vector>
 #include <iostream>
 #include <string>
+#include <string_view>
 
 //This code was adapted from https://stackoverflow.com/questions/1120140/how-can-i-read-and-parse-csv-files-in-c
 
@@ -17,6 +18,36 @@
  * \return  the list of tokens as a string */
 std::vector<std::string> getCSVLineTokens(std::istream& str, char separator=',');
 
+/** \brief  Read the tokens of the CSV row starting at "begin" in an in-memory buffer (e.g., a memory-mapped file). Rows without quotes are split with memchr
+ * and their tokens are views on the buffer. Quoted rows are parsed as getCSVLineTokens does, their tokens being unescaped in "scratch".
+ *
+ * \param begin the first character of the row
+ * \param end the end of the buffer
+ * \param tokens[out] the tokens of the row. Empty for blank rows. The views are valid until the buffer or scratch are modified
+ * \param scratch[out] the storage of the unescaped tokens
+ * \param separator the separator to use
+ *
+ * \return  the first character of the next row, or end */
+const char* getCSVRowTokens(const char* begin, const char* end, std::vector<std::string_view>& tokens, std::string& scratch, char separator=',');
+
+/** \brief  Split a CSV buffer into ranges of rows of similar sizes, e.g., to parse them concurrently. Newlines inside quoted strings do not split rows
+ *
+ * \param begin the beginning of the buffer. It must be the beginning of a row outside any quoted string
+ * \param end the end of the buffer
+ * \param nbRanges the maximum number of ranges. Ranges are at least 1 MB long
+ *
+ * \return  the boundaries of the ranges: range i is [result[i], result[i+1][. Each boundary is the beginning of a row.
+ * This function does not lock ompMutex (see sciVisUtils.h): the caller must hold it when OpenMP is enabled */
+std::vector<const char*> splitCSVRows(const char* begin, const char* end, size_t nbRanges);
+
+/** \brief  Find the end of the complete rows of a CSV buffer, e.g., to leave aside a row still being written
+ *
+ * \param begin the beginning of the buffer. It must be the beginning of a row outside any quoted string
+ * \param end the end of the buffer
+ *
+ * \return  the position following the last newline outside any quoted string, begin if there is none */
+const char* getCSVCompleteRowsEnd(const char* begin, const char* end);
+
 
 /** \brief  Represent a CSV row */
 class CSVRow
@@ -0,0 +1,224 @@
+#ifndef  COMPRESSEDBITMASK_INC
+#define  COMPRESSEDBITMASK_INC
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include "Bitmask.h"
+
+namespace sereno
+{
+    /** \brief  Bit mask compressed per chunk of CHUNK_BITS bits, in the spirit of roaring bitmaps (Chambi et al., "Better bitmap performance with Roaring bitmaps", 2016).
+     * Each chunk is stored in the smallest of the following containers:
+     *   - empty (no bit set) or full (all bits set): no storage,
+     *   - array: the sorted positions of the bits set, for sparse chunks (up to ARRAY_MAX_SIZE bits set),
+     *   - bitmap: the CHUNK_BITS bits, same layout as Bitmask::data().
+     * Containers are shared between copies until modified, so that copying a mask only copies the chunk descriptors */
+    class CompressedBitmask
+    {
+        public:
+            static const size_t CHUNK_BITS     = 1 << 16; /*!< The number of bits per chunk*/
+            static const size_t ARRAY_MAX_SIZE = 4096;    /*!< The maximum number of bits set of an array chunk. Beyond, an array takes more memory than a bitmap*/
+
+            /** \brief  Constructor
+             * \param nbBits the number of bits of the mask
+             * \param value the initial value of all the bits */
+            CompressedBitmask(size_t nbBits = 0, bool value = false);
+
+            /** \brief  Constructor, compressing a dense bit mask
+             * \param mask the bit mask to compress */
+            CompressedBitmask(const Bitmask& mask);
+
+            /** \brief  Replace the content of this mask by the compressed content of a dense bit mask
+             * \param mask the bit mask to compress */
+            void assign(const Bitmask& mask);
+
+            /** \brief  Change the number of bits of the mask. All the bits are reset
+             * \param nbBits the new number of bits
+             * \param value the value of all the bits */
+            void resize(size_t nbBits, bool value = false);
+
+            /** \brief  Set all the bits
+             * \param value the value to set */
+            void reset(bool value);
+
+            /** \brief  Get the number of bits of the mask
+             * \return   the number of bits */
+            size_t size() const {return m_nbBits;}
+
+            /** \brief  Get the number of chunks
+             * \return   (size()+CHUNK_BITS-1)/CHUNK_BITS */
+            size_t getNbChunks() const {return m_chunks.size();}
+
+            /** \brief  Get a bit
+             * \param x the bit to get
+             * \return   the bit value */
+            bool get(size_t x) const;
+
+            /** \brief  Set a bit. The chunk containing x is converted to another container if needed
+             * \param x the bit to modify
+             * \param b the value to set */
+            void set(size_t x, bool b);
+
+            /** \brief  Count the bits set to 1
+             * \return   the number of bits set to 1 */
+            size_t count() const;
+
+            /** \brief  Is any bit set to 1?
+             * \return   true if at least one bit is set to 1, false otherwise */
+            bool any() const;
+
+            /** \brief  Find the first bit set to 1 in [from, end[. Empty chunks are skipped at once
+             * \param from the first bit to look at
+             * \param end the last bit to look at (excluded). Clamped to size()
+             * \return   the position of the bit found, or min(end, size()) if none */
+            size_t findNext(size_t from, size_t end = SIZE_MAX) const;
+
+            /** \brief  Call a function on each maximal range of bits set to 1 in [begin, end[, in increasing order
+             * \param begin the first bit to look at
+             * \param end the last bit to look at (excluded). Clamped to size()
+             * \param func the function to call: func(size_t rangeBegin, size_t rangeEnd), rangeEnd being excluded */
+            template <typename Func>
+            void forEachRange(size_t begin, size_t end, const Func& func) const
+            {
+                if(end > m_nbBits)
+                    end = m_nbBits;
+
+                //Ranges are reported once complete, so that ranges spanning several chunks are merged
+                size_t pendingBegin = 0, pendingEnd = 0;
+                auto   push = [&](size_t b, size_t e)
+                {
+                    if(b == pendingEnd && pendingEnd != pendingBegin)
+                        pendingEnd = e;
+                    else
+                    {
+                        if(pendingEnd != pendingBegin)
+                            func(pendingBegin, pendingEnd);
+                        pendingBegin = b;
+                        pendingEnd   = e;
+                    }
+                };
+
+                for(size_t c = begin/CHUNK_BITS; c*CHUNK_BITS < end; c++)
+                    chunkRanges(c, begin, end, push);
+                if(pendingEnd != pendingBegin)
+                    func(pendingBegin, pendingEnd);
+            }
+
+            /** \brief  Combine this mask with a dense bit mask: target = target op this. Empty and full chunks are applied without being expanded
+             * \param target the dense mask to modify. If the sizes differ, only the min(size(), target.size()) first bits are combined
+             * \param op the operation to apply */
+            void combineInto(Bitmask& target, BitmaskOp op) const;
+
+            /** \brief  Expand this mask into a dense bit mask
+             * \param output[out] the dense mask. It is resized to size() */
+            void toBitmask(Bitmask& output) const;
+
+            /** \brief  Get the number of bytes used by the mask (chunk descriptors and containers)
+             * \return   the memory size, in bytes */
+            size_t getMemorySize() const;
+        private:
+            /** \brief  The container types of a chunk */
+            enum ChunkType
+            {
+                CHUNK_EMPTY  = 0,
+                CHUNK_FULL   = 1,
+                CHUNK_ARRAY  = 2,
+                CHUNK_BITMAP = 3
+            };
+
+            /** \brief  A chunk descriptor */
+            struct Chunk
+            {
+                ChunkType type        = CHUNK_EMPTY; /*!< The container type*/
+                uint32_t  cardinality = 0;           /*!< The number of bits set*/
+                std::shared_ptr<std::vector<uint16_t>> array;  /*!< The sorted positions of the bits set (CHUNK_ARRAY)*/
+                std::shared_ptr<std::vector<uint64_t>> bitmap; /*!< The chunk bits (CHUNK_BITMAP). Size: CHUNK_BITS/64 words*/
+            };
+
+            /** \brief  Get the number of bits of a chunk. Only the last chunk may be smaller than CHUNK_BITS
+             * \param c the chunk ID
+             * \return   the number of bits of the chunk c */
+            size_t getChunkSize(size_t c) const {return (c+1)*CHUNK_BITS <= m_nbBits ? CHUNK_BITS : m_nbBits - c*CHUNK_BITS;}
+
+            /** \brief  Set a chunk to empty or full
+             * \param chunk the chunk to modify
+             * \param c the chunk ID
+             * \param value true to set full, false to set empty */
+            void setUniform(Chunk& chunk, size_t c, bool value);
+
+            /** \brief  Expand a chunk into its bitmap representation
+             * \param c the chunk ID
+             * \param words[out] the chunk bits, same layout as Bitmask::data(). Size: CHUNK_BITS/64 words. The bits beyond the chunk size are set to 0 */
+            void expandChunk(size_t c, uint64_t* words) const;
+
+            /** \brief  Report the ranges of bits set to 1 of a chunk intersecting [begin, end[
+             * \param c the chunk ID
+             * \param begin the first bit to look at
+             * \param end the last bit to look at (excluded), <= size()
+             * \param push the function to call: push(size_t rangeBegin, size_t rangeEnd) */
+            template <typename Func>
+            void chunkRanges(size_t c, size_t begin, size_t end, const Func& push) const
+            {
+                const Chunk& chunk = m_chunks[c];
+                const size_t base  = c*CHUNK_BITS;
+                const size_t first = (begin > base ? begin - base : 0);
+                const size_t last  = (end - base < getChunkSize(c) ? end - base : getChunkSize(c));
+
+                switch(chunk.type)
+                {
+                    case CHUNK_FULL:
+                        push(base+first, base+last);
+                        break;
+                    case CHUNK_ARRAY:
+                    {
+                        const std::vector<uint16_t>& array = *chunk.array;
+                        for(size_t i = 0; i < array.size(); i++)
+                        {
+                            if(array[i] < first)
+                                continue;
+                            if(array[i] >= last)
+                                break;
+                            size_t j = i+1;
+                            while(j < array.size() && array[j] == array[j-1]+1 && array[j] < last)
+                                j++;
+                            push(base+array[i], base+array[j-1]+1);
+                            i = j-1;
+                        }
+                        break;
+                    }
+                    case CHUNK_BITMAP:
+                    {
+                        const uint64_t* words = chunk.bitmap->data();
+                        const uint8_t*  bytes = (const uint8_t*)words;
+                        auto bit = [bytes](size_t x) {return (bytes[x/8] >> (x%8)) & 1;};
+
+                        size_t x = first;
+                        while(x < last)
+                        {
+                            //Skip the cleared bits, whole words at once
+                            while(x < last && !bit(x))
+                                x = (x%64 == 0 && words[x/64] == 0 ? x+64 : x+1);
+                            if(x >= last)
+                                break;
+
+                            //Extend over the bits set, whole words at once
+                            size_t rangeBegin = x;
+                            while(x < last && bit(x))
+                                x = (x%64 == 0 && x+64 <= last && words[x/64] == ~(uint64_t)0 ? x+64 : x+1);
+                            push(base+rangeBegin, base+(x < last ? x : last));
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+            }
+
+            std::vector<Chunk> m_chunks;     /*!< The chunks*/
+            size_t             m_nbBits = 0; /*!< The number of bits*/
+    };
+}
+
+#endif
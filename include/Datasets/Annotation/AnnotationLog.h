@@ -4,11 +4,24 @@
 #include <vector>
 #include <string>
 #include <utility>
+#include <iterator>
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
 #include <CSVParser.h>
 
 namespace sereno
 {
-    /** \brief  Basic class storing annotations from log. This has to be combined with AnnotationPosition for example to be useful */
+    /** \brief  The storage types of an AnnotationLog column, detected at parsing */
+    enum AnnotationLogColumnType
+    {
+        ANNOTATION_LOG_COLUMN_FLOAT  = 0, //Numbers with at most 6 (FLT_DIG) significant digits, stored as float without loss
+        ANNOTATION_LOG_COLUMN_DOUBLE = 1, //Other numbers, stored as double
+        ANNOTATION_LOG_COLUMN_STRING = 2  //At least one value is not a number. Values are stored in a character arena
+    };
+
+    /** \brief  Basic class storing annotations from log. This has to be combined with AnnotationPosition for example to be useful.
+     * Values are stored per column: numeric columns are contiguous float/double arrays, the other columns are strings stored one after the other in an arena */
     class AnnotationLog
     {
         /**
@@ -21,64 +34,114 @@ namespace sereno
         static int32_t indiceFromHeader(const std::vector<std::string>& headers, const std::string& header);
 
         public:
-            /** \brief  A class corresponding to a row. This object should not outlive the AnnotationLog it is attached to */
+            /** \brief  A view on a row. This object should not outlive the AnnotationLog it is attached to */
             class LogEntry
             {
                 public:
-                    /** \brief  Constructor
-                     *
-                     * \param values the values of this row log
-                     * \param header a pointer to the header if the header exists. NULL otherwise
-                     */
-                    LogEntry(const std::vector<std::string>& values, const std::vector<std::string>* header=NULL) : m_values(values), m_header(header) {}
+                    /** \brief  Iterator over the values of a row, formatted as strings (see operator[](uint32_t)) */
+                    class const_iterator
+                    {
+                        public:
+                            typedef std::input_iterator_tag iterator_category;
+                            typedef std::string             value_type;
+                            typedef std::ptrdiff_t          difference_type;
+                            typedef const std::string*      pointer;
+                            typedef const std::string&      reference;
+
+                            /** \brief  Constructor
+                             * \param log the log containing the row
+                             * \param row the row indice
+                             * \param col the column the iterator points to */
+                            const_iterator(const AnnotationLog* log, uint32_t row, uint32_t col) : m_log(log), m_row(row), m_col(col) {}
+
+                            /** \brief  Get the pointed value. The reference is valid until the iterator is modified or destroyed */
+                            reference operator*() const {m_value = m_log->getString(m_row, m_col); return m_value;}
+                            pointer   operator->() const {return &**this;}
+
+                            const_iterator& operator++()    {m_col++; return *this;}
+                            const_iterator  operator++(int) {const_iterator it = *this; m_col++; return it;}
+
+                            bool operator==(const const_iterator& it) const {return m_col == it.m_col && m_row == it.m_row && m_log == it.m_log;}
+                            bool operator!=(const const_iterator& it) const {return !(*this == it);}
+                        private:
+                            const AnnotationLog* m_log;   /*!< The log containing the row*/
+                            uint32_t             m_row;   /*!< The row indice*/
+                            uint32_t             m_col;   /*!< The pointed column*/
+                            mutable std::string  m_value; /*!< The last dereferenced value*/
+                    };
 
-                    /** \brief  Move Constructor
+                    /** \brief  Constructor
                      *
-                     * \param values the values of this row log
-                     * \param header a pointer to the header if the header exists. NULL otherwise */
-                    LogEntry(std::vector<std::string>&& values, const std::vector<std::string>* header=NULL) : m_values(values), m_header(header) {}
+                     * \param log the log containing the row
+                     * \param row the row indice */
+                    LogEntry(const AnnotationLog* log, uint32_t row) : m_log(log), m_row(row) {}
 
                     /** \brief  Get the number of stored values
                      * \return  The number of stored values */
-                    size_t size()                          const {return m_values.size();}
-
+                    size_t size()                          const {return m_log->getNbColumns();}
 
                     /** \brief  Is this row associated to a header?
                      * \return   true if yes, false otherwise */
-                    bool   hasHeader()                     const {return m_header;}
+                    bool   hasHeader()                     const {return m_log->hasHeader();}
 
                     /** \brief  Does the header "h" exist?
                      * \return   true if yes, false otherwise */
-                    bool   hasHeader(const std::string& h) const {return hasHeader() && AnnotationLog::indiceFromHeader(*m_header, h) >= 0;}
+                    bool   hasHeader(const std::string& h) const {return m_log->hasHeader(h);}
 
-                    /** \brief  Access the string value at "index". hasHeader(index) should return true, or this function has an undefined behavior.
+                    /** \brief  Get the value at "index" as a string. hasHeader(index) should return true, or this function has an undefined behavior.
                      * \param index the header to look after
-                     * \return   a const reference string value corresponding at the position "index" as defined by the header*/
-                    const std::string& operator[](const std::string& index) const;
+                     * \return   the string value corresponding at the position "index" as defined by the header*/
+                    std::string operator[](const std::string& index) const {return m_log->getString(m_row, m_log->indiceFromHeader(index));}
 
-                    /** \brief  Access the string value at "index". hasHeader(index) should return true, or this function has an undefined behavior.
-                     * \param index the header to look after
-                     * \return   a reference string value corresponding at the position "index" as defined by the header*/
-                    std::string& operator[](const std::string& index) {return const_cast<std::string&>(std::as_const(*this)[index]);}
+                    /** \brief Get the value at index "i" as a string. Numbers are formatted back with the fewest digits reading the same value
+                     * \param i the column position to look after
+                     * \return the string value corresponding at the position "i" in the row*/
+                    std::string operator[](uint32_t i) const {return m_log->getString(m_row, i);}
 
-                    /** \brief Access the string value at index "i". 
+                    /** \brief Get the value at index "i" as a float. See AnnotationLog::getFloat
                      * \param i the column position to look after
-                     * \return a const reference string value corresponding at the position "i" in the row*/
-                    const std::string& operator[](uint32_t i) const;
+                     * \return the float value corresponding at the position "i" in the row*/
+                    float  getFloat(uint32_t i)  const {return m_log->getFloat(m_row, i);}
 
-                    /** \brief Access the string value at index "i". 
+                    /** \brief Get the value at index "i" as a double. See AnnotationLog::getDouble
                      * \param i the column position to look after
-              {       * \return a reference string value corresponding at the position "i" in the row*/
-                    std::string& operator[](uint32_t i) {return const_cast<std::string&>(std::as_const(*this)[i]);}
+                     * \return the double value corresponding at the position "i" in the row*/
+                    double getDouble(uint32_t i) const {return m_log->getDouble(m_row, i);}
 
-                    std::vector<std::string>::iterator begin() {return m_values.begin();}
-                    std::vector<std::string>::iterator end()   {return m_values.end();}
+                    const_iterator begin() const {return const_iterator(m_log, m_row, 0);}
+                    const_iterator end()   const {return const_iterator(m_log, m_row, size());}
+                private:
+                    const AnnotationLog* m_log; /*!< The log containing the row*/
+                    uint32_t             m_row; /*!< The row indice*/
+            };
 
-                    std::vector<std::string>::const_iterator begin() const {return m_values.begin();}
-                    std::vector<std::string>::const_iterator end()   const {return m_values.end();}
+            /** \brief  Iterator over the rows of a log, yielding LogEntry views */
+            class const_iterator
+            {
+                public:
+                    typedef std::input_iterator_tag iterator_category;
+                    typedef LogEntry                value_type;
+                    typedef std::ptrdiff_t          difference_type;
+                    typedef const LogEntry*         pointer;
+                    typedef const LogEntry&         reference;
+
+                    /** \brief  Constructor
+                     * \param log the log to browse
+                     * \param row the row the iterator points to */
+                    const_iterator(const AnnotationLog* log, uint32_t row) : m_entry(log, row), m_log(log), m_row(row) {}
+
+                    reference operator*()  const {return m_entry;}
+                    pointer   operator->() const {return &m_entry;}
+
+                    const_iterator& operator++()    {m_entry = LogEntry(m_log, ++m_row); return *this;}
+                    const_iterator  operator++(int) {const_iterator it = *this; ++(*this); return it;}
+
+                    bool operator==(const const_iterator& it) const {return m_row == it.m_row && m_log == it.m_log;}
+                    bool operator!=(const const_iterator& it) const {return !(*this == it);}
                 private:
-                    std::vector<std::string>        m_values;
-                    const std::vector<std::string>* m_header;
+                    LogEntry             m_entry; /*!< The view on the pointed row*/
+                    const AnnotationLog* m_log;   /*!< The browsed log*/
+                    uint32_t             m_row;   /*!< The pointed row*/
             };
         public:
             /** \brief  Initialize the Log reading
@@ -98,17 +161,12 @@ namespace sereno
 
             /** \brief  The number of stored rows
              * \return  The number of rows */
-            uint32_t size() const {return m_values.size();}
+            uint32_t size() const {return m_nbRows;}
 
             /** \brief  Access the i-th row
              * \param i the row indice to look after
-             * \return   a const reference to a LogEntry representing the i-th row*/
-            const LogEntry& operator[](uint32_t i) const {return m_values[i];}
-
-            /** \brief  Access the i-th row
-             * \param i the row indice to look after
-             * \return   a reference to a LogEntry representing the i-th row*/
-            LogEntry&       operator[](uint32_t i)       {return m_values[i];}
+             * \return   a LogEntry viewing the i-th row*/
+            LogEntry operator[](uint32_t i) const {return LogEntry(this, i);}
 
             /** \brief  Try to find the column indice corresponding to the header h
              * \param h the header to look after
@@ -120,9 +178,52 @@ namespace sereno
              * \return   true if success, false otherwise. A message is printed in std::cerr in case of errors */
             bool readFromCSV(const std::string& path);
 
+            /** \brief  Initialize the logs from a csv file, using a binary cache of the parsed values. The cache is read if it was written from the same file
+             * (same size, modification time, and content at its beginning and end). Otherwise, the file is parsed and the cache is written
+             * \param path the file to read
+             * \param cachePath the binary cache of the file, e.g., path + ".cache"
+             * \return   true if success, false otherwise. A message is printed in std::cerr in case of errors. Failing to write the cache is not an error */
+            bool readFromCSV(const std::string& path, const std::string& cachePath);
+
+            /** \brief  Initialize the logs from a binary cache written by writeBinaryCache
+             * \param path the csv file the cache was written from
+             * \param cachePath the binary cache to read
+             * \return   false if the cache cannot be read or was not written from the current content of path (the log is then not modified), true otherwise */
+            bool readBinaryCache(const std::string& path, const std::string& cachePath);
+
+            /** \brief  Write the stored values in a binary cache. Cache format (native endianness, as caches are not meant to be exchanged between machines):
+             *   - header: the magic "SVANNLOG", the format version, the size, the modification time, and a hash of the beginning and end of the csv file,
+             *   - hasHeader, the number of rows, the number of columns, and the headers,
+             *   - per column: its type and its values (floats, doubles, or the characters and offsets of the strings).
+             *   Arrays are prefixed by their size in bytes and padded to 8 bytes, so that they can be read in place from a memory mapping
+             * \param path the csv file the values were read from
+             * \param cachePath the binary cache to write
+             * \return   true if success, false otherwise */
+            bool writeBinaryCache(const std::string& path, const std::string& cachePath) const;
+
+            /** \brief  Initialize the logs from a csv file still being written, e.g., during a live experiment. Only the complete rows (ending with a newline) are read.
+             * Call then updateFromCSV() regularly to read the rows appended since
+             * \param path the file to read
+             * \return   true if success, false otherwise. A message is printed in std::cerr in case of errors */
+            bool followCSV(const std::string& path);
+
+            /** \brief  Read the complete rows appended to the file followed with followCSV() since the last call. Only the new bytes are read and parsed, and onAppendRows() is called.
+             * If the file became smaller (e.g., it was rewritten), it is entirely read again, keeping the time column if it still exists, and onParse() is called
+             * \return   false if no file is followed or if the new rows are invalid (they are then not stored, and are parsed again at the next call), true otherwise */
+            bool updateFromCSV();
+
+            /** \brief  Is a file followed? See followCSV()
+             * \return   true if yes, false otherwise */
+            bool isFollowingCSV() const {return m_follow;}
+
             /** \brief  What to do once being parsed? */
             virtual void onParse() {};
 
+            /** \brief  What to do once rows were appended by updateFromCSV()?
+             * \param firstRow the first appended row
+             * \param nbRows the number of appended rows */
+            virtual void onAppendRows(uint32_t firstRow, uint32_t nbRows) {};
+
             /** \brief  Set the column indice where time is expected. Negative values == no expected time
              * \param timeCol the time column indice. Negatif values for no expected time
              * \return   return false in case of an invalid time column: No values were entered (and timeCol is positive), or timeCol is outside the number of columns of this annotation.  */
@@ -145,21 +246,97 @@ namespace sereno
              * \return  The headers associated with this CSV */
             const std::vector<std::string>& getHeaders() const {return m_header;}
 
-            /** \brief  Get the values corresponding to the "time" column, as defined by "setTimeInd". The time column is parsed at each call, so it is better to save the results if needed
+            /** \brief  Get the values corresponding to the "time" column, as defined by "setTimeInd".
              * \return  the values corresponding to the "time" column.*/
             std::vector<float> getTimeValues() const;
 
-            std::vector<LogEntry>::iterator begin() {return m_values.begin();}
-            std::vector<LogEntry>::iterator end()   {return m_values.end();}
-
-            std::vector<LogEntry>::const_iterator begin() const {return m_values.begin();}
-            std::vector<LogEntry>::const_iterator end()   const {return m_values.end();}
+            const_iterator begin() const {return const_iterator(this, 0);}
+            const_iterator end()   const {return const_iterator(this, m_nbRows);}
+
+            /** \brief  Get the storage type of a column
+             * \param col the column indice. Must be lower than getNbColumns()
+             * \return   the type of the column */
+            AnnotationLogColumnType getColumnType(uint32_t col) const {return m_columns[col].type;}
+
+            /** \brief  Get the values of a ANNOTATION_LOG_COLUMN_FLOAT column
+             * \param col the column indice
+             * \return   the size() values of the column, NULL if the column is not stored as float */
+            const float*  getFloatColumn(uint32_t col) const;
+
+            /** \brief  Get the values of a ANNOTATION_LOG_COLUMN_DOUBLE column
+             * \param col the column indice
+             * \return   the size() values of the column, NULL if the column is not stored as double */
+            const double* getDoubleColumn(uint32_t col) const;
+
+            /** \brief  Get a value as a float. Numeric columns are read without any parsing, string values are parsed (0 if they are not numbers)
+             * \param row the row indice
+             * \param col the column indice
+             * \return   the value */
+            float  getFloat(uint32_t row, uint32_t col) const {return (float)getDouble(row, col);}
+
+            /** \brief  Get a value as a double. Numeric columns are read without any parsing, string values are parsed (0 if they are not numbers)
+             * \param row the row indice
+             * \param col the column indice
+             * \return   the value */
+            double getDouble(uint32_t row, uint32_t col) const
+            {
+                const Column& c = m_columns[col];
+                switch(c.type)
+                {
+                    case ANNOTATION_LOG_COLUMN_FLOAT:
+                        return c.floats[row];
+                    case ANNOTATION_LOG_COLUMN_DOUBLE:
+                        return c.doubles[row];
+                    default:
+                        return atof(&c.chars[c.offsets[row]]);
+                }
+            }
+
+            /** \brief  Get a value as a string. Numbers are formatted with the fewest digits reading the same value
+             * \param row the row indice
+             * \param col the column indice
+             * \return   the value */
+            std::string getString(uint32_t row, uint32_t col) const;
+
+            /** \brief  Get the number of bytes used to store the values
+             * \return   the memory size of the columns */
+            size_t getMemorySize() const;
         protected:
+            /** \brief  The values of a column. Only the container corresponding to "type" is used */
+            struct Column
+            {
+                AnnotationLogColumnType type = ANNOTATION_LOG_COLUMN_STRING; /*!< The storage type*/
+                std::vector<float>      floats;  /*!< The values of ANNOTATION_LOG_COLUMN_FLOAT columns*/
+                std::vector<double>     doubles; /*!< The values of ANNOTATION_LOG_COLUMN_DOUBLE columns*/
+                std::vector<char>       chars;   /*!< The NULL-terminated values of ANNOTATION_LOG_COLUMN_STRING columns, one after the other*/
+                std::vector<uint32_t>   offsets; /*!< The offset in chars of each value*/
+            };
+
+            /** \brief  Parse CSV rows and append them to the columns. Ranges of rows are parsed concurrently, and the values of each column are parsed as numbers
+             * until a value is not a number. A column is stored as numbers only if all its values are numbers, float being used if no value has more
+             * significant digits than a float can hold
+             * \param begin the first row to read
+             * \param end the end of the rows to read
+             * \param size the expected number of columns, -1 if unknown. Ignored if rows are already stored
+             * \return   false if the rows do not have the same number of columns (the log is then not modified), true otherwise */
+            bool appendCSVRows(const char* begin, const char* end, int32_t size);
+
+            /** \brief  Read a CSV file, replacing the stored values
+             * \param path the file to read
+             * \param follow true to read only the complete rows and remember where the reading stopped (see followCSV()), false to read the whole file
+             * \param keepTime true to keep the time column if it still exists (e.g., when a followed file is rewritten), false to reset it
+             * \return   true if success, false otherwise */
+            bool parseCSVFile(const std::string& path, bool follow, bool keepTime);
+
             bool m_hasHeader;
             bool m_hasRead = false;
             std::vector<std::string> m_header;
-            std::vector<LogEntry>    m_values;
+            std::vector<Column>      m_columns;
+            uint32_t                 m_nbRows = 0;
             int32_t                  m_timeIT = -1;
+            bool                     m_follow = false;     /*!< Is m_followPath followed?*/
+            std::string              m_followPath;         /*!< The path of the followed file*/
+            uint64_t                 m_followOffset = 0;   /*!< The offset in the followed file of the first row not read yet*/
     };
 }
 
@@ -18,6 +18,12 @@ namespace sereno
              * \param component the component calling this method
              * \param oldHeaders the old component's headers*/
             virtual void onUpdateHeaders(AnnotationLogComponent* component, const std::vector<int32_t>& oldHeaders) = 0;
+
+            /** \brief  Method to call when rows were appended to the annotation log the component reads, e.g., when following a file being written
+             * \param component the component calling this method
+             * \param firstRow the first appended row
+             * \param nbRows the number of appended rows */
+            virtual void onAppendRows(AnnotationLogComponent* component, uint32_t firstRow, uint32_t nbRows) {}
     };
 
     /** \brief  Describe an annotation component from log */
@@ -48,6 +54,15 @@ namespace sereno
             /** \brief  Get the headers this component is using
              * \return   The headers ID this component consumes*/
             virtual std::vector<int32_t> getHeaders() const {return {};}
+
+            /** \brief  Notify the listeners that rows were appended to the annotation log. This is called by the object owning the log once the new rows are stored
+             * \param firstRow the first appended row
+             * \param nbRows the number of appended rows */
+            void notifyAppendRows(uint32_t firstRow, uint32_t nbRows)
+            {
+                for(auto it : m_listeners)
+                    it->onAppendRows(this, firstRow, nbRows);
+            }
         protected:
             void callOnUpdateHeaders(const std::vector<int32_t>& oldHeaders) 
             {
@@ -3,6 +3,9 @@
 
 #include "Datasets/Annotation/AnnotationLog.h"
 #include "Datasets/Annotation/AnnotationPosition.h"
+#include "Datasets/Annotation/AnnotationPositionIndex.h"
+#include "TransferFunction/TransferFunction.h"
+#include "ColorMode.h"
 #include <map>
 #include <memory>
 #include <vector>
@@ -18,6 +21,18 @@ namespace sereno
     class AnnotationLogContainer : public AnnotationLog, public AnnotationLogComponentListener
     {
         public:
+            /** \brief  A range of positions in the time order: the rows getTimeSortedRow(begin), ..., getTimeSortedRow(end-1).
+             * If isTimeSorted() is true, these positions are directly row indices */
+            struct TimeSpan
+            {
+                uint32_t begin = 0; /*!< The first position*/
+                uint32_t end   = 0; /*!< The position following the last one*/
+
+                /** \brief  Get the number of rows of the span
+                 * \return   end-begin */
+                uint32_t size() const {return end-begin;}
+            };
+
             /** \brief  Initialize the Log reading
              * \param header should we expect a header when reading data?  */
             AnnotationLogContainer(bool header=true) : AnnotationLog(header) {}
@@ -39,19 +54,54 @@ namespace sereno
              * \param annot the view to remove */
             void removeAnnotationPosition(std::shared_ptr<AnnotationPosition> annot);
 
-            /** \brief  Get a map of all the registered annotation position and the associated read position.
+            /** \brief  Get a map of all the registered annotation position and the associated read position. The positions of all the views are built if needed.
+             * Views reading the same columns share the same positions
              * \return   all the parsed annotation positions and the corresponding positions.*/
-            const std::map<std::shared_ptr<AnnotationPosition>, std::vector<glm::vec3>>& getAnnotationPositions() const {return m_positions;}
+            const std::map<std::shared_ptr<AnnotationPosition>, std::shared_ptr<std::vector<glm::vec3>>>& getAnnotationPositions() const;
 
-            /** \brief  Get the positions to use from an AnnotationPosition view.
+            /** \brief  Get the positions to use from an AnnotationPosition view. The positions are built at the first call following a change of the view's headers,
+             * and are shared with the other views reading the same columns: they can be uploaded once for all these views
              * \param annot the view to look after
              * \return   the associated 3D positions. NULL if AnnotationPosition was not found  */
             const std::vector<glm::vec3>* getPositionsFromView(std::shared_ptr<AnnotationPosition> annot) const;
 
-            /** \brief  Get the positions to use from an AnnotationPosition view.
+            /** \brief  Get the positions to use from an AnnotationPosition view. Positions shared with other views are copied first, so that only this view is modified
              * \param annot the view to look after
              * \return   the associated 3D positions that can be modified. NULL if AnnotationPosition was not found  */
-            std::vector<glm::vec3>* getPositionsFromView(std::shared_ptr<AnnotationPosition> annot) {return const_cast<std::vector<glm::vec3>*>(std::as_const(*this).getPositionsFromView(annot));}
+            std::vector<glm::vec3>* getPositionsFromView(std::shared_ptr<AnnotationPosition> annot);
+
+            /** \brief  Get the spatial index of the positions of an AnnotationPosition view, e.g., for picking. The index is built at the first call following a change of the view's headers,
+             * and is updated with the rows appended by updateFromCSV(). Positions modified through the non-const getPositionsFromView() are indexed at the next call
+             * \param annot the view to look after
+             * \return   the spatial index, NULL if AnnotationPosition was not found */
+            std::shared_ptr<const AnnotationPositionIndex> getPositionIndex(std::shared_ptr<AnnotationPosition> annot) const;
+
+            /** \brief  Get the rows of an AnnotationPosition view whose position is inside an axis-aligned bounding box and whose time is inside [t0, t1].
+             * Depending on which one is the most selective, the time index or the spatial index is used first
+             * \param annot the view to look after
+             * \param minPos the minimum position of the box
+             * \param maxPos the maximum position of the box
+             * \param t0 the minimum time. Ignored if no time column is set
+             * \param t1 the maximum time. Ignored if no time column is set
+             * \param output[out] the rows are appended to this array, in no particular order */
+            void queryPositions(std::shared_ptr<AnnotationPosition> annot, const glm::vec3& minPos, const glm::vec3& maxPos, float t0, float t1, std::vector<uint32_t>& output) const;
+
+            /** \brief  Get the colors of all the rows of an AnnotationPosition view, mapping data columns through a transfer function. Column i, normalized by the range of its finite values,
+             * is the dimension i of the transfer function (missing dimensions and the gradient are 0). The colors are computed in parallel and are cached per view
+             * until the columns, the transfer function version (see TF::getVersion), or the rows change. Appended rows are computed alone if the column ranges did not change
+             * \param annot the view to look after
+             * \param indices the columns to map (e.g., DrawableAnnotationPosition::getMappedDataIndices())
+             * \param tf the transfer function to apply
+             * \return   the RGBA colors (one uint8_t per component) of the size() rows. NULL if AnnotationPosition was not found or if a column does not exist */
+            std::shared_ptr<const std::vector<uint8_t>> getMappedColors(std::shared_ptr<AnnotationPosition> annot, const std::vector<uint32_t>& indices, const TF& tf) const;
+
+            /** \brief  Get the colors of all the rows of an AnnotationPosition view, mapping a data column, normalized by the range of its finite values, through a color mode. Colors are opaque.
+             * See the transfer function version of this function for the caching behavior
+             * \param annot the view to look after
+             * \param column the column to map
+             * \param mode the color mode to apply
+             * \return   the RGBA colors (one uint8_t per component) of the size() rows. NULL if AnnotationPosition was not found or if the column does not exist */
+            std::shared_ptr<const std::vector<uint8_t>> getMappedColors(std::shared_ptr<AnnotationPosition> annot, uint32_t column, ColorMode mode) const;
 
             /** \brief  Get the headers that are already assigned
              * \return  The already assigned headers. The list is sorted. */
@@ -65,17 +115,84 @@ namespace sereno
              * \return   the time */
             const std::vector<float>& getParsedTime() const {return m_time;}
 
-            /** \brief  Get the stored time once parsed
+            /** \brief  Get the stored time once parsed. Call updateTimeIndex() once the values are modified
              * \return   the time */
             std::vector<float>& getParsedTime() {return m_time;}
 
+            /** \brief  Rebuild the time index from the parsed time. Called automatically when the time column changes */
+            void updateTimeIndex();
+
+            /** \brief  Are the rows already sorted by time? If true, positions in the time order are row indices
+             * \return   true if yes, false otherwise */
+            bool isTimeSorted() const {return m_timeOrder.empty();}
+
+            /** \brief  Get the row at a position in the time order. Rows having the same time keep their relative order, and rows with an invalid (NaN) time come last
+             * \param i the position in the time order. Must be lower than getParsedTime().size()
+             * \return   the row indice */
+            uint32_t getTimeSortedRow(uint32_t i) const {return m_timeOrder.empty() ? i : m_timeOrder[i];}
+
+            /** \brief  Get the rows whose time is in [t0, t1], in O(log n)
+             * \param t0 the minimum time
+             * \param t1 the maximum time
+             * \return   the span of the rows in the time order. Empty if there is no time column or if t1 < t0 */
+            TimeSpan getTimeSpan(float t0, float t1) const;
+
+            /** \brief  Get the row whose time is the nearest to t, in O(log n). On ties, the first row in the time order is returned
+             * \param t the time to look after
+             * \return   the row indice, -1 if no row has a valid time */
+            int32_t getNearestTimeRow(float t) const;
+
             virtual void onParse();
+
+            /** \brief  Extend the parsed time, the time index, and the positions of the registered views with the appended rows, and notify the listeners of these views
+             * \param firstRow the first appended row
+             * \param nbRows the number of appended rows */
+            virtual void onAppendRows(uint32_t firstRow, uint32_t nbRows);
             virtual bool setTimeInd(int32_t timeCol);
             virtual void onUpdateHeaders(AnnotationLogComponent* component, const std::vector<int32_t>& oldHeaders);
         private:
-            std::map<std::shared_ptr<AnnotationPosition>, std::vector<glm::vec3>> m_positions;
+            /** \brief  The cached colors of a view */
+            struct MappedColors
+            {
+                std::vector<uint32_t>                 indices;        /*!< The mapped columns*/
+                uint64_t                              tfVersion = 0;  /*!< The version of the transfer function applied, 0 if a color mode was applied*/
+                int32_t                               mode      = -1; /*!< The color mode applied, -1 if a transfer function was applied*/
+                std::vector<float>                    minVals;        /*!< The minimum finite value of each column*/
+                std::vector<float>                    maxVals;        /*!< The maximum finite value of each column*/
+                std::shared_ptr<std::vector<uint8_t>> colors;         /*!< The RGBA colors of the rows*/
+            };
+
+            /** \brief  Update the cached colors of a view
+             * @tparam ColorFunc the type of colorFunc
+             * \param annot the view
+             * \param indices the columns to map
+             * \param tfVersion the version of the transfer function to apply, 0 if a color mode is applied
+             * \param mode the color mode to apply, -1 if a transfer function is applied
+             * \param nbDims the number of dimensions of colorFunc's input. Must be at least indices.size()
+             * \param colorFunc the function computing a color: colorFunc(float* normalizedValues, uint8_t* rgba). normalizedValues has nbDims values in [0, 1]
+             * \return   the colors, NULL if a column does not exist */
+            template <typename ColorFunc>
+            std::shared_ptr<const std::vector<uint8_t>> updateMappedColors(std::shared_ptr<AnnotationPosition> annot, const std::vector<uint32_t>& indices, uint64_t tfVersion, int32_t mode,
+                                                                           uint32_t nbDims, const ColorFunc& colorFunc) const;
+
+            /** \brief  Get the positions of a registered view, building them if needed
+             * \param it the registered view in m_positions
+             * \return   the positions of the view */
+            const std::shared_ptr<std::vector<glm::vec3>>& getPositionBuffer(std::map<std::shared_ptr<AnnotationPosition>, std::shared_ptr<std::vector<glm::vec3>>>::iterator it) const;
+
+            /** \brief  Read the positions of rows from the columns of a view
+             * \param annot the view to read
+             * \param firstRow the first row to read. The rows [firstRow, size()[ are read
+             * \param positions[out] the buffer to append the positions to */
+            void readPositions(const AnnotationPosition& annot, uint32_t firstRow, std::vector<glm::vec3>& positions) const;
+
+            mutable std::map<std::shared_ptr<AnnotationPosition>, std::shared_ptr<std::vector<glm::vec3>>> m_positions; /*!< The registered views and their positions. NULL positions are built at their first use*/
+            mutable std::map<std::shared_ptr<AnnotationPosition>, std::shared_ptr<AnnotationPositionIndex>> m_positionIndices; /*!< The spatial indices of the views' positions, built at their first use*/
+            mutable std::map<std::shared_ptr<AnnotationPosition>, MappedColors> m_mappedColors; /*!< The cached colors of the views*/
             std::vector<uint32_t> m_assignedHeaders;
             std::vector<float>    m_time;
+            std::vector<uint32_t> m_timeOrder;       /*!< The rows stably sorted by time. Empty if m_time is already sorted*/
+            uint32_t              m_nbValidTime = 0; /*!< The number of rows whose time is not NaN. These rows come first in the time order*/
     };
 }
 
@@ -40,9 +40,7 @@ namespace sereno
                     {
                         int readPos = m_readPos + rhs;
                         if(readPos >= 0 && readPos < (int32_t)m_ann->size())
-                            return glm::vec3((m_xyzInd[0] > -1 ? std::stof((*m_ann)[m_readPos][m_xyzInd[0]]) : 0),
-                                             (m_xyzInd[1] > -1 ? std::stof((*m_ann)[m_readPos][m_xyzInd[1]]) : 0),
-                                             (m_xyzInd[2] > -1 ? std::stof((*m_ann)[m_readPos][m_xyzInd[2]]) : 0));
+                            return readAt(readPos);
 
                         return glm::vec3(-1, -1, -1);
                     }
@@ -86,13 +84,21 @@ namespace sereno
                     void readVal() 
                     {
                         if(m_readPos >= 0 && m_readPos < (int32_t)m_ann->size())
-                            m_pos = glm::vec3((m_xyzInd[0] > -1 ? std::stof((*m_ann)[m_readPos][m_xyzInd[0]]) : 0),
-                                              (m_xyzInd[1] > -1 ? std::stof((*m_ann)[m_readPos][m_xyzInd[1]]) : 0),
-                                              (m_xyzInd[2] > -1 ? std::stof((*m_ann)[m_readPos][m_xyzInd[2]]) : 0));
+                            m_pos = readAt(m_readPos);
                         if(m_readPos >= (int32_t)m_ann->size() || m_readPos < 0)
                             m_readPos = -1;
                     }
 
+                    /** \brief  Read the position of a row. Numeric columns are read without parsing
+                     * \param row the row to read. Must be valid
+                     * \return   the position of the row */
+                    glm::vec3 readAt(int32_t row) const
+                    {
+                        return glm::vec3((m_xyzInd[0] > -1 ? m_ann->getFloat(row, m_xyzInd[0]) : 0),
+                                         (m_xyzInd[1] > -1 ? m_ann->getFloat(row, m_xyzInd[1]) : 0),
+                                         (m_xyzInd[2] > -1 ? m_ann->getFloat(row, m_xyzInd[2]) : 0));
+                    }
+
                     const AnnotationLog* m_ann;
                     glm::ivec3     m_xyzInd;
                     int32_t        m_readPos;
@@ -148,6 +154,15 @@ namespace sereno
             /** \brief Does the same thing as getPosIndices, but return a std::vector for compatibility with motherclass
              * \return the X, Y, and Z headers */
             virtual std::vector<int32_t> getHeaders() const {return {m_xInd, m_yInd, m_zInd};}
+
+            /** \brief  Get the values of a position component directly from the columnar storage of the AnnotationLog, without any copy
+             * \param i the component to look after (0: x, 1: y, 2: z)
+             * \return   the m_ann->size() values of the component, NULL if the component is not read or if its column is not stored as float (see AnnotationLog::getFloatColumn) */
+            const float* getComponentValues(uint32_t i) const
+            {
+                int32_t col = (i == 0 ? m_xInd : (i == 1 ? m_yInd : m_zInd));
+                return (col >= 0 ? m_ann->getFloatColumn(col) : NULL);
+            }
         private:
             int32_t m_xInd = -1;
             int32_t m_yInd = -1;
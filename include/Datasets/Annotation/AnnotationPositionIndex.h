@@ -0,0 +1,122 @@
+#ifndef  ANNOTATIONPOSITIONINDEX_INC
+#define  ANNOTATIONPOSITIONINDEX_INC
+
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include <cfloat>
+
+namespace sereno
+{
+    /** \brief  Spatial index over annotation positions, for picking and proximity queries. Positions are hashed in a uniform grid whose cells are only stored if they contain positions,
+     * so that positions appended afterwards (e.g., when following a log being written) are indexed without rebuilding the whole index.
+     * An automatic cell size is chosen again, and the index rebuilt, each time the number of positions or an extent of their bounding box grows by a factor 4 */
+    class AnnotationPositionIndex
+    {
+        public:
+            /** \brief  Constructor. Index the current positions
+             * \param positions the positions to index. Point IDs are indices in this array. Non-finite positions are not indexed
+             * \param cellSize the size of the grid cells. If <= 0, it is chosen so that the cells contain about 8 positions on average */
+            AnnotationPositionIndex(std::shared_ptr<const std::vector<glm::vec3>> positions, float cellSize = 0.0f);
+
+            /** \brief  Index the positions appended to the indexed array since the last call (or since the construction). The whole index may be rebuilt (see the class description) */
+            void update();
+
+            /** \brief  Get the indexed positions
+             * \return   the indexed positions */
+            const std::shared_ptr<const std::vector<glm::vec3>>& getPositions() const {return m_positions;}
+
+            /** \brief  Get the number of positions looked at so far (the first getNbPoints() positions of getPositions())
+             * \return   the number of positions looked at */
+            uint32_t getNbPoints() const {return m_nbPoints;}
+
+            /** \brief  Get the size of the grid cells
+             * \return   the size of the cells. 0 if no cell size was chosen yet (no finite position was indexed) */
+            float getCellSize() const {return m_cellSize;}
+
+            /** \brief  Get all the positions contained in an axis-aligned bounding box
+             * \param minPos the minimum position of the box
+             * \param maxPos the maximum position of the box
+             * \param output[out] the point IDs contained in the box are appended to this array */
+            void queryAABB(const glm::vec3& minPos, const glm::vec3& maxPos, std::vector<uint32_t>& output) const;
+
+            /** \brief  Get all the positions contained in a sphere
+             * \param center the sphere center
+             * \param radius the sphere radius
+             * \param output[out] the point IDs contained in the sphere are appended to this array */
+            void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& output) const;
+
+            /** \brief  Get the position nearest to a point. The cells are browsed by growing shells around the point
+             * \param pos the point to look around
+             * \param maxDistance the maximum distance to look at
+             * \return   the point ID, -1 if no position is within maxDistance */
+            int64_t queryNearest(const glm::vec3& pos, float maxDistance = FLT_MAX) const;
+        private:
+            /** \brief  The number of bits per axis of the cell keys. Cell coordinates are clamped to [-2^(CELL_BITS-1), 2^(CELL_BITS-1)[ */
+            static const uint32_t CELL_BITS = 21;
+
+            /** \brief  Get the cell containing a position
+             * \param pos the position. Must be finite
+             * \return   the cell coordinates */
+            glm::ivec3 getCell(const glm::vec3& pos) const;
+
+            /** \brief  Get the hash key of a cell
+             * \param cell the cell coordinates
+             * \return   the key of the cell in m_cells */
+            static uint64_t getCellKey(const glm::ivec3& cell)
+            {
+                const uint64_t mask = (1 << CELL_BITS) - 1;
+                return (((uint64_t)cell.x & mask) << (2*CELL_BITS)) | (((uint64_t)cell.y & mask) << CELL_BITS) | ((uint64_t)cell.z & mask);
+            }
+
+            /** \brief  Call a function on the point IDs of the stored cells intersecting [minCell, maxCell]. If the range contains more cells than stored, the stored cells are browsed instead
+             * \param minCell the minimum cell
+             * \param maxCell the maximum cell (included)
+             * \param func the function to call: func(const std::vector<uint32_t>& pointIDs) */
+            template <typename Func>
+            void forEachCell(const glm::ivec3& minCell, const glm::ivec3& maxCell, const Func& func) const
+            {
+                double nbCells = (double)(maxCell.x-minCell.x+1) * (maxCell.y-minCell.y+1) * (maxCell.z-minCell.z+1);
+                if(nbCells > m_cells.size())
+                {
+                    for(const auto& it : m_cells)
+                    {
+                        glm::ivec3 cell = m_cellCoords[it.second];
+                        if(cell.x >= minCell.x && cell.x <= maxCell.x && cell.y >= minCell.y && cell.y <= maxCell.y && cell.z >= minCell.z && cell.z <= maxCell.z)
+                            func(m_cellPoints[it.second]);
+                    }
+                    return;
+                }
+
+                for(int32_t x = minCell.x; x <= maxCell.x; x++)
+                    for(int32_t y = minCell.y; y <= maxCell.y; y++)
+                        for(int32_t z = minCell.z; z <= maxCell.z; z++)
+                        {
+                            auto it = m_cells.find(getCellKey(glm::ivec3(x, y, z)));
+                            if(it != m_cells.end())
+                                func(m_cellPoints[it->second]);
+                        }
+            }
+
+            std::shared_ptr<const std::vector<glm::vec3>> m_positions;       /*!< The indexed positions*/
+            std::unordered_map<uint64_t, uint32_t>        m_cells;           /*!< The stored cells: cell key -> cell ID*/
+            std::vector<std::vector<uint32_t>>            m_cellPoints;      /*!< The point IDs of each cell, per cell ID*/
+            std::vector<glm::ivec3>                       m_cellCoords;      /*!< The coordinates of each cell, per cell ID*/
+            float                                         m_cellSize;        /*!< The size of the cells*/
+            bool                                          m_autoCellSize;    /*!< Is the cell size chosen from the positions?*/
+            uint32_t                                      m_nbPoints = 0;    /*!< The number of positions looked at*/
+            uint32_t                                      m_nbFinite = 0;    /*!< The number of finite positions looked at*/
+            glm::vec3                                     m_minPos   = glm::vec3(FLT_MAX);  /*!< The minimum of the finite positions looked at*/
+            glm::vec3                                     m_maxPos   = glm::vec3(-FLT_MAX); /*!< The maximum of the finite positions looked at*/
+            uint32_t                                      m_gridNbFinite = 0;               /*!< The number of finite positions the automatic cell size was chosen for*/
+            glm::dvec3                                    m_gridExtent   = glm::dvec3(0.0); /*!< The extent of the bounding box the automatic cell size was chosen for*/
+    };
+}
+
+#endif
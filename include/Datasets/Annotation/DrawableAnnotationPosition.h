@@ -27,6 +27,11 @@ namespace sereno
             /** \brief Set the mapped data indices to read from the linked AnnotationLogContainer.
              * \param idx the new indices to use  */
             void setMappedDataIndices(const std::vector<uint32_t>& idx) {m_mappedIdx = idx;}
+
+            /** \brief  Get the colors of the positions, mapping the data at getMappedDataIndices() through a transfer function. See AnnotationLogContainer::getMappedColors
+             * \param tf the transfer function to apply
+             * \return   the RGBA colors (one uint8_t per component) of the positions, NULL on error */
+            std::shared_ptr<const std::vector<uint8_t>> getMappedColors(const TF& tf) const {return m_container->getMappedColors(m_component, m_mappedIdx, tf);}
         private:
             glm::vec4             m_color     = glm::vec4(1.0, 1.0, 1.0, 1.0);
             std::vector<uint32_t> m_mappedIdx;
@@ -2,12 +2,28 @@
 #define  POINTFIELDDATASET_INC
 
 #include "Datasets/Dataset.h"
+#include "Datasets/CloudPointOctree.h"
+#include "Datasets/CloudPointLOD.h"
+#include "SpaceFillingCurve.h"
 #include <thread>
 #include <string>
+#include <memory>
 
 namespace sereno
 {
-    /** \brief  Load CloudPointDataset object. This object represent point with a float component associate to each point. No gradient can be derived */
+    /** \brief  Load CloudPointDataset object. This object represents points with N named scalar or vector float fields associated to each point. No gradient can be derived
+     *
+     * Two binary formats (big endian) are supported. The legacy one:
+     * nbPoints (uint32_t)
+     * Position array (nbPoints * 3 floats (x, y, z))
+     * Value array (nbPoints floats). The field is named "data"
+     *
+     * The versioned one:
+     * "SVCP" (4 bytes), version (uint32_t), nbPoints (uint32_t), nbFields (uint32_t)
+     * Per field: nameLength (uint32_t), name (nameLength characters), nbValuePerTuple (uint32_t)
+     * Padding to the next multiple of 4 bytes
+     * Position array (nbPoints * 3 floats (x, y, z))
+     * Per field: value array (nbPoints * nbValuePerTuple floats) */
     class CloudPointDataset : public Dataset
     {
         public:
@@ -24,6 +40,7 @@ namespace sereno
             std::thread* loadValues(LoadCallback clbk, void* data);
             bool create1DHistogram(uint32_t* output, uint32_t width, uint32_t ptFieldXID) const;
             bool create2DHistogram(uint32_t* output, uint32_t width, uint32_t height, uint32_t ptFieldXID, uint32_t ptFieldYID) const;
+            uint32_t getNbSpatialData() const {return m_nbPoints;}
 
             /* \brief  Get the point positions 3D positions.
              * \return  If the dataset is loaded (see isLoaded()), returns a float array sized 3*getNbPoints(). Each tuple of 3 component represent a point of position (x, y, z). Else, return NULL */
@@ -32,13 +49,88 @@ namespace sereno
             /* \brief Get the number of points loaded 
              * \return  The number of points loaded */
             uint32_t getNbPoints() {return m_nbPoints;}
+
+            /** \brief  Set whether the points should be reordered along a space filling curve at the end of loadValues (see reorderPoints())
+             * \param reorder true to reorder the points when loading, false otherwise
+             * \param curve the space filling curve to use */
+            void setReorderPoints(bool reorder, SpaceFillingCurveType curve = SPACE_FILLING_CURVE_HILBERT) {m_reorderPoints = reorder; m_reorderCurve = curve;}
+
+            /** \brief  Sort the loaded points (positions and point field values) along a space filling curve to improve memory locality.
+             * The original ID of each point is kept (see getPointOriginalIDs()). The spatial index, if any, is rebuilt, and the volumetric mask histories of the SubDatasets are cleared.
+             * This function must not be called while the points are being used by another thread
+             * \param curve the space filling curve to use
+             * \return   true on success, false if the dataset is not loaded yet, if a SubDataset holds a (non uniform) volumetric selection, or if the memory could not be allocated */
+            bool reorderPoints(SpaceFillingCurveType curve = SPACE_FILLING_CURVE_HILBERT);
+
+            /** \brief  Get, for each (reordered) point, its ID in the file
+             * \return   an array of size getNbPoints() if the points were reordered (see reorderPoints()), NULL otherwise */
+            const uint32_t* getPointOriginalIDs() const {return (m_pointOriginalIDs.size() ? m_pointOriginalIDs.data() : NULL);}
+
+            /** \brief  Convert a bit mask (e.g., a SubDataset volumetric mask) indexed by the current point order into a bit mask indexed by the file order
+             * \param mask the bit mask using the current point order. Size: (getNbPoints()+7)/8
+             * \param output[out] the bit mask using the file order. Size: (getNbPoints()+7)/8. Can be the same as mask
+             * \return   true on success, false if the memory could not be allocated (output is then not modified) */
+            bool mapMaskToOriginalOrder(const uint8_t* mask, uint8_t* output) const;
+
+            /** \brief  Set whether the spatial index (see getSpatialIndex()) should be built at the end of loadValues.
+             * The index is built inside the reading thread, before the load callback is called
+             * \param build true to build the spatial index when loading, false otherwise */
+            void setBuildSpatialIndex(bool build) {m_buildSpatialIndex = build;}
+
+            /** \brief  Build (or rebuild) the spatial index of the loaded points
+             * \param maxLeafSize the maximum number of points a leaf of the octree can contain
+             * \return   true on success, false if the dataset is not loaded yet */
+            bool buildSpatialIndex(uint32_t maxLeafSize = 1024);
+
+            /** \brief  Get the spatial index over the points
+             * \return   the octree indexing the points, or NULL if it has not been built */
+            const CloudPointOctree* getSpatialIndex() const {return m_spatialIndex.get();}
+
+            /** \brief  Set whether the level-of-detail hierarchy (see getLOD()) should be built at the end of loadValues. This implies building the spatial index
+             * \param build true to build the hierarchy when loading, false otherwise
+             * \param nodeQuota the maximum number of points each non-leaf node of the hierarchy owns */
+            void setBuildLOD(bool build, uint32_t nodeQuota = 512) {m_buildLOD = build; m_lodNodeQuota = nodeQuota;}
+
+            /** \brief  Build (or rebuild) the level-of-detail hierarchy of the loaded points. The spatial index is built if needed
+             * \param nodeQuota the maximum number of points each non-leaf node of the hierarchy owns
+             * \return   true on success, false if the dataset is not loaded yet */
+            bool buildLOD(uint32_t nodeQuota = 512);
+
+            /** \brief  Get the level-of-detail hierarchy, permitting to query at most N points in a region
+             * \return   the level-of-detail hierarchy, or NULL if it has not been built */
+            const CloudPointLOD* getLOD() const {return m_lod.get();}
         protected:
             virtual DatasetGradient* computeGradient(const std::vector<uint32_t>& indices) {return NULL;}
 
         private:
+            /** \brief  buildSpatialIndex without checking that the values are loaded. Used by the reading thread before setting m_valuesLoaded
+             * \param maxLeafSize the maximum number of points a leaf of the octree can contain */
+            void doBuildSpatialIndex(uint32_t maxLeafSize = 1024);
+
+            /** \brief  buildLOD without checking that the values are loaded. Used by the reading thread before setting m_valuesLoaded
+             * \param nodeQuota the maximum number of points each non-leaf node of the hierarchy owns */
+            void doBuildLOD(uint32_t nodeQuota);
+
+            /** \brief  reorderPoints without checking that the values are loaded. Used by the reading thread before setting m_valuesLoaded
+             * \param curve the space filling curve to use
+             * \return   true on success, false otherwise (see reorderPoints) */
+            bool doReorderPoints(SpaceFillingCurveType curve);
+
             float*      m_positions = NULL; /*!< The 3D point positions (x1, y1, z1; x2, y2, z2; ...)*/
             uint32_t    m_nbPoints  = 0;    /*!< The number of pints loaded*/
             std::string m_filePath;         /*!< The file path to load*/
+            uint64_t    m_dataOffset = 0;   /*!< The position in bytes of the position array in the file*/
+
+            std::unique_ptr<CloudPointOctree> m_spatialIndex;              /*!< The spatial index over the points, if built*/
+            bool                              m_buildSpatialIndex = false; /*!< Should the spatial index be built when loading the values?*/
+
+            std::unique_ptr<CloudPointLOD>    m_lod;                       /*!< The level-of-detail hierarchy, if built. Must be destroyed before m_spatialIndex*/
+            bool                              m_buildLOD          = false; /*!< Should the level-of-detail hierarchy be built when loading the values?*/
+            uint32_t                          m_lodNodeQuota      = 512;   /*!< The maximum number of points each non-leaf node of m_lod owns*/
+
+            std::vector<uint32_t>             m_pointOriginalIDs;          /*!< The original (file) ID of each point. Empty if the points were not reordered*/
+            bool                              m_reorderPoints     = false; /*!< Should the points be reordered when loading the values?*/
+            SpaceFillingCurveType             m_reorderCurve      = SPACE_FILLING_CURVE_HILBERT; /*!< The curve to use when reordering the points at load time*/
 
             std::thread                       m_readThread;        /*!< The reading thread*/
             bool                              m_readThreadRunning = false; /*!< Is the reading thread running?*/
@@ -0,0 +1,78 @@
+#ifndef  CLOUDPOINTLOD_INC
+#define  CLOUDPOINTLOD_INC
+
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "Datasets/CloudPointOctree.h"
+
+namespace sereno
+{
+    /** \brief  Level-of-detail hierarchy over a cloud of points.
+     * Each node of a CloudPointOctree owns a random-stratified subset of the points of its cell that its ancestors did not already take.
+     * Leaves own all the remaining points, so that going through the whole hierarchy gives each point exactly once.
+     * Taking the nodes of the first levels, then the nodes of the next ones, gives progressively denser and spatially uniform subsets */
+    class CloudPointLOD
+    {
+        public:
+            /** \brief  Constructor. Build the hierarchy. The octree is not copied and shall outlive this object
+             * \param octree the spatial index to build the hierarchy on
+             * \param nodeQuota the maximum number of points each non-leaf node owns */
+            CloudPointLOD(const CloudPointOctree& octree, uint32_t nodeQuota = 512);
+
+            /** \brief  Get at most "budget" points spread over the whole dataset
+             * \param budget the maximum number of points to return
+             * \param output[out] the point IDs are appended to this array
+             * \return   the number of points appended */
+            uint32_t query(uint32_t budget, std::vector<uint32_t>& output) const;
+
+            /** \brief  Get at most "budget" points contained in an axis-aligned bounding box
+             * \param budget the maximum number of points to return
+             * \param minPos the minimum position of the box
+             * \param maxPos the maximum position of the box
+             * \param output[out] the point IDs are appended to this array
+             * \return   the number of points appended */
+            uint32_t queryAABB(uint32_t budget, const glm::vec3& minPos, const glm::vec3& maxPos, std::vector<uint32_t>& output) const;
+
+            /** \brief  Get at most "budget" points contained in a view frustum
+             * \param budget the maximum number of points to return
+             * \param planes the 6 planes of the frustum (a, b, c, d), expressed in the dataset local space. A position p is inside a plane if dot(p, (a, b, c)) + d >= 0
+             * \param output[out] the point IDs are appended to this array
+             * \return   the number of points appended */
+            uint32_t queryFrustum(uint32_t budget, const glm::vec4* planes, std::vector<uint32_t>& output) const;
+
+            /** \brief  Get the points a node owns, ordered such that any prefix is a stratified subset of the node's cell
+             * \param nodeID the octree node ID
+             * \param count[out] the number of points the node owns
+             * \return   the point IDs the node owns */
+            const uint32_t* getNodeSamples(uint32_t nodeID, uint32_t& count) const
+            {
+                count = m_nodeSampleCount[nodeID];
+                return m_samples.data() + m_nodeSampleBegin[nodeID];
+            }
+
+            /** \brief  Get the octree this hierarchy is built on
+             * \return   the octree */
+            const CloudPointOctree& getOctree() const {return m_octree;}
+        private:
+            /** \brief  Generic budgeted query going level by level through the hierarchy
+             * \param budget the maximum number of points to return
+             * \param nodeTest function classifying a node (-1: outside, 0: partially inside, 1: entirely inside)
+             * \param pointTest function telling if a point position is inside the queried volume
+             * \param output[out] the point IDs are appended to this array
+             * \return   the number of points appended */
+            template <typename NodeTest, typename PointTest>
+            uint32_t query(uint32_t budget, const NodeTest& nodeTest, const PointTest& pointTest, std::vector<uint32_t>& output) const;
+
+            const CloudPointOctree& m_octree;          /*!< The octree the hierarchy is built on*/
+            std::vector<uint32_t>   m_samples;         /*!< The point IDs owned by the nodes, node after node*/
+            std::vector<uint32_t>   m_nodeSampleBegin; /*!< Per node, the first owned point in m_samples*/
+            std::vector<uint32_t>   m_nodeSampleCount; /*!< Per node, the number of owned points*/
+    };
+}
+
+#endif
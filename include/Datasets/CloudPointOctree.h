@@ -0,0 +1,84 @@
+#ifndef  CLOUDPOINTOCTREE_INC
+#define  CLOUDPOINTOCTREE_INC
+
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace sereno
+{
+    /** \brief  A node of a CloudPointOctree. The points of the node are CloudPointOctree::getIndices()[begin..end[ */
+    struct CloudPointOctreeNode
+    {
+        glm::vec3 minPos;      /*!< The minimum position of the node's cell*/
+        glm::vec3 maxPos;      /*!< The maximum position of the node's cell*/
+        uint32_t  begin;       /*!< The first point (in CloudPointOctree::getIndices()) contained in this node*/
+        uint32_t  end;         /*!< The last point (excluded) contained in this node*/
+        int32_t   children[8]; /*!< The children node IDs. -1 if the corresponding child does not contain any point*/
+        uint32_t  depth;       /*!< The depth of this node (0 == root)*/
+        bool      isLeaf;      /*!< Is this node a leaf?*/
+
+        /** \brief  Get the number of points this node contains
+         * \return   end-begin */
+        uint32_t getNbPoints() const {return end-begin;}
+    };
+
+    /** \brief  Spatial index over a cloud of points. The points are sorted along a 3D Morton curve, making every octree node a contiguous range of point IDs */
+    class CloudPointOctree
+    {
+        public:
+            /** \brief  Constructor. Build the octree. The positions are not copied and shall outlive this object
+             * \param positions the 3D point positions (x1, y1, z1; x2, y2, z2; ...). Size: 3*nbPoints
+             * \param nbPoints the number of points
+             * \param minPos the minimum position of the points' bounding box
+             * \param maxPos the maximum position of the points' bounding box
+             * \param maxLeafSize the maximum number of points a leaf can contain (except at the maximum depth) */
+            CloudPointOctree(const float* positions, uint32_t nbPoints, const glm::vec3& minPos, const glm::vec3& maxPos, uint32_t maxLeafSize = 1024);
+
+            /** \brief  Get the octree nodes. The root, if any, is at indice 0
+             * \return   the octree nodes */
+            const std::vector<CloudPointOctreeNode>& getNodes() const {return m_nodes;}
+
+            /** \brief  Get the point IDs sorted along the Morton curve. Nodes reference ranges of this array
+             * \return   the sorted point IDs. Size: getNbPoints() */
+            const std::vector<uint32_t>& getIndices() const {return m_indices;}
+
+            /** \brief  Get the number of points indexed
+             * \return   the number of points indexed */
+            uint32_t getNbPoints() const {return m_indices.size();}
+
+            /** \brief  Get the position of a point
+             * \param pointID the point ID (as stored in getIndices())
+             * \return   the 3D position of the point */
+            glm::vec3 getPosition(uint32_t pointID) const {return glm::vec3(m_positions[3*pointID], m_positions[3*pointID+1], m_positions[3*pointID+2]);}
+
+            /** \brief  Get all the points contained in an axis-aligned bounding box
+             * \param minPos the minimum position of the box
+             * \param maxPos the maximum position of the box
+             * \param output[out] the point IDs contained in the box are appended to this array */
+            void queryAABB(const glm::vec3& minPos, const glm::vec3& maxPos, std::vector<uint32_t>& output) const;
+
+            /** \brief  Get all the points contained in a sphere
+             * \param center the sphere center
+             * \param radius the sphere radius
+             * \param output[out] the point IDs contained in the sphere are appended to this array */
+            void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& output) const;
+        private:
+            /** \brief  Generic query going through the octree
+             * \param nodeTest function classifying a node (-1: outside, 0: partially inside, 1: entirely inside)
+             * \param pointTest function telling if a point position is inside the queried volume
+             * \param output[out] the point IDs inside the queried volume are appended to this array */
+            template <typename NodeTest, typename PointTest>
+            void query(const NodeTest& nodeTest, const PointTest& pointTest, std::vector<uint32_t>& output) const;
+
+            const float*                      m_positions; /*!< The indexed positions*/
+            std::vector<CloudPointOctreeNode> m_nodes;     /*!< The octree nodes*/
+            std::vector<uint32_t>             m_indices;   /*!< The point IDs sorted along the Morton curve*/
+    };
+}
+
+#endif
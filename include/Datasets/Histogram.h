@@ -0,0 +1,64 @@
+#ifndef  HISTOGRAM_INC
+#define  HISTOGRAM_INC
+
+#include "Datasets/PointFieldDesc.h"
+#include "CompressedBitmask.h"
+#include <cmath>
+#include <cstdint>
+
+namespace sereno
+{
+    /** \brief  Read the value of a scalar point field tuple, or the magnitude of a vector point field tuple
+     * \param vals the raw values of the point field (one timestep)
+     * \param desc the point field descriptor (format, nbValuePerTuple)
+     * \param i the tuple indice to read
+     * \return   the value (scalar field) or the magnitude (vector field) */
+    inline float readPointFieldMagnitude(const uint8_t* vals, const PointFieldDesc& desc, size_t i)
+    {
+        const uint8_t formatSize = VTKValueFormatInt(desc.format);
+        uint8_t*      tuple      = (uint8_t*)vals + i*formatSize*desc.nbValuePerTuple;
+
+        if(desc.nbValuePerTuple == 1)
+            return readParsedVTKValue<float>(tuple, desc.format);
+
+        float mag = 0.0f;
+        for(uint32_t j = 0; j < desc.nbValuePerTuple; j++)
+        {
+            float readVal = readParsedVTKValue<float>(tuple + j*formatSize, desc.format);
+            mag += readVal*readVal;
+        }
+        return sqrt(mag);
+    }
+
+    /** \brief  Compute the 1D histogram of a point field over all its timesteps. Vector fields use their magnitude. NaN values are discarded
+     * \param ptX the point field to evaluate
+     * \param output the output image. Size: width
+     * \param width the number of bins */
+    void computePointField1DHistogram(const PointFieldDesc& ptX, uint32_t* output, uint32_t width);
+
+    /** \brief  Compute the 1D histogram of the selected tuples of a point field over all its timesteps. Vector fields use their magnitude. NaN values are discarded
+     * \param ptX the point field to evaluate
+     * \param selection the tuples to evaluate (e.g., SubDataset::getCompressedVolumetricMask()). Only the ranges of selected tuples are visited
+     * \param output the output image. Size: width
+     * \param width the number of bins */
+    void computePointField1DHistogram(const PointFieldDesc& ptX, const CompressedBitmask& selection, uint32_t* output, uint32_t width);
+
+    /** \brief  Compute the 2D histogram of two point fields (sharing the same number of tuples) over all their timesteps. Vector fields use their magnitude. NaN values are discarded
+     * \param ptX the point field of the X axis
+     * \param ptY the point field of the Y axis
+     * \param output the output image. Size: width*height. X values are stored first (row-major)
+     * \param width the number of bins along the X axis
+     * \param height the number of bins along the Y axis */
+    void computePointField2DHistogram(const PointFieldDesc& ptX, const PointFieldDesc& ptY, uint32_t* output, uint32_t width, uint32_t height);
+
+    /** \brief  Compute the 2D histogram of the selected tuples of two point fields (sharing the same number of tuples) over all their timesteps. Vector fields use their magnitude. NaN values are discarded
+     * \param ptX the point field of the X axis
+     * \param ptY the point field of the Y axis
+     * \param selection the tuples to evaluate (e.g., SubDataset::getCompressedVolumetricMask()). Only the ranges of selected tuples are visited
+     * \param output the output image. Size: width*height. X values are stored first (row-major)
+     * \param width the number of bins along the X axis
+     * \param height the number of bins along the Y axis */
+    void computePointField2DHistogram(const PointFieldDesc& ptX, const PointFieldDesc& ptY, const CompressedBitmask& selection, uint32_t* output, uint32_t width, uint32_t height);
+}
+
+#endif
@@ -9,12 +9,16 @@
 #include <stdint.h>
 #include <memory>
 #include <list>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp> 
 #include <string>
 #include "Quaternion.h"
 #include "TransferFunction/TransferFunction.h"
 #include "ColorMode.h"
+#include "Bitmask.h"
+#include "CompressedBitmask.h"
+#include "Datasets/VolumetricMaskHistory.h"
 #include "Datasets/Annotation/AnnotationCanvas.h"
 #include "Datasets/Annotation/AnnotationLogContainer.h"
 #include "Datasets/Annotation/DrawableAnnotationPosition.h"
@@ -159,27 +163,80 @@ namespace sereno
              * \param tf the transfer function to use */
             void setTransferFunction(std::shared_ptr<TF> tf) {m_tf = tf;}
 
-            /** \brief  Get the volumetric mask. We are using bit mask and not boolean objects. Size: (getParent()->getNbSpatialData()+7)/8, see getVolumetricMaskSize
-             * \return   the volumetric mask.  */
-            const uint8_t* getVolumetricMask() const {return m_volumetricMask;}
+            /** \brief  Start editing the volumetric mask directly. The mask is stored as dense bits until endVolumetricMaskEdit is called.
+             * Calling this function while an edit is in progress only returns the mask being edited. Must not be called while other threads read the mask
+             * \return   the volumetric mask to edit. We are using bit mask and not boolean objects (see Bitmask::data()). Size (in bits): getParent()->getNbSpatialData() */
+            Bitmask& beginVolumetricMaskEdit();
 
-            /** \brief  Get the volumetric mask. We are using bit mask and not boolean objects. Size: (getParent()->getNbSpatialData()+7)/8, see getVolumetricMaskSize
-             * \return   the volumetric mask.  */
-            uint8_t* getVolumetricMask() {return m_volumetricMask;}
+            /** \brief  End the edit started by beginVolumetricMaskEdit (or setVolumetricMaskAt), and compress the mask again if worth it. Does nothing if no edit is in progress
+             * \param record should this edit be recorded in the history (and then be undoable)? If not, the history is cleared */
+            void endVolumetricMaskEdit(bool record=true);
 
-            /** \brief  Get the size of the volumetric mask binary array
-             * \return  The size of getVolumetricMask() array */
+            /** \brief  Is the volumetric mask being edited? See beginVolumetricMaskEdit
+             * \return   true if an edit is in progress, false otherwise */
+            bool isVolumetricMaskEdited() const {return m_isVolumetricMaskEdited;}
+
+            /** \brief  Get a compressed copy of the volumetric mask. Cheap if the mask is already compressed, as containers are shared between copies.
+             * Along with getVolumetricMaskAt, forEachVolumetricMaskRange and combineVolumetricMaskInto, this permits to read the mask whatever its representation
+             * \return   the compressed volumetric mask */
+            CompressedBitmask getCompressedVolumetricMask() const;
+
+            /** \brief  Is the volumetric mask currently stored compressed? Empty, full and sparse masks are stored compressed,
+             * other masks, and masks being edited (see beginVolumetricMaskEdit), are stored as dense bits
+             * \return   true if compressed, false if dense */
+            bool isVolumetricMaskCompressed() const {return m_isVolumetricMaskCompressed;}
+
+            /** \brief  Get the size of the volumetric mask, in bytes
+             * \return  (getParent()->getNbSpatialData()+7)/8 */
             size_t getVolumetricMaskSize() const;
 
-            /** \brief Set the volumetric mask cell at x
+            /** \brief  Count the spatial data selected by the volumetric mask
+             * \return   the number of bits set in the volumetric mask */
+            size_t countVolumetricMask() const {return (m_isVolumetricMaskCompressed ? m_compressedVolumetricMask.count() : m_volumetricMask.count());}
+
+            /** \brief  Call a function on each maximal range of spatial data selected by the volumetric mask, without expanding it
+             * \param begin the first spatial data to look at
+             * \param end the last spatial data to look at (excluded)
+             * \param func the function to call: func(size_t rangeBegin, size_t rangeEnd), rangeEnd being excluded */
+            template <typename Func>
+            void forEachVolumetricMaskRange(size_t begin, size_t end, const Func& func) const
+            {
+                if(m_isVolumetricMaskCompressed)
+                {
+                    m_compressedVolumetricMask.forEachRange(begin, end, func);
+                    return;
+                }
+
+                end = std::min(end, m_volumetricMask.size());
+                for(size_t x = m_volumetricMask.findNext(begin, end); x < end; x = m_volumetricMask.findNext(x, end))
+                {
+                    size_t rangeBegin = x;
+                    while(x < end && m_volumetricMask.get(x))
+                        x++;
+                    func(rangeBegin, x);
+                }
+            }
+
+            /** \brief  Combine the volumetric mask with a dense bit mask (target = target op volumetricMask), without expanding the volumetric mask
+             * \param target the mask to modify
+             * \param op the operation to apply */
+            void combineVolumetricMaskInto(Bitmask& target, BitmaskOp op) const;
+
+            /** \brief  Copy the volumetric mask of another SubDataset. The copy is not recorded: the volumetric mask history is cleared. An edit in progress is ended first
+             * \param sd the SubDataset to copy the volumetric mask from
+             * \return   false if both volumetric masks do not have the same size (nothing is copied), true otherwise */
+            bool copyVolumetricMask(const SubDataset& sd);
+
+            /** \brief Set the volumetric mask cell at x. An edit is started if none is in progress (see beginVolumetricMaskEdit). It is recorded when it ends:
+             * at the call of endVolumetricMaskEdit, or at the next operation on the whole mask (combination, undo, redo, reset, etc.).
+             * To call this function from several threads (on distinct bytes of the mask), call beginVolumetricMaskEdit beforehand
              * \param x the spatial data indice to modify. The number of spatial value is getParent()->getNbSpatialData()
              * \param b the boolean status to apply*/
             void setVolumetricMaskAt(uint32_t x, bool b)
             {
-                if(b)
-                    m_volumetricMask[x/8] = m_volumetricMask[x/8] | (1 << (x%8));
-                else
-                    m_volumetricMask[x/8] = m_volumetricMask[x/8] & (~(1 << (x%8)));
+                if(!m_isVolumetricMaskEdited)
+                    beginVolumetricMaskEdit();
+                m_volumetricMask.set(x, b);
             }
 
             /** \brief Get the volumetric mask cell at x
@@ -187,14 +244,43 @@ namespace sereno
              * \return the mask value. true for activated, false for disactivated*/
             bool getVolumetricMaskAt(uint32_t x) const
             {
-                return m_volumetricMask[x/8] & (1 << (x%8));
+                return (m_isVolumetricMaskCompressed ? m_compressedVolumetricMask.get(x) : m_volumetricMask.get(x));
             }
 
-            /** \brief  Reset to false or true the volumetric mask 
+            /** \brief  Reset to false or true the volumetric mask. The reset is not recorded: the volumetric mask history is cleared. An edit in progress is ended first
              * \param t the reset value (false or true)
              * \param isEnabled should we enable this volumetric mask?*/
             void resetVolumetricMask(bool t, bool isEnabled=true);
 
+            /** \brief  Combine a bit mask with the volumetric mask, recording the edit in the volumetric mask history. An edit in progress is ended (and recorded) first
+             * \param mask the mask to combine with. Size (in bits): getParent()->getNbSpatialData()
+             * \param op the operation to apply
+             * \param record should this edit be recorded in the history (and then be undoable)? If not, the history is cleared */
+            void combineVolumetricMask(const Bitmask& mask, BitmaskOp op, bool record=true);
+
+            /** \brief  Apply an encoded volumetric mask delta (see VolumetricMaskHistory), e.g., an edit received from a collaborating client. An edit in progress is ended (and recorded) first
+             * \param delta the encoded delta
+             * \param size the size of delta, in bytes
+             * \param record should this edit be recorded in the history (and then be undoable)? If not, the history is cleared
+             * \return   true on success, false if the delta is malformed or does not match this SubDataset */
+            bool applyVolumetricMaskDelta(const uint8_t* delta, size_t size, bool record=true);
+
+            /** \brief  Undo the last recorded edit of the volumetric mask. An edit in progress is ended (and recorded) first
+             * \return   true on success, false if there is nothing to undo */
+            bool undoVolumetricMask();
+
+            /** \brief  Redo the last undone edit of the volumetric mask. An edit in progress is ended (and recorded) first
+             * \return   true on success, false if there is nothing to redo */
+            bool redoVolumetricMask();
+
+            /** \brief  Get the history of the volumetric mask edits
+             * \return   the volumetric mask history */
+            VolumetricMaskHistory& getVolumetricMaskHistory() {return m_volumetricMaskHistory;}
+
+            /** \brief  Get the history of the volumetric mask edits
+             * \return   the volumetric mask history */
+            const VolumetricMaskHistory& getVolumetricMaskHistory() const {return m_volumetricMaskHistory;}
+
             /** \brief  If the volumetric selection enabled?
              * \return   true if no, false otherwise */
             bool isVolumetricMaskEnabled() const {return m_enableVolumetricMask;}
@@ -250,14 +336,25 @@ namespace sereno
 #ifdef SNAPSHOT
             std::shared_ptr<Snapshot> m_snapshot; /*!< The snapshot structure*/
 #endif
-            uint8_t* m_volumetricMask       = NULL;  /*!< The volumetric mask*/
+            Bitmask           m_volumetricMask;                    /*!< The volumetric mask, when stored as dense bits*/
+            CompressedBitmask m_compressedVolumetricMask;          /*!< The volumetric mask, when stored compressed*/
+            bool              m_isVolumetricMaskCompressed = true; /*!< Which of m_volumetricMask and m_compressedVolumetricMask stores the volumetric mask?*/
+            bool              m_isVolumetricMaskEdited     = false; /*!< Is the volumetric mask being edited (see beginVolumetricMaskEdit)?*/
+            Bitmask           m_volumetricMaskEditBase;            /*!< The volumetric mask when the edit in progress began, to record the edit*/
             bool     m_enableVolumetricMask = false; /*!< Should we consider the SubDataset volumetric mask?*/
+            VolumetricMaskHistory m_volumetricMaskHistory; /*!< The undo/redo history of the volumetric mask*/
 
             float    m_minDepthClipping        = 0.0f;  /*!< The min depth clipping value to use for this SubDataset*/
             float    m_maxDepthClipping        = 1.0f;  /*!< The max depth clipping value to use for this SubDataset*/
 
             SubDatasetGroup* m_sdGroup = nullptr;
         private:
+            /** \brief  Store the volumetric mask as dense bits, if it is compressed */
+            void expandVolumetricMask();
+
+            /** \brief  Store the volumetric mask compressed if it takes less memory than the dense representation. Called after each edit of the mask */
+            void compactVolumetricMask();
+
             /* \brief  Set the ID of this SubDataset. This method is mostly aimed at being called by the Dataset class.
              * \param id the new ID */
             void setID(uint32_t id) {m_id = id;}
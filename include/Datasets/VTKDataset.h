@@ -7,6 +7,7 @@
 #include <thread>
 #include "VTKParser.h"
 #include "Dataset.h"
+#include "Bitmask.h"
 
 namespace sereno
 {
@@ -99,18 +100,22 @@ namespace sereno
 
             /** \brief  Has this dataset a mask?
              * \return   true if yes, false otherwise */
-            bool hasMaskComputed() const {return m_mask != NULL;}
+            bool hasMaskComputed() const {return m_mask.size() > 0;}
 
             /** \brief  Get the mask to apply at indice "ind"
              * \param ind the indice to look at
              * \return  true if yes, false otherwise */
             bool getMask(uint32_t ind) const
             {
-                if(m_mask == NULL)
+                if(m_mask.size() == 0)
                     return true;
-                return m_mask[ind/8]&(1 << (ind%8));
+                return m_mask.get(ind);
             }
 
+            /** \brief  Get the mask of the dataset
+             * \return   the mask (1 bit == 1 value), or NULL if the dataset has no mask (see hasMaskComputed()) */
+            const Bitmask* getMaskBitmask() const {return (m_mask.size() > 0 ? &m_mask : NULL);}
+
         protected:
             virtual DatasetGradient* computeGradient(const std::vector<uint32_t>& indices);
 
@@ -129,7 +134,7 @@ namespace sereno
             void computeMultiDGradient();
 
             std::vector<VTKTimestep> m_timesteps;         /*!< The timestep this data contain*/
-            uint8_t*                 m_mask = NULL;       /*!< The mask values to apply. Here, 1 bit == 1 value*/
+            Bitmask                  m_mask;              /*!< The mask values to apply. Here, 1 bit == 1 value. Empty if the dataset has no mask*/
             std::thread              m_readThread;        /*!< The reading thread*/
             bool                     m_readThreadRunning = false; /*!< Is the reading thread running?*/
     };
@@ -10,9 +10,22 @@
 #include "Quaternion.h"
 #include "ColorMode.h"
 #include "Dataset.h"
+#include "OctahedralEncoding.h"
+#include <thread>
+#include <vector>
 
 namespace sereno
 {
+    /* \brief A glyph to render at a given cell of a VectorFieldDataset */
+    struct VectorFieldGlyph
+    {
+        uint32_t    x;         /*!< The x coordinate of the cell*/
+        uint32_t    y;         /*!< The y coordinate of the cell*/
+        uint32_t    z;         /*!< The z coordinate of the cell*/
+        float       amplitude; /*!< The velocity amplitude of the cell*/
+        Quaternionf rotation;  /*!< The orientation of the velocity (see VectorFieldDataset::getRotationQuaternion)*/
+    };
+
     /*  \brief Class representing the fluid datasets */
     class VectorFieldDataset : public Dataset
     {
@@ -22,6 +35,10 @@ namespace sereno
              * \param name the VectorFieldDataset name*/
             VectorFieldDataset(FILE* file, const std::string& name);
 
+            /* \brief Constructor. Read only the grid size of the file. The velocities are read in a separated thread by loadValues
+             * \param path the file to read */
+            VectorFieldDataset(const std::string& path);
+
             /* \brief Copy constructor
              * \param copy the VectorFieldDataset to copy */
             VectorFieldDataset(const VectorFieldDataset& copy);
@@ -43,7 +60,7 @@ namespace sereno
              * \return the VectorFieldDataset. Destroy it using delete operator*/
             static VectorFieldDataset* readFromFilePath(const std::string& path);
 
-            /* \brief Get the velocity array. Size : getGridSize
+            /* \brief Get the velocity array. Size : 3*nbCells(). NULL if the values are not loaded
              * \return the velocity array packed in (x, y, z) like : 
              * for(int k = 0; k < getGridSize[2]; k++)
              *     for(int j = 0; j < getGridSize[1]; j++)
@@ -70,9 +87,40 @@ namespace sereno
              * \return the direction encoded in a Quaternion */
             Quaternionf getRotationQuaternion(uint32_t x, uint32_t y, uint32_t z) const;
 
-            virtual std::thread* loadValues(LoadCallback clbk, void* data) {clbk(this, 0, data); return NULL;} //TODO
-
-            virtual bool create1DHistogram(uint32_t* output, uint32_t width, uint32_t ptFieldXID) const {return false;} //TODO
+            /* \brief Get the size of the sub-grid taking one cell every "stride" cells along each axis
+             * \param stride the stride between two cells of the sub-grid (>= 1)
+             * \param size[out] the sub-grid size. Size: 3 */
+            void getStridedGridSize(uint32_t stride, uint32_t* size) const;
+
+            /* \brief Get the rotation quaternions (see getRotationQuaternion) of all the cells of a strided sub-grid.
+             * The quaternions are computed in parallel on the first call and cached until the values or the stride change.
+             * This function is not thread-safe
+             * \param stride the stride between two cells of the sub-grid (>= 1)
+             * \return the quaternions ordered as the velocity array (see getVelocity) of the sub-grid (see getStridedGridSize), NULL if the values are not loaded */
+            const Quaternionf* getRotationQuaternions(uint32_t stride = 1);
+
+            /* \brief Get the velocity directions, octahedral-encoded (see octahedralEncode), of all the cells of a strided sub-grid.
+             * The directions are computed in parallel on the first call and cached until the values or the stride change.
+             * This function is not thread-safe
+             * \param stride the stride between two cells of the sub-grid (>= 1)
+             * \return the encoded directions ordered as the velocity array (see getVelocity) of the sub-grid (see getStridedGridSize), NULL if the values are not loaded */
+            const uint32_t* getOctahedralDirections(uint32_t stride = 1);
+
+            /* \brief List the glyphs to render: the cells of a strided sub-grid whose velocity amplitude is at least minAmplitude.
+             * Rotations are only computed for the listed cells
+             * \param stride the stride between two cells of the sub-grid (>= 1)
+             * \param minAmplitude the minimum amplitude a cell must have to be listed
+             * \param output[out] the glyphs, ordered as the velocity array (see getVelocity). The array is cleared first
+             * \return false if the values are not loaded, true otherwise */
+            bool computeGlyphs(uint32_t stride, float minAmplitude, std::vector<VectorFieldGlyph>& output) const;
+
+            /* \brief Get the minimum and maximum velocity amplitudes
+             * \return the amplitude range (min, max). Size: 2 */
+            const float* getAmplitudeRange() const {return m_amplitude;}
+
+            virtual std::thread* loadValues(LoadCallback clbk, void* data);
+
+            virtual bool create1DHistogram(uint32_t* output, uint32_t width, uint32_t ptFieldXID) const;
 
             virtual bool create2DHistogram(uint32_t* output, uint32_t width, uint32_t height, uint32_t ptFieldXID, uint32_t ptFieldYID) const
             {
@@ -84,9 +132,26 @@ namespace sereno
             virtual DatasetGradient* computeGradient(const std::vector<uint32_t>& indices) {return NULL;}
 
         private:
-            uint32_t m_size[3];           /*!< The 3D size of the grid*/
-            float*   m_velocity = NULL;   /*!< The velocity array of all the grid cell. Access via m_velocity[i + j*width + k*width*height] */ 
-            float    m_amplitude[2];      /*!< The maximum and minimum velocity amplitude */
+            /* \brief Register the "velocity" point field (3 values per tuple) describing the grid velocities */
+            void initPointFieldDesc();
+
+            /* \brief Convert the raw (big endian) velocities, compute the amplitude range and register the values in the point field
+             * \param data the raw velocities. Size: 3*nbCells() floats
+             * \return true on success, false otherwise (memory allocation) */
+            bool setRawVelocities(const uint8_t* data);
+
+            uint32_t m_size[3] = {0, 0, 0};    /*!< The 3D size of the grid*/
+            float*   m_velocity = NULL;        /*!< The velocity array of all the grid cell, owned by the "velocity" point field. Access via m_velocity[3*(i + j*width + k*width*height)] */ 
+            float    m_amplitude[2] = {0, 0};  /*!< The minimum and maximum velocity amplitude */
+
+            std::vector<Quaternionf> m_rotations;              /*!< Cached rotation quaternions (see getRotationQuaternions)*/
+            uint32_t                 m_rotationStride = 0;     /*!< The stride of m_rotations. 0 == no cache*/
+            std::vector<uint32_t>    m_directions;             /*!< Cached octahedral-encoded directions (see getOctahedralDirections)*/
+            uint32_t                 m_directionStride = 0;    /*!< The stride of m_directions. 0 == no cache*/
+
+            std::string m_filePath;                    /*!< The file path to load (path constructor)*/
+            std::thread m_readThread;                  /*!< The reading thread*/
+            bool        m_readThreadRunning = false;   /*!< Is the reading thread running?*/
     };
 }
 
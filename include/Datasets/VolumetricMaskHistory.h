@@ -0,0 +1,91 @@
+#ifndef  VOLUMETRICMASKHISTORY_INC
+#define  VOLUMETRICMASKHISTORY_INC
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "Bitmask.h"
+
+namespace sereno
+{
+    /** \brief  Undo/redo history of a volumetric mask. Each edit is stored as the XOR between the mask before and after the edit,
+     * compressed with a run-length encoding. Applying a delta to the mask is its own inverse: the same delta is used to undo and to redo an edit.
+     *
+     * Delta format (all integers are LEB128 varints, so that deltas can be exchanged between platforms):
+     *   nbBits, then a sequence of runs until the end of the buffer.
+     *   A run is a header (length << 2 | type) where type is 0 (length bytes unchanged), 1 (length bytes fully flipped) or 2 (length literal bytes to XOR, following the header) */
+    class VolumetricMaskHistory
+    {
+        public:
+            /** \brief  Constructor
+             * \param maxMemory the maximum number of bytes used by the stored deltas. The oldest edits are forgotten when exceeded */
+            VolumetricMaskHistory(size_t maxMemory = 16*1024*1024);
+
+            /** \brief  Compute the compressed delta between two states of a mask
+             * \param before the mask before the edit
+             * \param after the mask after the edit. Must have the same size as before
+             * \param output[out] the encoded delta. Previous content is discarded
+             * \return   false if the sizes of both masks differ, true otherwise */
+            static bool encodeDelta(const Bitmask& before, const Bitmask& after, std::vector<uint8_t>& output);
+
+            /** \brief  XOR an encoded delta into a mask
+             * \param mask the mask to modify
+             * \param delta the encoded delta
+             * \param size the size of delta, in bytes
+             * \return   false if the delta is malformed or does not match the mask size (the mask is then not modified), true otherwise */
+            static bool applyDelta(Bitmask& mask, const uint8_t* delta, size_t size);
+
+            /** \brief  Record an edit. The edits that were undone are discarded. Edits that did not change the mask are not recorded
+             * \param before the mask before the edit
+             * \param after the mask after the edit
+             * \return   true if an edit was recorded, false otherwise */
+            bool push(const Bitmask& before, const Bitmask& after);
+
+            /** \brief  Record an already encoded edit, e.g., received from a collaborating client. The edits that were undone are discarded
+             * \param delta the encoded delta */
+            void pushDelta(std::vector<uint8_t>&& delta);
+
+            /** \brief  Undo the last edit
+             * \param mask the mask to modify. Must be in the state following the last edit
+             * \return   true on success, false if there is nothing to undo */
+            bool undo(Bitmask& mask);
+
+            /** \brief  Redo the last undone edit
+             * \param mask the mask to modify. Must be in the state preceding the undone edit
+             * \return   true on success, false if there is nothing to redo */
+            bool redo(Bitmask& mask);
+
+            /** \brief  Can we undo an edit?
+             * \return   true if yes, false otherwise */
+            bool canUndo() const {return m_current > 0;}
+
+            /** \brief  Can we redo an edit?
+             * \return   true if yes, false otherwise */
+            bool canRedo() const {return m_current < m_deltas.size();}
+
+            /** \brief  Get the encoded delta of the last applied edit, e.g., to send it to collaborating clients
+             * \return   the encoded delta, or NULL if there is nothing to undo */
+            const std::vector<uint8_t>* getLastDelta() const {return (m_current > 0 ? &m_deltas[m_current-1] : NULL);}
+
+            /** \brief  Get the number of recorded edits (applied and undone)
+             * \return   the number of edits */
+            size_t getNbEdits() const {return m_deltas.size();}
+
+            /** \brief  Get the number of bytes used by the stored deltas
+             * \return   the memory size */
+            size_t getMemorySize() const {return m_memorySize;}
+
+            /** \brief  Forget all the edits */
+            void clear();
+        private:
+            /** \brief  Forget the oldest edits until the memory limit is respected. The last edit is always kept */
+            void trim();
+
+            std::vector<std::vector<uint8_t>> m_deltas;         /*!< The encoded deltas, from the oldest to the newest*/
+            size_t                            m_current    = 0; /*!< The number of applied edits. m_deltas[m_current..] can be redone*/
+            size_t                            m_memorySize = 0; /*!< The sum of the deltas' sizes*/
+            size_t                            m_maxMemory;      /*!< The maximum value of m_memorySize*/
+    };
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef  MAPPEDFILE_INC
+#define  MAPPEDFILE_INC
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace sereno
+{
+    /** \brief  Read-only view of a whole file. The file is memory-mapped when the platform allows it. Otherwise, it is read in large sequential blocks into memory */
+    class MappedFile
+    {
+        public:
+            /** \brief  Constructor, open and map the file
+             * \param path the file to open. Check isOpen() to know if the operation succeeded */
+            MappedFile(const std::string& path);
+
+            MappedFile(const MappedFile& copy) = delete;
+            MappedFile& operator=(const MappedFile& copy) = delete;
+
+            /** \brief  Destructor, unmap the file */
+            ~MappedFile();
+
+            /** \brief  Has the file been opened?
+             * \return   true if yes, false otherwise */
+            bool isOpen() const {return m_isOpen;}
+
+            /** \brief  Get the file content
+             * \return   the file content. Size: getSize(). NULL if the file is empty or could not be opened */
+            const uint8_t* getData() const {return m_data;}
+
+            /** \brief  Get the file size in bytes
+             * \return   the file size in bytes */
+            uint64_t getSize() const {return m_size;}
+        private:
+            uint8_t* m_data     = NULL;  /*!< The file content*/
+            uint64_t m_size     = 0;     /*!< The file size*/
+            bool     m_isMapped = false; /*!< Is m_data memory-mapped (true) or allocated (false)?*/
+            bool     m_isOpen   = false; /*!< Has the file been opened?*/
+    };
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef  OCTAHEDRALENCODING_INC
+#define  OCTAHEDRALENCODING_INC
+
+#include <cstdint>
+#include <cmath>
+
+namespace sereno
+{
+    /** \brief  Convert a float in [-1, 1] to a signed normalized 16 bits integer
+     * \param v the value to convert
+     * \return   the converted value */
+    inline int16_t floatToSnorm16(float v)
+    {
+        v = (v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v));
+        return (int16_t)std::lround(v*32767.0f);
+    }
+
+    /** \brief  Encode a 3D direction using the octahedral mapping (Cigolle et al., "A Survey of Efficient Representations for Independent Unit Vectors", 2014).
+     * The direction is projected on the unit octahedron, whose lower half is folded over the upper one. Both resulting coordinates are stored as snorm16
+     * \param dir the direction to encode (x, y, z). Does not need to be normalized. The null vector is encoded as (0, 0, 1)
+     * \return   the encoded direction: the x coordinate in the 16 lowest bits, the y coordinate in the 16 highest bits */
+    inline uint32_t octahedralEncode(const float* dir)
+    {
+        float l1 = std::fabs(dir[0]) + std::fabs(dir[1]) + std::fabs(dir[2]);
+        if(l1 == 0.0f)
+            return 0;
+
+        float u = dir[0]/l1;
+        float v = dir[1]/l1;
+        if(dir[2] < 0.0f)
+        {
+            float tmp = u;
+            u = (1.0f - std::fabs(v)) * (tmp >= 0.0f ? 1.0f : -1.0f);
+            v = (1.0f - std::fabs(tmp)) * (v >= 0.0f ? 1.0f : -1.0f);
+        }
+
+        return (uint16_t)floatToSnorm16(u) | ((uint32_t)(uint16_t)floatToSnorm16(v) << 16);
+    }
+
+    /** \brief  Decode a direction encoded with octahedralEncode
+     * \param code the encoded direction
+     * \param dir[out] the decoded normalized direction (x, y, z) */
+    inline void octahedralDecode(uint32_t code, float* dir)
+    {
+        float u = (int16_t)(code & 0xffff) / 32767.0f;
+        float v = (int16_t)(code >> 16)    / 32767.0f;
+        float z = 1.0f - std::fabs(u) - std::fabs(v);
+        if(z < 0.0f)
+        {
+            float tmp = u;
+            u = (1.0f - std::fabs(v)) * (tmp >= 0.0f ? 1.0f : -1.0f);
+            v = (1.0f - std::fabs(tmp)) * (v >= 0.0f ? 1.0f : -1.0f);
+        }
+
+        float norm = std::sqrt(u*u + v*v + z*z);
+        dir[0] = u/norm;
+        dir[1] = v/norm;
+        dir[2] = z/norm;
+    }
+}
+
+#endif
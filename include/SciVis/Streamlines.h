@@ -0,0 +1,90 @@
+#ifndef  STREAMLINES_INC
+#define  STREAMLINES_INC
+
+#ifndef GLM_FORCE_RADIANS
+#define GLM_FORCE_RADIANS
+#endif
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include "Datasets/VectorFieldDataset.h"
+#include "Datasets/SubDataset.h"
+
+namespace sereno
+{
+    /** \brief  The numerical integration schemes available to trace streamlines */
+    enum StreamlineIntegrator
+    {
+        STREAMLINE_RK4  = 0, //Classical Runge-Kutta, fixed step size
+        STREAMLINE_RK45 = 1  //Dormand-Prince Runge-Kutta 5(4), adaptive step size
+    };
+
+    /** \brief  The parameters driving the streamline integration. Positions, lengths and step sizes are expressed in grid coordinates (cell (x, y, z) is at position (x, y, z)) */
+    struct StreamlineParameters
+    {
+        StreamlineIntegrator integrator     = STREAMLINE_RK45; /*!< The integration scheme*/
+        float                stepSize       = 0.25f;           /*!< The step size (RK4) or the initial step size (RK45)*/
+        float                minStepSize    = 1e-3f;           /*!< The minimum step size (RK45)*/
+        float                maxStepSize    = 2.0f;            /*!< The maximum step size (RK45)*/
+        float                tolerance      = 1e-3f;           /*!< The maximum position error per step (RK45)*/
+        uint32_t             maxSteps       = 1000;            /*!< The maximum number of steps per direction*/
+        float                maxLength      = std::numeric_limits<float>::max(); /*!< The maximum length per direction*/
+        float                minVelocity    = 1e-6f;           /*!< The integration stops where the velocity amplitude is below this value*/
+        bool                 bothDirections = true;            /*!< Integrate backward and forward from the seeds (true) or only forward (false)*/
+        uint32_t             seedBatchSize  = 64;              /*!< The number of seeds a thread traces at once*/
+    };
+
+    /** \brief  Polylines stored in one contiguous buffer. Line i spans the vertices [offsets[i], offsets[i+1][ */
+    struct Streamlines
+    {
+        std::vector<glm::vec3> vertices; /*!< The vertices of all the lines, line after line*/
+        std::vector<uint32_t>  offsets;  /*!< The first vertex of each line. Size: getNbLines()+1*/
+
+        /** \brief  Get the number of lines stored
+         * \return   the number of lines */
+        size_t getNbLines() const {return (offsets.size() ? offsets.size()-1 : 0);}
+
+        /** \brief  Get the number of vertices of a line
+         * \param i the line ID
+         * \return   the number of vertices of the line i */
+        uint32_t getNbVertices(size_t i) const {return offsets[i+1] - offsets[i];}
+
+        /** \brief  Get the vertices of a line
+         * \param i the line ID
+         * \return   the getNbVertices(i) vertices of the line i */
+        const glm::vec3* getVertices(size_t i) const {return vertices.data() + offsets[i];}
+    };
+
+    /** \brief  Interpolate trilinearly the velocity of a vector field
+     * \param vf the loaded vector field
+     * \param pos the position, in grid coordinates
+     * \param vel[out] the interpolated velocity
+     * \return   true if pos is inside the grid, false otherwise (vel is then not modified) */
+    bool sampleVelocity(const VectorFieldDataset& vf, const glm::vec3& pos, glm::vec3& vel);
+
+    /** \brief  Trace one streamline per seed, in parallel (one seed batch per thread at a time)
+     * \param vf the loaded vector field
+     * \param seeds the seed positions, in grid coordinates
+     * \param nbSeeds the number of seeds
+     * \param params the integration parameters
+     * \param output[out] the traced lines. Line i corresponds to seed i. Seeds outside the grid give empty lines
+     * \return   false if the vector field is not loaded, true otherwise */
+    bool computeStreamlines(const VectorFieldDataset& vf, const glm::vec3* seeds, size_t nbSeeds, const StreamlineParameters& params, Streamlines& output);
+
+    /** \brief  Generate seeds evenly spread along a segment
+     * \param p0 the first extremity of the segment
+     * \param p1 the second extremity of the segment
+     * \param nbSeeds the number of seeds to generate. Both extremities are included if nbSeeds >= 2
+     * \param output[out] the seeds are appended to this array */
+    void seedsFromLine(const glm::vec3& p0, const glm::vec3& p1, uint32_t nbSeeds, std::vector<glm::vec3>& output);
+
+    /** \brief  Generate seeds at the cells of a vector field selected by the volumetric mask of a SubDataset. All the cells are selected if the mask is disabled
+     * \param sd the SubDataset to evaluate. It needs to be linked with a loaded VectorFieldDataset (sd->getParent())
+     * \param stride take one cell every "stride" cells along each axis (>= 1)
+     * \param output[out] the seeds (in grid coordinates) are appended to this array */
+    void seedsFromVolumetricMask(const SubDataset& sd, uint32_t stride, std::vector<glm::vec3>& output);
+}
+
+#endif
@@ -31,6 +31,11 @@ namespace sereno
      * xN-1yN-1zN-1 */
     uint8_t* getVTKStructuredGridColorArray(SubDataset* sd, uint32_t* sizeOutput = nullptr);
 
+    /** \brief  Get the color of each point of a subdataset being categorized as a Cloud Point. Multi-dimensional transfer functions use the point fields of the dataset in order
+     * \param sd the SubDataset to evaluate. It needs to be linked with a loaded Cloud Point (sd->getParent()) and have a valid transfer function
+     * \return  the RGBA array (one uint8_t per component) in the current point order of the dataset, or nullptr on error. Size: 4*nbPoints. Must be freed with free() */
+    uint8_t* getCloudPointColorArray(SubDataset* sd);
+
     /** \brief  Save the 3D image of a Subdataset object being categorized as a VTK Structured Grid
      *
      * The format written is, in binary (big endian):
@@ -51,10 +56,13 @@ namespace sereno
      * Position array (Nb Values: nbPoints * 3 components (x, y, z). Each component is a float
      * Color array (Nb Values: nbPoints * 4 components (r, g, b, a). Each component is a uint8_t)
      *
+     * Points are written in the order of the dataset file, even if the dataset was reordered. Points discarded by the volumetric mask (if enabled) are transparent black
+     *
      * \param sd the SubDataset to evaluate. It needs to be linked with a Cloud Point (sd->getParent()) and have a valid transfer function
      * \param path the path of the file on disk to write on
+     * \param onlySelected if true and if the volumetric mask is enabled, only the points selected by the volumetric mask are written
      * \return   true on success, false otherwise */
-    bool saveCloudPointVisual(SubDataset* sd, const std::string& path);
+    bool saveCloudPointVisual(SubDataset* sd, const std::string& path, bool onlySelected = false);
 }
 
 #endif
@@ -0,0 +1,120 @@
+#ifndef  SPACEFILLINGCURVE_INC
+#define  SPACEFILLINGCURVE_INC
+
+#include <cstdint>
+#include <cstddef>
+
+namespace sereno
+{
+    /** \brief  The number of bits per axis used by the 3D space filling curves (3*21 = 63 bits codes) */
+    #define SPACE_FILLING_CURVE_BITS 21
+
+    /** \brief  The 3D space filling curves available */
+    enum SpaceFillingCurveType
+    {
+        SPACE_FILLING_CURVE_MORTON  = 0, //Z-order curve. Cheap to compute
+        SPACE_FILLING_CURVE_HILBERT = 1  //Hilbert curve. Better locality (no jump between consecutive cells)
+    };
+
+    /** \brief  Spread the 21 lowest bits of v so that two zero bits separate each of them
+     * \param v the value to spread
+     * \return   the spread value */
+    inline uint64_t spreadBits3D(uint32_t v)
+    {
+        uint64_t x = v & 0x1fffff;
+        x = (x | (x << 32)) & 0x1f00000000ffffULL;
+        x = (x | (x << 16)) & 0x1f0000ff0000ffULL;
+        x = (x | (x << 8))  & 0x100f00f00f00f00fULL;
+        x = (x | (x << 4))  & 0x10c30c30c30c30c3ULL;
+        x = (x | (x << 2))  & 0x1249249249249249ULL;
+        return x;
+    }
+
+    /** \brief  Compute the 3D Morton code (Z-order) of a quantized position. The x component occupies the lowest bit of each triplet
+     * \param x the x quantized coordinate. Only the SPACE_FILLING_CURVE_BITS lowest bits are used
+     * \param y the y quantized coordinate. Only the SPACE_FILLING_CURVE_BITS lowest bits are used
+     * \param z the z quantized coordinate. Only the SPACE_FILLING_CURVE_BITS lowest bits are used
+     * \return   the 63 bits Morton code */
+    inline uint64_t mortonEncode3D(uint32_t x, uint32_t y, uint32_t z)
+    {
+        return spreadBits3D(x) | (spreadBits3D(y) << 1) | (spreadBits3D(z) << 2);
+    }
+
+    /** \brief  Compute the 3D Hilbert code of a quantized position (J. Skilling, "Programming the Hilbert curve", 2004)
+     * \param x the x quantized coordinate. Only the SPACE_FILLING_CURVE_BITS lowest bits are used
+     * \param y the y quantized coordinate. Only the SPACE_FILLING_CURVE_BITS lowest bits are used
+     * \param z the z quantized coordinate. Only the SPACE_FILLING_CURVE_BITS lowest bits are used
+     * \return   the 63 bits Hilbert code */
+    inline uint64_t hilbertEncode3D(uint32_t x, uint32_t y, uint32_t z)
+    {
+        const uint32_t M = 1u << (SPACE_FILLING_CURVE_BITS-1);
+        uint32_t X[3] = {x & 0x1fffff, y & 0x1fffff, z & 0x1fffff};
+
+        //Inverse undo
+        for(uint32_t Q = M; Q > 1; Q >>= 1)
+        {
+            uint32_t P = Q-1;
+            for(uint32_t i = 0; i < 3; i++)
+            {
+                if(X[i] & Q)
+                    X[0] ^= P;
+                else
+                {
+                    uint32_t t = (X[0] ^ X[i]) & P;
+                    X[0] ^= t;
+                    X[i] ^= t;
+                }
+            }
+        }
+
+        //Gray encode
+        X[1] ^= X[0];
+        X[2] ^= X[1];
+        uint32_t t = 0;
+        for(uint32_t Q = M; Q > 1; Q >>= 1)
+            if(X[2] & Q)
+                t ^= Q-1;
+        for(uint32_t i = 0; i < 3; i++)
+            X[i] ^= t;
+
+        //The transposed index stores the most significant bit of each triplet in X[0]
+        return spreadBits3D(X[2]) | (spreadBits3D(X[1]) << 1) | (spreadBits3D(X[0]) << 2);
+    }
+
+    /** \brief  Quantize a coordinate in [minVal, maxVal] over SPACE_FILLING_CURVE_BITS bits
+     * \param v the value to quantize
+     * \param minVal the minimum value of the domain
+     * \param invExtent 1.0f/(maxVal-minVal)
+     * \return   the quantized value, clamped in [0, 2^SPACE_FILLING_CURVE_BITS-1] */
+    inline uint32_t quantizeCoordinate(float v, float minVal, float invExtent)
+    {
+        const float maxQ = (float)((1u << SPACE_FILLING_CURVE_BITS) - 1);
+        float q = (v - minVal)*invExtent*(float)(1u << SPACE_FILLING_CURVE_BITS);
+        if(!(q > 0.0f)) //Handles NaN as well
+            return 0;
+        if(q > maxQ)
+            return (uint32_t)maxQ;
+        return (uint32_t)q;
+    }
+
+    /** \brief  Compute (in parallel if OpenMP is enabled) the space filling curve codes of 3D positions.
+     * This function does not lock ompMutex (see sciVisUtils.h): the caller must hold it when OpenMP is enabled
+     * \param positions the 3D positions (x1, y1, z1; x2, y2, z2; ...). Size: 3*nbPoints
+     * \param nbPoints the number of positions
+     * \param minPos the minimum position (x, y, z) of the positions' bounding box
+     * \param maxPos the maximum position (x, y, z) of the positions' bounding box
+     * \param type the space filling curve to use
+     * \param codes[out] the computed codes. Size: nbPoints */
+    void computeSpaceFillingCurveCodes(const float* positions, size_t nbPoints, const float* minPos, const float* maxPos, SpaceFillingCurveType type, uint64_t* codes);
+
+    /** \brief  Sort (in parallel if OpenMP is enabled) a list of keys and carry their associated values using a least significant digit radix sort. The sort is stable.
+     * This function does not lock ompMutex (see sciVisUtils.h): the caller must hold it when OpenMP is enabled
+     * \param keys the keys to sort. Size: n
+     * \param values the values associated with the keys, permuted in the same way. Size: n
+     * \param n the number of keys
+     * \param nbBits the number of low bits of the keys to consider (e.g., 63 for 3D Morton codes)
+     * \return   true on success, false if the temporary buffers could not be allocated (keys and values are then not modified) */
+    bool radixSort(uint64_t* keys, uint32_t* values, size_t n, uint32_t nbBits = 64);
+}
+
+#endif
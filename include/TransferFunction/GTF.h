@@ -92,15 +92,15 @@ namespace sereno
 
             /* \brief  Set the scaling along each axis of the GTF
              * \param scale the scaling along each axis of the GTF */
-            void setScale(float* scale) {for(uint32_t i = 0; i < m_dim; i++) m_scale[i] = scale[i];}
+            void setScale(float* scale) {for(uint32_t i = 0; i < m_dim; i++) m_scale[i] = scale[i]; updateVersion();}
 
             /* \brief  Set the center of the GTF
              * \param center the center of the GTF */
-            void setCenter(float* center) {for(uint32_t i = 0; i < m_dim; i++) m_center[i] = center[i];}
+            void setCenter(float* center) {for(uint32_t i = 0; i < m_dim; i++) m_center[i] = center[i]; updateVersion();}
 
             /* \brief  Set the alpha max of the GTF
              * \param alphaMax the alpha max */
-            void setAlphaMax(float alphaMax) {m_alphaMax = alphaMax;}
+            void setAlphaMax(float alphaMax) {m_alphaMax = alphaMax; updateVersion();}
 
             virtual TF* clone()
             {
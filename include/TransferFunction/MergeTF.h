@@ -127,6 +127,7 @@ namespace sereno
             void setInterpolationParameter(float t)
             {
                 m_t = t;
+                updateVersion();
             }
 
             /** \brief  Get the interpolation t parameter
@@ -136,6 +137,24 @@ namespace sereno
                 return m_t;
             }
 
+            /** \brief  Get the version of this transfer function, which changes as well when the merged transfer functions are modified.
+             * A new unique version is drawn whenever this object or one of the merged transfer functions changed since the last call,
+             * so that two MergeTF sharing a transfer function never share a version
+             * \return   the current version */
+            virtual uint64_t getVersion() const
+            {
+                uint64_t tf1Version = (m_tf1 ? m_tf1->getVersion() : 0);
+                uint64_t tf2Version = (m_tf2 ? m_tf2->getVersion() : 0);
+                if(m_ownVersion != m_version || m_tf1Version != tf1Version || m_tf2Version != tf2Version)
+                {
+                    m_ownVersion    = m_version;
+                    m_tf1Version    = tf1Version;
+                    m_tf2Version    = tf2Version;
+                    m_mergedVersion = nextTFVersion();
+                }
+                return m_mergedVersion;
+            }
+
             virtual TF* clone()
             {
                 return new MergeTF(*this);
@@ -144,6 +163,11 @@ namespace sereno
             std::shared_ptr<TF> m_tf1 = NULL; /*!< The first transfer function to interpolate at m_t==0.0f*/
             std::shared_ptr<TF> m_tf2 = NULL; /*!< The second transfer function to interpolate at m_t==1.0f*/
             float               m_t   = 0.0f; /*!< The linear interpolation parameter*/
+
+            mutable uint64_t m_ownVersion    = 0; /*!< m_version when m_mergedVersion was drawn*/
+            mutable uint64_t m_tf1Version    = 0; /*!< The version of m_tf1 when m_mergedVersion was drawn*/
+            mutable uint64_t m_tf2Version    = 0; /*!< The version of m_tf2 when m_mergedVersion was drawn*/
+            mutable uint64_t m_mergedVersion = 0; /*!< The version returned by getVersion. 0 if not drawn yet*/
     };
 }
 
@@ -6,6 +6,7 @@
 #include "SciVisColor.h"
 #include <algorithm>
 #include <vector>
+#include <atomic>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -13,6 +14,14 @@
 
 namespace sereno
 {
+    /** \brief  Get a new transfer function version. Versions are unique among all the transfer functions
+     * \return   a version greater than all the previous ones */
+    inline uint64_t nextTFVersion()
+    {
+        static std::atomic<uint64_t> version(0);
+        return ++version;
+    }
+
     /** \brief  Basic class for transfer function computation */
     class TF
     {
@@ -42,6 +51,7 @@ namespace sereno
                     m_currentTimestep = copy.m_currentTimestep;
                     m_minClipping     = copy.m_minClipping;
                     m_maxClipping     = copy.m_maxClipping;
+                    updateVersion();
                 }
 
                 return *this;
@@ -90,7 +100,7 @@ namespace sereno
 
             /* \brief  Get the color mode of this transfer function
              * \param mode the new transfer function color mode */
-            void setColorMode(ColorMode mode) {m_mode = mode;}
+            void setColorMode(ColorMode mode) {m_mode = mode; updateVersion();}
 
             /* \brief  Is this Transfer function taking into account the gradient of the field?
              * \return  true if this transfer function uses the gradient of the field as a dimension, false otherwise */
@@ -98,7 +108,7 @@ namespace sereno
 
             /** \brief  set the array of the enabled dimensions.
              * \param ids the array of the enabled dimensions. ids[i] == dimensions[i].enabled (false if not enabled, true otherwise) */
-            virtual void setEnabledDimensions(const std::vector<bool>& ids) {m_enabled = ids;}
+            virtual void setEnabledDimensions(const std::vector<bool>& ids) {m_enabled = ids; updateVersion();}
 
             /** \brief  get the array of the enabled dimensions.
              * \return the enabled dimensions. array[i] == dimensions[i].enabled.*/
@@ -110,7 +120,7 @@ namespace sereno
 
             /** \brief Set the current timestep to apply to your data visualization
              * \param t the current timestep to apply. Must be positive. */
-            void setCurrentTimestep(float t) {m_currentTimestep = t;}
+            void setCurrentTimestep(float t) {m_currentTimestep = t; updateVersion();}
 
             /** \brief Set the clipping values of this transfer function
              * \param min the minimum clipping value in the dimension format (between 0.0f and 1.0f). Default: 0.0f
@@ -121,6 +131,7 @@ namespace sereno
                 m_maxClipping = std::min(std::max(max, 0.0f), 1.0f);
                 if(m_minClipping > m_maxClipping)
                     std::swap(m_minClipping, m_maxClipping);
+                updateVersion();
             }
 
             /** \brief Get the min clipping value to use to adapt the indexes correctly 
@@ -131,6 +142,14 @@ namespace sereno
              * \return The max clipping value in use*/
             float getMaxClipping() const {return m_maxClipping;}
 
+            /** \brief  Get the version of this transfer function, changed by every modification. As versions are unique among all the transfer functions,
+             * the version alone identifies the state of a transfer function, e.g., to cache colors computed with it
+             * \return   the current version */
+            virtual uint64_t getVersion() const {return m_version;}
+
+            /** \brief  Change the version of this transfer function. This is called by the setters, and should be called after any other modification */
+            void updateVersion() {m_version = nextTFVersion();}
+
             virtual TF* clone()
             {
                 return new TF(*this);
@@ -142,6 +161,7 @@ namespace sereno
             float     m_currentTimestep = 0; /*!< The current timestep*/
             float     m_minClipping     = 0;
             float     m_maxClipping     = 1;
+            uint64_t  m_version         = nextTFVersion(); /*!< The version of the transfer function (see getVersion)*/
     };
 
     /* \brief  Compute the transfer function texels. The dimension of the transfer function must be inferior at 1024
@@ -134,6 +134,7 @@ namespace sereno
             {
                 for(uint8_t i = 0; i < m_dim-1; i++) 
                     m_scale[i] = scale[i];
+                updateVersion();
             }
             /**
              * \brief  Set the center of the TriangularGTF
@@ -143,12 +144,13 @@ namespace sereno
             {
                 for(uint8_t i = 0; i < m_dim-1; i++) 
                     m_center[i] = center[i];
+                updateVersion();
             }
             /**
              * \brief  Set the alpha max of the TriangularGTF
              * \param alphaMax the alpha max
              */
-            void setAlphaMax(float alphaMax) {m_alphaMax = alphaMax;}
+            void setAlphaMax(float alphaMax) {m_alphaMax = alphaMax; updateVersion();}
 
             virtual bool hasGradient() const {return true;}
 
@@ -6,15 +6,26 @@
 
 #include <vector>
 #include <algorithm>
+#include <cstdint>
 #include <glm/glm.hpp>
 
 namespace sereno
 {
     /** \brief Compute the indice array which defines the triangles to create for the polygon passing in parameter at construction time
      * \param points the polygon points to triangulate
-     * \return indice array of the polygon points*/
+     * \return indice array of the polygon points. Triangles are clockwise*/
     std::vector<int> triangulate(const std::vector<glm::vec2>& points);
 
+    /** \brief  Triangulate a polygon with holes by ear clipping. Candidate ears are only tested against the vertices whose z-order code lies in the ear's bounding box,
+     * which keeps the triangulation close to O(n log n) for the long lasso polygons drawn on tablets.
+     * Duplicated points, self-touching rings and small self-intersections are tolerated (adapted from mapbox's earcut, ISC license).
+     * \param points the polygon points: the outer ring, followed by the rings of the holes. The orientation of the rings does not matter
+     * \param holeIndices the index in points of the first point of each hole, in increasing order
+     * \param output[out] the buffer receiving the indices (in points) of the triangles, three per triangle. Triangles are counter-clockwise.
+     * Its previous content is discarded but its capacity is reused
+     * \return the number of triangles written in output*/
+    size_t triangulate(const std::vector<glm::vec2>& points, const std::vector<uint32_t>& holeIndices, std::vector<uint32_t>& output);
+
     /** \brief is point P inside the triangle ABC?
      * \return true if yes, false otherwise */
     bool insideTriangle(const glm::vec2& A, const glm::vec2& B, const glm::vec2& C, const glm::vec2& P);
@@ -16,33 +16,41 @@ namespace sereno
         SELECTION_OP_INTER = 2   //Perform an intersection
     };
 
+    /** \brief  The inside/outside tests available for volumetric selections */
+    enum VolumetricSelectionPrecision
+    {
+        SELECTION_PRECISION_FAST           = 0, //Ray casting with a floating-point ray/triangle test. Rays hitting edges or vertices may be miscounted
+        SELECTION_PRECISION_WATERTIGHT     = 1, //Ray casting with a watertight ray/triangle test: rays hitting shared edges or vertices are counted exactly once
+        SELECTION_PRECISION_WINDING_NUMBER = 2  //Generalized winding number. Robust to holes and self-intersections of the mesh. Costs as much as SELECTION_PRECISION_WATERTIGHT on closed meshes,
+                                                //but open meshes pay for the hierarchical winding number of their holes: up to 2-4 times the cost of SELECTION_PRECISION_FAST on cloud points for large holes
+    };
+
     /** \brief  The volumetric mesh data to use */
     struct VolumetricMesh
     {
-        std::vector<glm::vec3> points;    /*!< The list of points for this mesh*/
-        std::vector<uint32_t>  triangles; /*!< The points IDs ordered to form triangles (each 3 values form a triangle)*/
-        BooleanSelectionOp     op;        /*!< The boolean operation to do with this mesh*/
+        std::vector<glm::vec3>       points;    /*!< The list of points for this mesh*/
+        std::vector<uint32_t>        triangles; /*!< The points IDs ordered to form triangles (each 3 values form a triangle)*/
+        BooleanSelectionOp           op;        /*!< The boolean operation to do with this mesh*/
+        VolumetricSelectionPrecision precision; /*!< The inside/outside test to use*/
 
-        VolumetricMesh(BooleanSelectionOp _op = SELECTION_OP_NONE) : op(_op){}
+        VolumetricMesh(BooleanSelectionOp _op = SELECTION_OP_NONE, VolumetricSelectionPrecision _precision = SELECTION_PRECISION_FAST) : op(_op), precision(_precision){}
     };
 
-    /** \brief  Our rastered cube space to fasten computation */
-    struct RasteredCube
-    {
-        /** \brief The list of triangle being part of this Cube (in a rastered space)*/
-        std::vector<int> triangleIDs;
-
-        /** \brief   The maximum number of triangle a particular being on this cell might need to go through for the whole algorithm */
-        int maxNbTriangle = 0;
-
-        /** \brief  Operator to fasten the access of triangleIDs
-         * \param x the indice of triangleIDs to get
-         * \return   triangleIDs[x] */
-        int operator[](int x)
-        {
-            return triangleIDs[x];
-        }
-    };
+    /** \brief  Build the closed mesh of a 2D lasso extruded along the view direction, ready for applyVolumetricSelection_*.
+     * The lasso is triangulated directly into mesh.triangles to form the near and far caps, and each of its edges forms a side quad.
+     * Triangles are oriented outward whatever the orientation of the lasso rings.
+     *
+     * \param polygon the lasso points in view space (x, y): the outer ring, followed by the rings of the holes (see triangulate())
+     * \param holeIndices the index in polygon of the first point of each hole, in increasing order
+     * \param viewMatrix the world to view space matrix. The view looks toward -z
+     * \param minDepth the distance from the view of the near cap
+     * \param maxDepth the distance from the view of the far cap. Must be greater than minDepth
+     * \param perspective if true, the lasso is given on the plane at a unit distance from the view and is extruded as a frustum (its points are scaled by the depth).
+     * Otherwise the lasso is extruded as a prism
+     * \param mesh[out] the mesh to fill. Its points and triangles are replaced (their capacity is reused), its operation and precision are not modified
+     * \return   false if the lasso could not be triangulated or if the depth range is empty, true otherwise */
+    bool buildExtrudedLassoMesh(const std::vector<glm::vec2>& polygon, const std::vector<uint32_t>& holeIndices, const glm::mat4& viewMatrix,
+                                float minDepth, float maxDepth, bool perspective, VolumetricMesh& mesh);
 
     /** \brief  Apply the volumetric selection on a CloudPoint SubDataset object
      *
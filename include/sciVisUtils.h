@@ -92,6 +92,37 @@ namespace serenoSciVis
     }
 #pragma GCC diagnostic pop
 
+    /* \brief Swap the bytes of a 32 bits value (big endian <-> little endian)
+     * \param v the value to swap
+     * \return the swapped value */
+    inline uint32_t byteSwap32(uint32_t v)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_bswap32(v);
+#else
+        return ((v & 0xff) << 24) | ((v & 0xff00) << 8) | ((v >> 8) & 0xff00) | (v >> 24);
+#endif
+    }
+
+    /* \brief Convert an array of big endian floats to native floats. The loop is written so that compilers can vectorize it
+     * \param dst the native float array. Size: n
+     * \param src the big endian raw data. Size: n*sizeof(float). No alignment is required
+     * \param n the number of floats to convert */
+    inline void bigEndianToFloats(float* dst, const uint8_t* src, size_t n)
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        memcpy(dst, src, n*sizeof(float));
+#else
+        for(size_t i = 0; i < n; i++)
+        {
+            uint32_t v;
+            memcpy(&v, src + i*sizeof(float), sizeof(float));
+            v = byteSwap32(v);
+            memcpy(dst + i, &v, sizeof(float));
+        }
+#endif
+    }
+
 
 #if __cplusplus > 201703L
         /**
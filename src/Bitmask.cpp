@@ -0,0 +1,270 @@
+#include "Bitmask.h"
+#include <cstdlib>
+#include <cstring>
+#include <bitset>
+#include <utility>
+
+#ifndef MIN
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#endif
+
+namespace sereno
+{
+    /** \brief  Count the bits set to 1 in a word
+     * \param w the word
+     * \return   the number of bits set to 1 */
+    static inline uint32_t _popcount64(uint64_t w)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_popcountll(w);
+#else
+        return std::bitset<64>(w).count();
+#endif
+    }
+
+    /** \brief  Get the position of the lowest bit set to 1 in a non-zero byte
+     * \param b the byte. Must not be 0
+     * \return   the position of the lowest bit set */
+    static inline uint32_t _lowestBit8(uint8_t b)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctz(b);
+#else
+        uint32_t i = 0;
+        while(!(b & (1 << i)))
+            i++;
+        return i;
+#endif
+    }
+
+    Bitmask::Bitmask(size_t nbBits, bool value)
+    {
+        resize(nbBits, value);
+    }
+
+    Bitmask::Bitmask(const Bitmask& copy)
+    {
+        *this = copy;
+    }
+
+    Bitmask::Bitmask(Bitmask&& mvt)
+    {
+        *this = std::move(mvt);
+    }
+
+    Bitmask::~Bitmask()
+    {
+        if(m_words)
+            free(m_words);
+    }
+
+    Bitmask& Bitmask::operator=(const Bitmask& copy)
+    {
+        if(this != &copy)
+        {
+            resize(copy.m_nbBits);
+            if(m_words)
+                memcpy(m_words, copy.m_words, getNbWords()*sizeof(uint64_t));
+        }
+        return *this;
+    }
+
+    Bitmask& Bitmask::operator=(Bitmask&& mvt)
+    {
+        if(this != &mvt)
+        {
+            std::swap(m_words,  mvt.m_words);
+            std::swap(m_nbBits, mvt.m_nbBits);
+        }
+        return *this;
+    }
+
+    void Bitmask::resize(size_t nbBits, bool value)
+    {
+        if(getNbWords() != (nbBits+63)/64)
+        {
+            if(m_words)
+                free(m_words);
+            m_words = (nbBits ? (uint64_t*)malloc(sizeof(uint64_t)*((nbBits+63)/64)) : NULL);
+        }
+        m_nbBits = nbBits;
+        reset(value);
+    }
+
+    void Bitmask::reset(bool value)
+    {
+        if(m_words == NULL)
+            return;
+        memset(m_words, (value ? 0xff : 0x00), getNbWords()*sizeof(uint64_t));
+        clearTail();
+    }
+
+    void Bitmask::clearTail()
+    {
+        //Clear the bytes, then the bits, beyond m_nbBits
+        uint8_t* bytes = data();
+        size_t   nbBytes = getNbBytes();
+        memset(bytes + nbBytes, 0x00, getNbWords()*sizeof(uint64_t) - nbBytes);
+        if(m_nbBits % 8)
+            bytes[nbBytes-1] &= (1 << (m_nbBits%8)) - 1;
+    }
+
+    void Bitmask::setRange(size_t begin, size_t end, bool value)
+    {
+        end = MIN(end, m_nbBits);
+        if(begin >= end)
+            return;
+
+        //Bits up to the first byte boundary
+        for(; begin < end && begin % 8; begin++)
+            set(begin, value);
+
+        //Whole bytes
+        size_t nbBytes = (end - begin)/8;
+        memset(data() + begin/8, (value ? 0xff : 0x00), nbBytes);
+        begin += 8*nbBytes;
+
+        //Remaining bits
+        for(; begin < end; begin++)
+            set(begin, value);
+    }
+
+    size_t Bitmask::count() const
+    {
+        size_t result = 0;
+        for(size_t w = 0; w < getNbWords(); w++)
+            result += _popcount64(m_words[w]);
+        return result;
+    }
+
+    bool Bitmask::any() const
+    {
+        for(size_t w = 0; w < getNbWords(); w++)
+            if(m_words[w])
+                return true;
+        return false;
+    }
+
+    bool Bitmask::all() const
+    {
+        return count() == m_nbBits;
+    }
+
+    void Bitmask::combine(const uint8_t* other, size_t nbBits, BitmaskOp op, size_t offset)
+    {
+        if(offset >= m_nbBits)
+            return;
+        nbBits = MIN(nbBits, m_nbBits - offset);
+        uint64_t* words = m_words + offset/64;
+
+        //Full words. memcpy permits unaligned sources and is turned into a plain load by compilers
+        const size_t nbWords = nbBits/64;
+        switch(op)
+        {
+            case BITMASK_OP_COPY:
+                memcpy(words, other, nbWords*sizeof(uint64_t));
+                break;
+            case BITMASK_OP_OR:
+                for(size_t w = 0; w < nbWords; w++)
+                {
+                    uint64_t o;
+                    memcpy(&o, other + w*sizeof(uint64_t), sizeof(uint64_t));
+                    words[w] |= o;
+                }
+                break;
+            case BITMASK_OP_AND:
+                for(size_t w = 0; w < nbWords; w++)
+                {
+                    uint64_t o;
+                    memcpy(&o, other + w*sizeof(uint64_t), sizeof(uint64_t));
+                    words[w] &= o;
+                }
+                break;
+            case BITMASK_OP_ANDNOT:
+                for(size_t w = 0; w < nbWords; w++)
+                {
+                    uint64_t o;
+                    memcpy(&o, other + w*sizeof(uint64_t), sizeof(uint64_t));
+                    words[w] &= ~o;
+                }
+                break;
+            case BITMASK_OP_XOR:
+                for(size_t w = 0; w < nbWords; w++)
+                {
+                    uint64_t o;
+                    memcpy(&o, other + w*sizeof(uint64_t), sizeof(uint64_t));
+                    words[w] ^= o;
+                }
+                break;
+        }
+
+        //Remaining bits, byte per byte
+        uint8_t* bytes = (uint8_t*)words;
+        for(size_t b = nbWords*sizeof(uint64_t); b < (nbBits+7)/8; b++)
+        {
+            //Do not touch the bits of this mask that "other" does not have
+            uint8_t valid = (8*(b+1) <= nbBits ? 0xff : (1 << (nbBits%8)) - 1);
+            uint8_t o     = other[b] & valid;
+            switch(op)
+            {
+                case BITMASK_OP_COPY:
+                    bytes[b] = (bytes[b] & ~valid) | o;
+                    break;
+                case BITMASK_OP_OR:
+                    bytes[b] |= o;
+                    break;
+                case BITMASK_OP_AND:
+                    bytes[b] &= o | ~valid;
+                    break;
+                case BITMASK_OP_ANDNOT:
+                    bytes[b] &= ~o;
+                    break;
+                case BITMASK_OP_XOR:
+                    bytes[b] ^= o;
+                    break;
+            }
+        }
+    }
+
+    size_t Bitmask::findNext(size_t from, size_t end) const
+    {
+        end = MIN(end, m_nbBits);
+        if(from >= end)
+            return end;
+
+        const uint8_t* bytes    = data();
+        const size_t   lastByte = (end+7)/8;
+        size_t         b        = from/8;
+
+        //Returns the first bit of a non-zero byte, if before "end"
+        auto found = [&](size_t byteID)
+        {
+            size_t x = 8*byteID + _lowestBit8(bytes[byteID]);
+            return MIN(x, end);
+        };
+
+        //Finish the current word byte per byte
+        uint8_t first = bytes[b] & (0xff << (from%8));
+        if(first)
+            return MIN(8*b + _lowestBit8(first), end);
+
+        for(b = b+1; b % sizeof(uint64_t) && b < lastByte; b++)
+            if(bytes[b])
+                return found(b);
+        if(b >= lastByte)
+            return end;
+
+        //Skip the empty words
+        for(size_t w = b/sizeof(uint64_t); w*sizeof(uint64_t) < lastByte; w++)
+        {
+            if(m_words[w] == 0)
+                continue;
+            for(b = w*sizeof(uint64_t); b < lastByte; b++)
+                if(bytes[b])
+                    return found(b);
+            break;
+        }
+
+        return end;
+    }
+}
@@ -1,4 +1,27 @@
 #include "CSVParser.h"
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/** \brief  The minimum size of the ranges returned by splitCSVRows */
+#define CSV_MIN_RANGE_SIZE (1 << 20)
+
+/** \brief  Count the quotes of a buffer
+ * \param begin the beginning of the buffer
+ * \param end the end of the buffer
+ * \return   the number of '"' characters in [begin, end[ */
+static size_t countQuotes(const char* begin, const char* end)
+{
+    size_t count = 0;
+    while(begin < end && (begin = (const char*)memchr(begin, '"', end-begin)))
+    {
+        count++;
+        begin++;
+    }
+    return count;
+}
 
 std::vector<std::string> getCSVLineTokens(std::istream& str, char separator)
 {
@@ -59,3 +82,271 @@ std::vector<std::string> getCSVLineTokens(std::istream& str, char separator)
     return result;
 }
 
+/** \brief  Read the tokens of a CSV row with the same state machine as getCSVLineTokens, character by character. Used for the rows the field-wise parser does not handle
+ * (e.g., quotes in the middle of a token). See getCSVRowTokens for the parameters */
+static const char* getCSVRowTokensSlow(const char* begin, const char* end, std::vector<std::string_view>& tokens, std::string& scratch, char separator)
+{
+    std::vector<size_t> cellEnds;
+    bool inStr         = false;
+    bool inSecondQuote = false;
+    const char* p      = begin;
+
+    tokens.clear();
+    scratch.clear();
+    for(; p < end; p++)
+    {
+        char c = *p;
+        if(c == '"')
+        {
+            if(inStr)
+            {
+                if(inSecondQuote)
+                {
+                    scratch += '"';
+                    inSecondQuote = false;
+                }
+                else
+                    inSecondQuote = true;
+            }
+            else
+                inStr = true;
+            continue;
+        }
+
+        if(inSecondQuote)
+        {
+            inStr = false;
+            inSecondQuote = false;
+        }
+
+        if(inStr)
+            scratch += c;
+        else if(c == separator)
+            cellEnds.push_back(scratch.size());
+        else if(c == '\n')
+        {
+            p++;
+            break;
+        }
+        else if(c != '\r') //remove carriage return
+            scratch += c;
+    }
+    cellEnds.push_back(scratch.size());
+
+    size_t cellBegin = 0;
+    for(size_t cellEnd : cellEnds)
+    {
+        tokens.emplace_back(scratch.data()+cellBegin, cellEnd-cellBegin);
+        cellBegin = cellEnd;
+    }
+    return p;
+}
+
+const char* getCSVRowTokens(const char* begin, const char* end, std::vector<std::string_view>& tokens, std::string& scratch, char separator)
+{
+    tokens.clear();
+    if(begin >= end)
+        return end;
+
+    const char* newLine = (const char*)memchr(begin, '\n', end-begin);
+    const char* lineEnd = (newLine ? newLine : end);
+
+    //Fast path: no quote, the tokens are views on the buffer
+    if(!memchr(begin, '"', lineEnd-begin))
+    {
+        const char* next = (newLine ? newLine+1 : end);
+        if(lineEnd > begin && lineEnd[-1] == '\r') //remove carriage return
+            lineEnd--;
+        if(lineEnd == begin)
+            return next;
+
+        for(const char* p = begin;;)
+        {
+            const char* sep = (const char*)memchr(p, separator, lineEnd-p);
+            if(!sep)
+            {
+                tokens.emplace_back(p, lineEnd-p);
+                break;
+            }
+            tokens.emplace_back(p, sep-p);
+            p = sep+1;
+        }
+        return next;
+    }
+
+    //Field by field: quoted tokens are views too, unless they contain escaped quotes. Those are unescaped in scratch, and their views are set once the row is read
+    struct EscapedToken
+    {
+        size_t token;
+        size_t offset;
+        size_t size;
+    };
+    thread_local std::vector<EscapedToken> escaped;
+    escaped.clear();
+    scratch.clear();
+
+    const char* p = begin;
+    while(true)
+    {
+        if(p < end && *p == '"')
+        {
+            const char* q         = p+1;
+            const char* quote     = NULL;
+            size_t      offset    = scratch.size();
+            bool        hasEscape = false;
+            while(true)
+            {
+                quote = (const char*)memchr(q, '"', end-q);
+                if(!quote) //Unterminated string
+                    return getCSVRowTokensSlow(begin, end, tokens, scratch, separator);
+                if(quote+1 < end && quote[1] == '"')
+                {
+                    scratch.append((hasEscape ? q : p+1), quote+1);
+                    hasEscape = true;
+                    q = quote+2;
+                    continue;
+                }
+                break;
+            }
+
+            if(hasEscape)
+            {
+                scratch.append(q, quote);
+                escaped.push_back({tokens.size(), offset, scratch.size()-offset});
+                tokens.emplace_back();
+            }
+            else
+                tokens.emplace_back(p+1, quote-p-1);
+
+            //The string must be followed by a separator or the end of the row
+            p = quote+1;
+            if(p >= end)
+                break;
+            if(*p == separator)
+            {
+                p++;
+                continue;
+            }
+            if(*p == '\r' && (p+1 == end || p[1] == '\n'))
+                p++;
+            if(p >= end)
+                break;
+            if(*p == '\n')
+            {
+                p++;
+                break;
+            }
+            return getCSVRowTokensSlow(begin, end, tokens, scratch, separator);
+        }
+        else
+        {
+            //The newline found may have been inside a previous quoted token
+            if(lineEnd < p)
+            {
+                newLine = (const char*)memchr(p, '\n', end-p);
+                lineEnd = (newLine ? newLine : end);
+            }
+
+            const char* sep      = (const char*)memchr(p, separator, lineEnd-p);
+            const char* tokenEnd = (sep ? sep : lineEnd);
+            if(memchr(p, '"', tokenEnd-p))
+                return getCSVRowTokensSlow(begin, end, tokens, scratch, separator);
+
+            if(sep)
+            {
+                tokens.emplace_back(p, sep-p);
+                p = sep+1;
+                continue;
+            }
+
+            if(tokenEnd > p && tokenEnd[-1] == '\r') //remove carriage return
+                tokenEnd--;
+            tokens.emplace_back(p, tokenEnd-p);
+            p = (newLine ? newLine+1 : end);
+            break;
+        }
+    }
+
+    for(const EscapedToken& e : escaped)
+        tokens[e.token] = std::string_view(scratch.data()+e.offset, e.size);
+    return p;
+}
+
+std::vector<const char*> splitCSVRows(const char* begin, const char* end, size_t nbRanges)
+{
+    const size_t size = end - begin;
+    if(nbRanges > size/CSV_MIN_RANGE_SIZE)
+        nbRanges = size/CSV_MIN_RANGE_SIZE;
+    if(nbRanges < 1)
+        nbRanges = 1;
+
+    //The quote parity tells whether a position is inside a quoted string ("" escapes count twice)
+    std::vector<size_t> nbQuotes(nbRanges, 0);
+#if defined(_OPENMP)
+    #pragma omp parallel for schedule(static)
+#endif
+    for(int64_t i = 0; i < (int64_t)nbRanges; i++)
+        nbQuotes[i] = countQuotes(begin + size*i/nbRanges, begin + size*(i+1)/nbRanges);
+
+    //Move each nominal boundary to the next row beginning outside any quoted string
+    std::vector<const char*> bounds(1, begin);
+    bool inStr = false;
+    for(size_t i = 1; i < nbRanges; i++)
+    {
+        inStr ^= (nbQuotes[i-1] & 1);
+
+        const char* p     = begin + size*i/nbRanges;
+        bool        quote = inStr;
+        if(p < bounds.back())
+            continue;
+        while(p < end)
+        {
+            const char* newLine = (const char*)memchr(p, '\n', end-p);
+            if(!newLine)
+            {
+                p = end;
+                break;
+            }
+            quote ^= (countQuotes(p, newLine) & 1);
+            p = newLine+1;
+            if(!quote)
+                break;
+        }
+
+        if(p > bounds.back() && p < end)
+            bounds.push_back(p);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+const char* getCSVCompleteRowsEnd(const char* begin, const char* end)
+{
+    const char* result   = begin;
+    bool        inStr    = false;
+    const char* segBegin = begin;
+
+    //Browse the segments between quotes, looking for the last newline of the segments outside quoted strings
+    while(segBegin < end)
+    {
+        const char* quote  = (const char*)memchr(segBegin, '"', end-segBegin);
+        const char* segEnd = (quote ? quote : end);
+        if(!inStr)
+        {
+            for(const char* c = segEnd; c > segBegin; c--)
+            {
+                if(c[-1] == '\n')
+                {
+                    result = c;
+                    break;
+                }
+            }
+        }
+
+        if(!quote)
+            break;
+        inStr    = !inStr;
+        segBegin = quote+1;
+    }
+    return result;
+}
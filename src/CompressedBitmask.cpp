@@ -0,0 +1,303 @@
+#include "CompressedBitmask.h"
+#include <algorithm>
+#include <cstring>
+#include <bitset>
+
+#ifndef MIN
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#endif
+
+namespace sereno
+{
+    /** \brief  The number of 64-bit words of a chunk bitmap */
+    #define CHUNK_WORDS (CompressedBitmask::CHUNK_BITS/64)
+
+    /** \brief  Count the bits set to 1 in a word
+     * \param w the word
+     * \return   the number of bits set to 1 */
+    static inline uint32_t _popcount64(uint64_t w)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_popcountll(w);
+#else
+        return std::bitset<64>(w).count();
+#endif
+    }
+
+    CompressedBitmask::CompressedBitmask(size_t nbBits, bool value)
+    {
+        resize(nbBits, value);
+    }
+
+    CompressedBitmask::CompressedBitmask(const Bitmask& mask)
+    {
+        assign(mask);
+    }
+
+    void CompressedBitmask::resize(size_t nbBits, bool value)
+    {
+        m_nbBits = nbBits;
+        m_chunks.clear();
+        m_chunks.resize((nbBits + CHUNK_BITS - 1)/CHUNK_BITS);
+        reset(value);
+    }
+
+    void CompressedBitmask::reset(bool value)
+    {
+        for(size_t c = 0; c < m_chunks.size(); c++)
+            setUniform(m_chunks[c], c, value);
+    }
+
+    void CompressedBitmask::setUniform(Chunk& chunk, size_t c, bool value)
+    {
+        chunk.type        = (value ? CHUNK_FULL : CHUNK_EMPTY);
+        chunk.cardinality = (value ? getChunkSize(c) : 0);
+        chunk.array       = nullptr;
+        chunk.bitmap      = nullptr;
+    }
+
+    void CompressedBitmask::assign(const Bitmask& mask)
+    {
+        resize(mask.size(), false);
+
+        const uint64_t* words   = mask.getWords();
+        const size_t    nbWords = mask.getNbWords();
+        for(size_t c = 0; c < m_chunks.size(); c++)
+        {
+            Chunk&          chunk      = m_chunks[c];
+            const uint64_t* chunkWords = words + c*CHUNK_WORDS;
+            const size_t    chunkNbWords = MIN(CHUNK_WORDS, nbWords - c*CHUNK_WORDS);
+
+            //The bits beyond mask.size() are 0: the popcount of the words is the cardinality
+            uint32_t cardinality = 0;
+            for(size_t w = 0; w < chunkNbWords; w++)
+                cardinality += _popcount64(chunkWords[w]);
+
+            if(cardinality == 0 || cardinality == getChunkSize(c))
+                setUniform(chunk, c, cardinality != 0);
+            else if(cardinality <= ARRAY_MAX_SIZE)
+            {
+                chunk.type        = CHUNK_ARRAY;
+                chunk.cardinality = cardinality;
+                chunk.array       = std::make_shared<std::vector<uint16_t>>();
+                chunk.array->reserve(cardinality);
+                mask.forEachSet(c*CHUNK_BITS, c*CHUNK_BITS + getChunkSize(c), [&](size_t x) {chunk.array->push_back(x - c*CHUNK_BITS);});
+            }
+            else
+            {
+                chunk.type        = CHUNK_BITMAP;
+                chunk.cardinality = cardinality;
+                chunk.bitmap      = std::make_shared<std::vector<uint64_t>>(CHUNK_WORDS, 0);
+                memcpy(chunk.bitmap->data(), chunkWords, chunkNbWords*sizeof(uint64_t));
+            }
+        }
+    }
+
+    bool CompressedBitmask::get(size_t x) const
+    {
+        const Chunk& chunk = m_chunks[x/CHUNK_BITS];
+        const size_t y     = x%CHUNK_BITS;
+        switch(chunk.type)
+        {
+            case CHUNK_FULL:
+                return true;
+            case CHUNK_ARRAY:
+                return std::binary_search(chunk.array->begin(), chunk.array->end(), (uint16_t)y);
+            case CHUNK_BITMAP:
+                return ((const uint8_t*)chunk.bitmap->data())[y/8] & (1 << (y%8));
+            default:
+                return false;
+        }
+    }
+
+    void CompressedBitmask::set(size_t x, bool b)
+    {
+        const size_t c     = x/CHUNK_BITS;
+        const size_t y     = x%CHUNK_BITS;
+        Chunk&       chunk = m_chunks[c];
+
+        if(get(x) == b)
+            return;
+
+        switch(chunk.type)
+        {
+            case CHUNK_EMPTY:
+                chunk.type  = CHUNK_ARRAY;
+                chunk.array = std::make_shared<std::vector<uint16_t>>(1, (uint16_t)y);
+                break;
+
+            case CHUNK_ARRAY:
+            {
+                //Copy on write
+                if(chunk.array.use_count() > 1)
+                    chunk.array = std::make_shared<std::vector<uint16_t>>(*chunk.array);
+
+                std::vector<uint16_t>& array = *chunk.array;
+                auto it = std::lower_bound(array.begin(), array.end(), (uint16_t)y);
+                if(b)
+                    array.insert(it, (uint16_t)y);
+                else
+                    array.erase(it);
+
+                if(array.size() > ARRAY_MAX_SIZE)
+                {
+                    std::shared_ptr<std::vector<uint64_t>> bitmap = std::make_shared<std::vector<uint64_t>>(CHUNK_WORDS, 0);
+                    expandChunk(c, bitmap->data());
+                    chunk.type   = CHUNK_BITMAP;
+                    chunk.array  = nullptr;
+                    chunk.bitmap = bitmap;
+                }
+                break;
+            }
+
+            case CHUNK_FULL:
+            {
+                chunk.bitmap = std::make_shared<std::vector<uint64_t>>(CHUNK_WORDS, 0);
+                expandChunk(c, chunk.bitmap->data());
+                chunk.type = CHUNK_BITMAP;
+                [[fallthrough]]; //Clear the bit in the bitmap
+            }
+
+            case CHUNK_BITMAP:
+            {
+                if(chunk.bitmap.use_count() > 1)
+                    chunk.bitmap = std::make_shared<std::vector<uint64_t>>(*chunk.bitmap);
+
+                uint8_t* bytes = (uint8_t*)chunk.bitmap->data();
+                if(b)
+                    bytes[y/8] |= (1 << (y%8));
+                else
+                    bytes[y/8] &= ~(1 << (y%8));
+                break;
+            }
+        }
+
+        if(b)
+            chunk.cardinality++;
+        else
+            chunk.cardinality--;
+        if(chunk.cardinality == 0 || chunk.cardinality == getChunkSize(c))
+            setUniform(chunk, c, chunk.cardinality != 0);
+    }
+
+    size_t CompressedBitmask::count() const
+    {
+        size_t result = 0;
+        for(const Chunk& chunk : m_chunks)
+            result += chunk.cardinality;
+        return result;
+    }
+
+    bool CompressedBitmask::any() const
+    {
+        for(const Chunk& chunk : m_chunks)
+            if(chunk.cardinality)
+                return true;
+        return false;
+    }
+
+    size_t CompressedBitmask::findNext(size_t from, size_t end) const
+    {
+        end = MIN(end, m_nbBits);
+        size_t result = end;
+        for(size_t c = from/CHUNK_BITS; c*CHUNK_BITS < end && result == end; c++)
+        {
+            if(m_chunks[c].type == CHUNK_EMPTY)
+                continue;
+
+            //The first range of the chunk starts at the first bit set
+            chunkRanges(c, from, end, [&](size_t b, size_t) {result = MIN(result, b);});
+        }
+        return result;
+    }
+
+    void CompressedBitmask::expandChunk(size_t c, uint64_t* words) const
+    {
+        const Chunk& chunk = m_chunks[c];
+        switch(chunk.type)
+        {
+            case CHUNK_EMPTY:
+                memset(words, 0x00, CHUNK_WORDS*sizeof(uint64_t));
+                break;
+            case CHUNK_FULL:
+            {
+                const size_t nbBits = getChunkSize(c);
+                uint8_t*     bytes  = (uint8_t*)words;
+                memset(words, 0x00, CHUNK_WORDS*sizeof(uint64_t));
+                memset(bytes, 0xff, nbBits/8);
+                if(nbBits%8)
+                    bytes[nbBits/8] = (1 << (nbBits%8)) - 1;
+                break;
+            }
+            case CHUNK_ARRAY:
+            {
+                uint8_t* bytes = (uint8_t*)words;
+                memset(words, 0x00, CHUNK_WORDS*sizeof(uint64_t));
+                for(uint16_t y : *chunk.array)
+                    bytes[y/8] |= (1 << (y%8));
+                break;
+            }
+            case CHUNK_BITMAP:
+                memcpy(words, chunk.bitmap->data(), CHUNK_WORDS*sizeof(uint64_t));
+                break;
+        }
+    }
+
+    void CompressedBitmask::combineInto(Bitmask& target, BitmaskOp op) const
+    {
+        std::vector<uint64_t> scratch;
+        for(size_t c = 0; c < m_chunks.size() && c*CHUNK_BITS < target.size(); c++)
+        {
+            const Chunk& chunk = m_chunks[c];
+            const size_t begin = c*CHUNK_BITS;
+            const size_t end   = begin + getChunkSize(c);
+
+            //Uniform chunks: nothing to do, or a range to fill
+            if(chunk.type == CHUNK_EMPTY)
+            {
+                if(op == BITMASK_OP_COPY || op == BITMASK_OP_AND)
+                    target.setRange(begin, end, false);
+                continue;
+            }
+            if(chunk.type == CHUNK_FULL && op != BITMASK_OP_XOR)
+            {
+                if(op == BITMASK_OP_COPY || op == BITMASK_OP_OR)
+                    target.setRange(begin, end, true);
+                else if(op == BITMASK_OP_ANDNOT)
+                    target.setRange(begin, end, false);
+                continue;
+            }
+
+            //Bitmaps are combined in place, the other containers are expanded first
+            const uint64_t* words = NULL;
+            if(chunk.type == CHUNK_BITMAP)
+                words = chunk.bitmap->data();
+            else
+            {
+                scratch.resize(CHUNK_WORDS);
+                expandChunk(c, scratch.data());
+                words = scratch.data();
+            }
+            target.combine((const uint8_t*)words, end-begin, op, begin);
+        }
+    }
+
+    void CompressedBitmask::toBitmask(Bitmask& output) const
+    {
+        output.resize(m_nbBits, false);
+        combineInto(output, BITMASK_OP_OR);
+    }
+
+    size_t CompressedBitmask::getMemorySize() const
+    {
+        size_t result = sizeof(CompressedBitmask) + m_chunks.capacity()*sizeof(Chunk);
+        for(const Chunk& chunk : m_chunks)
+        {
+            if(chunk.array)
+                result += chunk.array->capacity()*sizeof(uint16_t);
+            if(chunk.bitmap)
+                result += chunk.bitmap->capacity()*sizeof(uint64_t);
+        }
+        return result;
+    }
+}
@@ -1,9 +1,265 @@
 #include "Datasets/Annotation/AnnotationLog.h"
-#include <fstream>
+#include "MappedFile.h"
+#include "sciVisUtils.h"
 #include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/** \brief  The magic number starting the binary caches of AnnotationLog */
+#define ANNOTATION_LOG_CACHE_MAGIC "SVANNLOG"
+
+/** \brief  The version of the binary cache format. Caches of other versions are ignored.
+ * Version 2: float columns contain numbers with at most FLT_DIG significant digits */
+#define ANNOTATION_LOG_CACHE_VERSION 2
+
+/** \brief  The number of bytes hashed at the beginning and at the end of a csv file to identify its content */
+#define ANNOTATION_LOG_CACHE_SAMPLE_SIZE (64*1024)
 
 namespace sereno
 {
+    /** \brief  The fixed-size header of the binary caches of AnnotationLog */
+    struct AnnotationLogCacheHeader
+    {
+        char     magic[8];  /*!< ANNOTATION_LOG_CACHE_MAGIC*/
+        uint32_t version;   /*!< ANNOTATION_LOG_CACHE_VERSION*/
+        uint32_t hasHeader; /*!< Was the csv file read with a header?*/
+        uint64_t csvSize;   /*!< The size of the csv file*/
+        int64_t  csvMTime;  /*!< The modification time of the csv file*/
+        uint64_t csvHash;   /*!< The hash of the beginning and end of the csv file*/
+        uint32_t nbRows;    /*!< The number of rows*/
+        uint32_t nbColumns; /*!< The number of columns*/
+    };
+
+    /** \brief  Get what identifies the content of a csv file for its binary cache, without reading the whole file
+     * \param path the csv file
+     * \param header[out] the header whose csvSize, csvMTime, and csvHash are set
+     * \return   false if the file cannot be read, true otherwise */
+    static bool _getCSVSignature(const std::string& path, AnnotationLogCacheHeader* header)
+    {
+        std::error_code err;
+        header->csvSize = std::filesystem::file_size(path, err);
+        if(err)
+            return false;
+        header->csvMTime = std::filesystem::last_write_time(path, err).time_since_epoch().count();
+        if(err)
+            return false;
+
+        FILE* file = fopen(path.c_str(), "rb");
+        if(file == NULL)
+            return false;
+
+        //FNV-1a of the first and last bytes
+        std::vector<uint8_t> buffer(ANNOTATION_LOG_CACHE_SAMPLE_SIZE);
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        auto hashBytes = [&](size_t size)
+        {
+            for(size_t i = 0; i < size; i++)
+                hash = (hash ^ buffer[i]) * 0x100000001b3ULL;
+        };
+
+        hashBytes(fread(buffer.data(), 1, buffer.size(), file));
+        if(header->csvSize > buffer.size() && fseek(file, -(long)buffer.size(), SEEK_END) == 0)
+            hashBytes(fread(buffer.data(), 1, buffer.size(), file));
+        fclose(file);
+
+        header->csvHash = hash;
+        return true;
+    }
+
+    /** \brief  Write an array in a binary cache: its size in bytes, its content, and a padding to 8 bytes
+     * \param file the file to write
+     * \param data the array to write
+     * \param size the size of the array, in bytes
+     * \return   true on success, false otherwise */
+    static bool _writeCacheArray(FILE* file, const void* data, uint64_t size)
+    {
+        static const uint8_t padding[8] = {0};
+        return fwrite(&size, sizeof(size), 1, file) == 1 &&
+               (size == 0 || fwrite(data, 1, size, file) == size) &&
+               (size%8 == 0 || fwrite(padding, 1, 8-size%8, file) == 8-size%8);
+    }
+
+    /** \brief  Read an array written by _writeCacheArray
+     * \param data the cache content
+     * \param size the size of data
+     * \param offset[in, out] the reading offset, advanced past the array
+     * \param array[out] the array, pointing inside data
+     * \param arraySize[out] the size of the array, in bytes
+     * \return   false if the cache ends before the array, true otherwise */
+    static bool _readCacheArray(const uint8_t* data, uint64_t size, uint64_t& offset, const uint8_t** array, uint64_t* arraySize)
+    {
+        if(size - offset < sizeof(uint64_t))
+            return false;
+        memcpy(arraySize, data+offset, sizeof(uint64_t));
+        offset += sizeof(uint64_t);
+
+        if(*arraySize > size - offset || ((*arraySize+7) & ~(uint64_t)7) > size - offset)
+            return false;
+        *array  = data+offset;
+        offset += (*arraySize+7) & ~(uint64_t)7;
+        return true;
+    }
+
+    /** \brief  Parse a whole token as a number
+     * \param str the token to parse
+     * \param len the length of the token
+     * \param value[out] the number read
+     * \param nbDigits[out] the number of significant digits written in str
+     * \return   true if str is a number (surrounding spaces are allowed), false otherwise */
+    static bool _parseNumber(const char* str, size_t len, double* value, uint32_t* nbDigits)
+    {
+        static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                       1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+        const char* end = str+len;
+
+        //Fast path for plain decimals ([-+]digits[.digits]): with at most 15 significant digits and 22 decimals,
+        //a single division by an exact power of ten is correctly rounded (Clinger, 1990)
+        {
+            const char* c        = str;
+            bool        negative = (c < end && *c == '-');
+            if(c < end && (*c == '-' || *c == '+'))
+                c++;
+
+            uint64_t mantissa = 0;
+            uint32_t nbSig = 0, nbFrac = 0, nbAll = 0;
+            bool     dot = false, leading = true;
+            for(; c < end; c++)
+            {
+                if(*c >= '0' && *c <= '9')
+                {
+                    nbAll++;
+                    nbFrac += dot;
+                    if(leading && *c == '0')
+                        continue;
+                    leading = false;
+                    if(nbSig < 19)
+                        mantissa = mantissa*10 + (*c - '0');
+                    nbSig++;
+                }
+                else if(*c == '.' && !dot)
+                    dot = true;
+                else
+                    break;
+            }
+
+            if(c == end && nbAll > 0 && nbSig <= 15 && nbFrac <= 22)
+            {
+                *value    = (negative ? -1.0 : 1.0) * ((double)mantissa / pow10[nbFrac]);
+                *nbDigits = nbSig;
+                return true;
+            }
+        }
+
+        //Generic path
+#if defined(__cpp_lib_to_chars)
+        std::from_chars_result res = std::from_chars(str, end, *value);
+        if(res.ec != std::errc() || res.ptr != end)
+#endif
+        {
+            //strtod on a NULL-terminated copy. Also handles the '+' signs and the surrounding spaces
+            char        buf[64];
+            std::string longStr;
+            const char* cStr = buf;
+            if(len < sizeof(buf))
+            {
+                memcpy(buf, str, len);
+                buf[len] = '\0';
+            }
+            else
+            {
+                longStr.assign(str, len);
+                cStr = longStr.c_str();
+            }
+
+            char* parseEnd;
+            *value = strtod(cStr, &parseEnd);
+            if(parseEnd == cStr)
+                return false;
+            for(; *parseEnd; parseEnd++)
+                if(!isspace((unsigned char)*parseEnd))
+                    return false;
+        }
+
+        //Count the mantissa digits, leading zeros excluded
+        *nbDigits = 0;
+        bool leading = true;
+        for(const char* c = str; c < end && *c != 'e' && *c != 'E'; c++)
+        {
+            if(!isdigit((unsigned char)*c))
+                continue;
+            if(leading && *c == '0')
+                continue;
+            leading = false;
+            (*nbDigits)++;
+        }
+        return true;
+    }
+
+    /** \brief  Can a number be stored as a float without loss? Decimal numbers with at most FLT_DIG significant digits are the ones surviving a round trip through float:
+     * with 7 digits, distinct numbers (e.g., 8589973e3 and 8589974e3) can be rounded to the same float
+     * \param value the number
+     * \param nbDigits the number of significant digits the number was written with
+     * \return   true if yes, false otherwise */
+    static inline bool _isFloatCompatible(double value, uint32_t nbDigits)
+    {
+        if(!std::isfinite(value))
+            return true;
+        return nbDigits <= FLT_DIG && std::fabs(value) <= FLT_MAX && (value == 0 || std::fabs(value) >= FLT_MIN);
+    }
+
+    /** \brief  Append a string to a character arena
+     * \param token the string to append
+     * \param chars the arena. The string is NULL-terminated
+     * \param offsets the offsets of the arena's strings */
+    static inline void _appendString(const std::string_view& token, std::vector<char>& chars, std::vector<uint32_t>& offsets)
+    {
+        offsets.push_back(chars.size());
+        chars.insert(chars.end(), token.begin(), token.end());
+        chars.push_back('\0');
+    }
+
+    /** \brief  Read again the first rows of a range of CSV rows to collect the strings of a column
+     * \param begin the beginning of the range
+     * \param end the end of the range
+     * \param nbRows the number of non-blank rows to read
+     * \param col the column to collect
+     * \param chars the arena to append the strings to
+     * \param offsets the offsets of the arena's strings */
+    static void _collectCSVStrings(const char* begin, const char* end, uint32_t nbRows, uint32_t col, std::vector<char>& chars, std::vector<uint32_t>& offsets)
+    {
+        std::vector<std::string_view> tokens;
+        std::string                   scratch;
+        for(const char* row = begin; row < end && nbRows > 0;)
+        {
+            row = getCSVRowTokens(row, end, tokens, scratch);
+            if(tokens.empty())
+                continue;
+            _appendString(tokens[col], chars, offsets);
+            nbRows--;
+        }
+    }
+
+    /** \brief  The values of a column read from a range of CSV rows. Values are parsed as numbers until a value is not a number */
+    struct CSVRangeColumn
+    {
+        bool                  isNumeric = true; /*!< Are all the values numbers?*/
+        bool                  isFloat   = true; /*!< Can all the values be stored as float without loss?*/
+        std::vector<double>   values;           /*!< The values if isNumeric*/
+        std::vector<char>     chars;            /*!< The NULL-terminated values if !isNumeric*/
+        std::vector<uint32_t> offsets;          /*!< The offset in chars of each value*/
+    };
+
     int32_t AnnotationLog::indiceFromHeader(const std::vector<std::string>& headers, const std::string& header)
     {
         for(uint32_t i = 0; i < headers.size(); i++)
@@ -21,53 +277,453 @@ namespace sereno
     uint32_t AnnotationLog::getNbColumns() const
     {
         //Works because we are in a "data frame", i.e., rectangular data (each row possesses the same number of columns. This is checked at parsing)
-        return (m_values.size() ? m_values[0].size() : 0);
+        return (m_nbRows ? m_columns.size() : 0);
     }
 
     bool AnnotationLog::readFromCSV(const std::string& path)
     {
-        std::ifstream file(path);
-        if(!file.good())
+        return parseCSVFile(path, false, false);
+    }
+
+    bool AnnotationLog::readFromCSV(const std::string& path, const std::string& cachePath)
+    {
+        if(readBinaryCache(path, cachePath))
+            return true;
+
+        if(!readFromCSV(path))
+            return false;
+        if(!writeBinaryCache(path, cachePath))
+            std::cerr << "Could not write the cache " << cachePath << " of the file " << path << std::endl;
+        return true;
+    }
+
+    bool AnnotationLog::readBinaryCache(const std::string& path, const std::string& cachePath)
+    {
+        AnnotationLogCacheHeader csvHeader;
+        if(!std::filesystem::exists(cachePath) || !_getCSVSignature(path, &csvHeader))
+            return false;
+
+        MappedFile file(cachePath);
+        const uint8_t* data = file.getData();
+        const uint64_t size = file.getSize();
+        uint64_t       offset = sizeof(AnnotationLogCacheHeader);
+        if(!file.isOpen() || size < offset)
+            return false;
+
+        //Check that the cache corresponds to the csv file
+        AnnotationLogCacheHeader header;
+        memcpy(&header, data, sizeof(header));
+        if(memcmp(header.magic, ANNOTATION_LOG_CACHE_MAGIC, sizeof(header.magic)) || header.version != ANNOTATION_LOG_CACHE_VERSION ||
+           header.hasHeader != m_hasHeader || header.csvSize != csvHeader.csvSize || header.csvMTime != csvHeader.csvMTime || header.csvHash != csvHeader.csvHash)
+            return false;
+
+        const uint8_t* array;
+        uint64_t       arraySize;
+
+        //Headers
+        std::vector<std::string> headers;
+        if(m_hasHeader)
+        {
+            for(uint32_t i = 0; i < header.nbColumns; i++)
+            {
+                if(!_readCacheArray(data, size, offset, &array, &arraySize))
+                    return false;
+                headers.emplace_back((const char*)array, arraySize);
+            }
+        }
+
+        //Columns. Values are copied from the mapping
+        std::vector<Column> columns(header.nbColumns);
+        for(Column& c : columns)
+        {
+            uint32_t type;
+            if(!_readCacheArray(data, size, offset, &array, &arraySize) || arraySize != sizeof(type))
+                return false;
+            memcpy(&type, array, sizeof(type));
+
+            if(!_readCacheArray(data, size, offset, &array, &arraySize))
+                return false;
+
+            switch(type)
+            {
+                case ANNOTATION_LOG_COLUMN_FLOAT:
+                    if(arraySize != header.nbRows*sizeof(float))
+                        return false;
+                    c.floats.resize(header.nbRows);
+                    memcpy(c.floats.data(), array, arraySize);
+                    break;
+
+                case ANNOTATION_LOG_COLUMN_DOUBLE:
+                    if(arraySize != header.nbRows*sizeof(double))
+                        return false;
+                    c.doubles.resize(header.nbRows);
+                    memcpy(c.doubles.data(), array, arraySize);
+                    break;
+
+                case ANNOTATION_LOG_COLUMN_STRING:
+                {
+                    if((arraySize == 0 && header.nbRows > 0) || (arraySize > 0 && array[arraySize-1] != '\0'))
+                        return false;
+                    c.chars.assign((const char*)array, (const char*)array + arraySize);
+
+                    if(!_readCacheArray(data, size, offset, &array, &arraySize) || arraySize != header.nbRows*sizeof(uint32_t))
+                        return false;
+                    c.offsets.resize(header.nbRows);
+                    memcpy(c.offsets.data(), array, arraySize);
+                    for(uint32_t o : c.offsets)
+                        if(o >= c.chars.size())
+                            return false;
+                    break;
+                }
+
+                default:
+                    return false;
+            }
+            c.type = (AnnotationLogColumnType)type;
+        }
+
+        m_header.swap(headers);
+        m_columns.swap(columns);
+        m_nbRows  = header.nbRows;
+        m_follow  = false;
+        setTimeInd(-1); //Through the virtual function, so that derived classes release the time column
+        m_hasRead = true;
+        onParse();
+
+        return true;
+    }
+
+    bool AnnotationLog::writeBinaryCache(const std::string& path, const std::string& cachePath) const
+    {
+        AnnotationLogCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        if(!_getCSVSignature(path, &header))
+            return false;
+        memcpy(header.magic, ANNOTATION_LOG_CACHE_MAGIC, sizeof(header.magic));
+        header.version   = ANNOTATION_LOG_CACHE_VERSION;
+        header.hasHeader = m_hasHeader;
+        header.nbRows    = m_nbRows;
+        header.nbColumns = m_columns.size();
+
+        //Write in a temporary file first, so that an interrupted writing never leaves a partial cache
+        std::string tmpPath = cachePath + ".tmp";
+        FILE* file = fopen(tmpPath.c_str(), "wb");
+        if(file == NULL)
+            return false;
+
+        bool succeed = fwrite(&header, sizeof(header), 1, file) == 1;
+        if(m_hasHeader)
+            for(uint32_t i = 0; i < m_columns.size() && succeed; i++)
+                succeed = _writeCacheArray(file, (i < m_header.size() ? m_header[i].data() : ""), (i < m_header.size() ? m_header[i].size() : 0));
+
+        for(const Column& c : m_columns)
+        {
+            if(!succeed)
+                break;
+            uint32_t type = c.type;
+            succeed = _writeCacheArray(file, &type, sizeof(type));
+            switch(c.type)
+            {
+                case ANNOTATION_LOG_COLUMN_FLOAT:
+                    succeed = succeed && _writeCacheArray(file, c.floats.data(), m_nbRows*sizeof(float));
+                    break;
+                case ANNOTATION_LOG_COLUMN_DOUBLE:
+                    succeed = succeed && _writeCacheArray(file, c.doubles.data(), m_nbRows*sizeof(double));
+                    break;
+                default:
+                    succeed = succeed && _writeCacheArray(file, c.chars.data(), c.chars.size()) &&
+                                         _writeCacheArray(file, c.offsets.data(), m_nbRows*sizeof(uint32_t));
+                    break;
+            }
+        }
+        succeed = (fclose(file) == 0) && succeed;
+
+        std::error_code err;
+        if(succeed)
+            std::filesystem::rename(tmpPath, cachePath, err);
+        if(!succeed || err)
+        {
+            std::filesystem::remove(tmpPath, err);
+            return false;
+        }
+        return true;
+    }
+
+    bool AnnotationLog::followCSV(const std::string& path)
+    {
+        return parseCSVFile(path, true, false);
+    }
+
+    bool AnnotationLog::updateFromCSV()
+    {
+        if(!m_follow)
+            return false;
+
+        std::error_code err;
+        uint64_t fileSize = std::filesystem::file_size(m_followPath, err);
+        if(err)
+        {
+            std::cerr << "Could not open the file " << m_followPath << std::endl;
+            return false;
+        }
+
+        //The file was rewritten, or the header was not complete yet: read everything again
+        if(fileSize < m_followOffset || (m_hasHeader && m_header.empty()))
+            return parseCSVFile(m_followPath, true, true);
+
+        if(fileSize == m_followOffset)
+            return true;
+
+        //Read only the new bytes. Offsets are 64-bit, so that logs larger than 2 GiB are followed as well
+        std::ifstream file(m_followPath, std::ios::binary);
+        if(!file.is_open() || !file.seekg((std::streamoff)m_followOffset, std::ios::beg))
+        {
+            std::cerr << "Could not open the file " << m_followPath << std::endl;
+            return false;
+        }
+
+        std::vector<char> buffer(fileSize - m_followOffset);
+        file.read(buffer.data(), buffer.size());
+        size_t readSize = file.gcount();
+        file.close();
+
+        const char* data = buffer.data();
+        const char* end  = getCSVCompleteRowsEnd(data, data + readSize);
+        if(end == data)
+            return true;
+
+        uint32_t firstRow = m_nbRows;
+        if(!appendCSVRows(data, end, (m_hasHeader ? (int32_t)m_header.size() : -1)))
+        {
+            std::cerr << "Error in file " << m_followPath << " : Different column numbers per row\n";
+            return false;
+        }
+        m_followOffset += end - data;
+
+        if(m_nbRows > firstRow)
+            onAppendRows(firstRow, m_nbRows - firstRow);
+        return true;
+    }
+
+    bool AnnotationLog::parseCSVFile(const std::string& path, bool follow, bool keepTime)
+    {
+        m_follow = false;
+
+        MappedFile file(path);
+        if(!file.isOpen())
         {
             std::cerr << "Could not open the file " << path << std::endl; 
             return false;
         }
 
-        int32_t size = -1;
+        const char* begin = (const char*)file.getData();
+        const char* data  = begin;
+        const char* end   = data + file.getSize();
+        int32_t     size  = -1;
+
+        //A followed file may end with a row still being written
+        if(follow)
+            end = getCSVCompleteRowsEnd(data, end);
 
         //Clear values
         m_header.clear();
-        m_values.clear();
+        m_columns.clear();
+        m_nbRows = 0;
 
         //Read header
         if(m_hasHeader)
         {
-            CSVRow row;
-            file >> row;
-            m_header = row.getData();
+            std::vector<std::string_view> tokens;
+            std::string                   scratch;
+            data = getCSVRowTokens(data, end, tokens, scratch);
+            m_header.assign(tokens.begin(), tokens.end());
             size = m_header.size();
         }
 
         //Read values
-        for(auto& it : CSVRange(file))
+        if(!appendCSVRows(data, end, size))
         {
-            if(size != -1)
+            std::cerr << "Error in file " << path << " : Different column numbers per row\n";
+            return false;
+        }
+
+        //Release the time column (through the virtual function, so that derived classes release it as well), unless it is kept and still exists
+        if(keepTime && m_timeIT >= 0)
+            keepTime = (m_hasHeader ? m_timeIT < (int32_t)m_header.size() : (m_nbRows == 0 || m_timeIT < (int32_t)getNbColumns()));
+        if(!keepTime)
+            setTimeInd(-1);
+
+        m_hasRead = true;
+        if(follow)
+        {
+            m_follow       = true;
+            m_followPath   = path;
+            m_followOffset = end - begin;
+        }
+        onParse();
+
+        return true;
+    }
+
+    bool AnnotationLog::appendCSVRows(const char* begin, const char* end, int32_t size)
+    {
+        if(m_nbRows)
+            size = m_columns.size();
+
+        //Ranges of rows are read concurrently, then concatenated
+        int nbThreads = 1;
+#ifdef _OPENMP
+        std::lock_guard<std::mutex> ompLock(ompMutex);
+        nbThreads = omp_get_max_threads();
+#endif
+        const std::vector<const char*> bounds = splitCSVRows(begin, end, nbThreads);
+        const size_t nbRanges = bounds.size()-1;
+        std::vector<std::vector<CSVRangeColumn>> rangeColumns(nbRanges);
+        std::vector<uint32_t>                    rangeNbRows(nbRanges, 0);
+        std::vector<int32_t>                     rangeSize(nbRanges, size);
+        std::vector<uint8_t>                     rangeError(nbRanges, 0);
+
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(static, 1)
+#endif
+        for(int64_t r = 0; r < (int64_t)nbRanges; r++)
+        {
+            std::vector<CSVRangeColumn>&  columns = rangeColumns[r];
+            std::vector<std::string_view> tokens;
+            std::string                   scratch;
+
+            for(const char* row = bounds[r]; row < bounds[r+1];)
             {
-                if((int32_t)it.size() != size)
+                row = getCSVRowTokens(row, bounds[r+1], tokens, scratch);
+                if(tokens.empty()) //Blank row
+                    continue;
+
+                if(rangeSize[r] == -1)
+                    rangeSize[r] = tokens.size();
+                if((int32_t)tokens.size() != rangeSize[r])
                 {
-                    std::cerr << "Error in file " << path << " : Different column numbers per row\n";
-                    return false;
+                    rangeError[r] = 1;
+                    break;
+                }
+
+                if(columns.size() != tokens.size())
+                    columns.resize(tokens.size());
+                for(size_t i = 0; i < tokens.size(); i++)
+                {
+                    CSVRangeColumn& col = columns[i];
+                    if(col.isNumeric)
+                    {
+                        double   value;
+                        uint32_t nbDigits;
+                        if(_parseNumber(tokens[i].data(), tokens[i].size(), &value, &nbDigits))
+                        {
+                            col.values.push_back(value);
+                            col.isFloat = col.isFloat && _isFloatCompatible(value, nbDigits);
+                            continue;
+                        }
+
+                        //Not a number: the previous values of the range are read again as strings
+                        col.isNumeric = false;
+                        std::vector<double>().swap(col.values);
+                        _collectCSVStrings(bounds[r], bounds[r+1], rangeNbRows[r], i, col.chars, col.offsets);
+                    }
+                    _appendString(tokens[i], col.chars, col.offsets);
                 }
+                rangeNbRows[r]++;
             }
-            else
-                size = it.size();
-            m_values.emplace_back(std::move(it.getData()), (m_hasHeader?&m_header:NULL));
         }
 
-        m_timeIT  = -1;
-        m_hasRead = true;
-        onParse();
+        //All the ranges must agree on the number of columns
+        for(size_t r = 0; r < nbRanges; r++)
+        {
+            if(rangeError[r])
+                return false;
+            if(rangeNbRows[r] == 0)
+                continue;
+            if(size == -1)
+                size = rangeSize[r];
+            if(rangeSize[r] != size)
+                return false;
+        }
+
+        if(size <= 0)
+            return true;
+
+        //Concatenate the ranges. A column is numeric only if all its values (previous and new ones) are numbers
+        const bool hasRows = (m_nbRows > 0);
+        if(!hasRows)
+            m_columns.assign(size, Column());
 
+        for(int32_t i = 0; i < size; i++)
+        {
+            Column& col      = m_columns[i];
+            bool    isString = hasRows && col.type == ANNOTATION_LOG_COLUMN_STRING;
+            bool    isFloat  = !hasRows || col.type == ANNOTATION_LOG_COLUMN_FLOAT;
+            for(size_t r = 0; r < nbRanges; r++)
+            {
+                if(rangeNbRows[r] == 0)
+                    continue;
+                isString = isString || !rangeColumns[r][i].isNumeric;
+                isFloat  = isFloat  && rangeColumns[r][i].isFloat;
+            }
+
+            if(isString)
+            {
+                //Convert the previous numeric values
+                if(hasRows && col.type != ANNOTATION_LOG_COLUMN_STRING)
+                {
+                    for(uint32_t j = 0; j < m_nbRows; j++)
+                        _appendString(getString(j, i), col.chars, col.offsets);
+                    std::vector<float>().swap(col.floats);
+                    std::vector<double>().swap(col.doubles);
+                }
+                col.type = ANNOTATION_LOG_COLUMN_STRING;
+
+                for(size_t r = 0; r < nbRanges; r++)
+                {
+                    if(rangeNbRows[r] == 0)
+                        continue;
+
+                    CSVRangeColumn& rangeCol = rangeColumns[r][i];
+                    if(rangeCol.isNumeric)
+                        _collectCSVStrings(bounds[r], bounds[r+1], rangeNbRows[r], i, col.chars, col.offsets);
+                    else
+                    {
+                        const uint32_t offset = col.chars.size();
+                        col.chars.insert(col.chars.end(), rangeCol.chars.begin(), rangeCol.chars.end());
+                        for(uint32_t o : rangeCol.offsets)
+                            col.offsets.push_back(offset + o);
+                    }
+                    rangeCol = CSVRangeColumn();
+                }
+                continue;
+            }
+
+            if(!isFloat && col.type == ANNOTATION_LOG_COLUMN_FLOAT && hasRows)
+            {
+                col.doubles.assign(col.floats.begin(), col.floats.end());
+                std::vector<float>().swap(col.floats);
+            }
+            col.type = (isFloat ? ANNOTATION_LOG_COLUMN_FLOAT : ANNOTATION_LOG_COLUMN_DOUBLE);
+
+            for(size_t r = 0; r < nbRanges; r++)
+            {
+                if(rangeNbRows[r] == 0)
+                    continue;
+
+                std::vector<double>& values = rangeColumns[r][i].values;
+                if(isFloat)
+                    col.floats.insert(col.floats.end(), values.begin(), values.end());
+                else if(col.doubles.empty())
+                    col.doubles.swap(values);
+                else
+                    col.doubles.insert(col.doubles.end(), values.begin(), values.end());
+                std::vector<double>().swap(values);
+            }
+        }
+
+        for(size_t r = 0; r < nbRanges; r++)
+            m_nbRows += rangeNbRows[r];
         return true;
     }
 
@@ -90,9 +746,9 @@ namespace sereno
         }
         else
         {
-            if(m_values.size())
+            if(m_nbRows)
             {
-                if(timeCol >= (int32_t)m_values[0].size())
+                if(timeCol >= (int32_t)getNbColumns())
                     return false;
                 m_timeIT = timeCol;
             }
@@ -116,25 +772,67 @@ namespace sereno
         return true;
     }
 
-    const std::string& AnnotationLog::LogEntry::operator[](const std::string& index) const
+    std::vector<float> AnnotationLog::getTimeValues() const
     {
-       return (*this)[AnnotationLog::indiceFromHeader(*m_header, index)];
+        std::vector<float> res;
+        if(m_timeIT < 0)
+            return res;
+
+        const float* values = getFloatColumn(m_timeIT);
+        if(values)
+            return std::vector<float>(values, values+m_nbRows);
+
+        res.reserve(m_nbRows);
+        for(uint32_t i = 0; i < m_nbRows; i++)
+            res.push_back(getFloat(i, m_timeIT));
+        return res;
     }
 
-    const std::string& AnnotationLog::LogEntry::operator[](uint32_t i) const
+    const float* AnnotationLog::getFloatColumn(uint32_t col) const
     {
-        return m_values[i];
+        if(col >= m_columns.size() || m_columns[col].type != ANNOTATION_LOG_COLUMN_FLOAT)
+            return NULL;
+        return m_columns[col].floats.data();
     }
 
-    std::vector<float> AnnotationLog::getTimeValues() const
+    const double* AnnotationLog::getDoubleColumn(uint32_t col) const
     {
-        std::vector<float> res;
-        if(m_timeIT < 0)
-            return res;
+        if(col >= m_columns.size() || m_columns[col].type != ANNOTATION_LOG_COLUMN_DOUBLE)
+            return NULL;
+        return m_columns[col].doubles.data();
+    }
+
+    std::string AnnotationLog::getString(uint32_t row, uint32_t col) const
+    {
+        const Column& c = m_columns[col];
+        if(c.type == ANNOTATION_LOG_COLUMN_STRING)
+            return std::string(&c.chars[c.offsets[row]]);
 
-        res.reserve(size());
-        for(const auto& it : *this)
-            res.push_back(atof(it[m_timeIT].c_str()));
+        //The shortest representation reading back the same value
+        char buf[32];
+        for(int precision = 1; precision <= 17; precision++)
+        {
+            if(c.type == ANNOTATION_LOG_COLUMN_FLOAT)
+            {
+                snprintf(buf, sizeof(buf), "%.*g", precision, c.floats[row]);
+                if(strtof(buf, NULL) == c.floats[row])
+                    break;
+            }
+            else
+            {
+                snprintf(buf, sizeof(buf), "%.*g", precision, c.doubles[row]);
+                if(strtod(buf, NULL) == c.doubles[row])
+                    break;
+            }
+        }
+        return std::string(buf);
+    }
+
+    size_t AnnotationLog::getMemorySize() const
+    {
+        size_t res = 0;
+        for(const Column& c : m_columns)
+            res += c.floats.capacity()*sizeof(float) + c.doubles.capacity()*sizeof(double) + c.chars.capacity() + c.offsets.capacity()*sizeof(uint32_t);
         return res;
     }
 }
@@ -1,5 +1,17 @@
 #include "Datasets/Annotation/AnnotationLogContainer.h"
+#include "sciVisUtils.h"
+#include "SciVisColor.h"
 #include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cfloat>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/** \brief  In space-time queries, the time index is used first if the time span contains at most 1/INDEX_TIME_FIRST_RATIO of the rows */
+#define INDEX_TIME_FIRST_RATIO 16
 
 namespace sereno
 {
@@ -44,7 +56,7 @@ namespace sereno
         if(found)
             return ANNOTATION_LOG_CONTAINER_ERROR_HEADER_ALREADY_PRESENT;
 
-        m_positions.emplace(annot, std::vector<glm::vec3>(annot->begin(), annot->end()));
+        m_positions.emplace(annot, nullptr);
 
         it = m_assignedHeaders.begin();
         for(auto i : indices)
@@ -68,6 +80,8 @@ namespace sereno
             return;
 
         m_positions.erase(posIT);
+        m_positionIndices.erase(annot);
+        m_mappedColors.erase(annot);
 
         //Remove the assigned headers
         std::vector<int32_t> headers = annot->getHeaders();
@@ -90,10 +104,235 @@ namespace sereno
     {
         auto it = m_positions.find(annot);
         if(it != m_positions.end())
-            return &it->second;
+            return getPositionBuffer(it).get();
         return NULL;
     }
 
+    std::vector<glm::vec3>* AnnotationLogContainer::getPositionsFromView(std::shared_ptr<AnnotationPosition> annot)
+    {
+        auto it = m_positions.find(annot);
+        if(it == m_positions.end())
+            return NULL;
+
+        //Copy on write. The caller may modify the positions: the spatial index is built again at its next use
+        m_positionIndices.erase(annot);
+        getPositionBuffer(it);
+        if(it->second.use_count() > 1)
+            it->second = std::make_shared<std::vector<glm::vec3>>(*it->second);
+        return it->second.get();
+    }
+
+    std::shared_ptr<const AnnotationPositionIndex> AnnotationLogContainer::getPositionIndex(std::shared_ptr<AnnotationPosition> annot) const
+    {
+        auto it = m_positions.find(annot);
+        if(it == m_positions.end())
+            return nullptr;
+
+        std::shared_ptr<AnnotationPositionIndex>& index = m_positionIndices[annot];
+        if(index == nullptr || index->getPositions() != getPositionBuffer(it))
+            index = std::make_shared<AnnotationPositionIndex>(getPositionBuffer(it));
+        return index;
+    }
+
+    void AnnotationLogContainer::queryPositions(std::shared_ptr<AnnotationPosition> annot, const glm::vec3& minPos, const glm::vec3& maxPos, float t0, float t1, std::vector<uint32_t>& output) const
+    {
+        const std::vector<glm::vec3>* positionsPtr = getPositionsFromView(annot);
+        if(positionsPtr == NULL)
+            return;
+        const std::vector<glm::vec3>& positions = *positionsPtr;
+
+        //Narrow time windows (e.g., timeline scrubbing): test the positions of the time span, without the spatial index
+        TimeSpan span = getTimeSpan(t0, t1);
+        if(m_timeIT >= 0 && span.size() <= positions.size()/INDEX_TIME_FIRST_RATIO)
+        {
+            for(uint32_t i = span.begin; i < span.end; i++)
+            {
+                uint32_t row = getTimeSortedRow(i);
+                const glm::vec3& pos = positions[row];
+                if(pos.x >= minPos.x && pos.x <= maxPos.x && pos.y >= minPos.y && pos.y <= maxPos.y && pos.z >= minPos.z && pos.z <= maxPos.z)
+                    output.push_back(row);
+            }
+            return;
+        }
+
+        //Otherwise: filter the rows inside the box by time
+        size_t first = output.size();
+        getPositionIndex(annot)->queryAABB(minPos, maxPos, output);
+        if(m_timeIT < 0)
+            return;
+        auto end = std::remove_if(output.begin()+first, output.end(), [&](uint32_t row) {return !(m_time[row] >= t0 && m_time[row] <= t1);});
+        output.erase(end, output.end());
+    }
+
+    std::shared_ptr<const std::vector<uint8_t>> AnnotationLogContainer::getMappedColors(std::shared_ptr<AnnotationPosition> annot, const std::vector<uint32_t>& indices, const TF& tf) const
+    {
+        const uint32_t nbDims = std::max<uint32_t>(tf.getDimension(), indices.size());
+        return updateMappedColors(annot, indices, tf.getVersion(), -1, nbDims, [&tf](float* ind, uint8_t* col)
+        {
+            tf.computeColor(ind, col);
+            col[3] = tf.computeAlpha(ind);
+        });
+    }
+
+    std::shared_ptr<const std::vector<uint8_t>> AnnotationLogContainer::getMappedColors(std::shared_ptr<AnnotationPosition> annot, uint32_t column, ColorMode mode) const
+    {
+        return updateMappedColors(annot, {column}, 0, mode, 1, [mode](float* ind, uint8_t* col)
+        {
+            Color c = SciVis_computeColor(mode, ind[0]);
+            for(uint32_t i = 0; i < 3; i++)
+                col[i] = std::min(255.0f, std::max(0.0f, 255.0f*c[i]));
+            col[3] = 0xff;
+        });
+    }
+
+    template <typename ColorFunc>
+    std::shared_ptr<const std::vector<uint8_t>> AnnotationLogContainer::updateMappedColors(std::shared_ptr<AnnotationPosition> annot, const std::vector<uint32_t>& indices, uint64_t tfVersion, int32_t mode,
+                                                                                           uint32_t nbDims, const ColorFunc& colorFunc) const
+    {
+        if(m_positions.find(annot) == m_positions.end())
+            return nullptr;
+        for(uint32_t col : indices)
+            if(col >= getNbColumns())
+                return nullptr;
+
+        MappedColors& cache    = m_mappedColors[annot];
+        const bool    sameTF   = (cache.colors && cache.indices == indices && cache.tfVersion == tfVersion && cache.mode == mode);
+        const size_t  nbCached = (sameTF ? cache.colors->size()/4 : 0);
+        if(sameTF && nbCached == size())
+            return cache.colors;
+
+        //Column ranges: extended with the new rows only if the other rows are still valid
+        std::vector<float> minVals(indices.size(), FLT_MAX), maxVals(indices.size(), -FLT_MAX);
+        if(nbCached)
+        {
+            minVals = cache.minVals;
+            maxVals = cache.maxVals;
+        }
+        for(uint32_t i = 0; i < indices.size(); i++)
+        {
+            for(uint32_t row = nbCached; row < size(); row++)
+            {
+                float v = getFloat(row, indices[i]);
+                if(std::isfinite(v))
+                {
+                    minVals[i] = std::min(minVals[i], v);
+                    maxVals[i] = std::max(maxVals[i], v);
+                }
+            }
+        }
+
+        uint32_t firstRow = nbCached;
+        if(nbCached && (minVals != cache.minVals || maxVals != cache.maxVals))
+            firstRow = 0;
+
+        //Do not modify colors shared with the caller
+        if(!cache.colors || cache.colors.use_count() > 1)
+        {
+            std::shared_ptr<std::vector<uint8_t>> colors = std::make_shared<std::vector<uint8_t>>();
+            if(firstRow > 0)
+                *colors = *cache.colors;
+            cache.colors = colors;
+        }
+        cache.colors->resize(4*(size_t)size());
+        cache.indices   = indices;
+        cache.tfVersion = tfVersion;
+        cache.mode      = mode;
+        cache.minVals   = minVals;
+        cache.maxVals   = maxVals;
+
+        //Map the rows in parallel
+        uint8_t* colors = cache.colors->data();
+
+#ifdef _OPENMP
+        std::lock_guard<std::mutex> ompLock(ompMutex);
+        #pragma omp parallel
+#endif
+        {
+            std::vector<float> ind(nbDims, 0.0f);
+#ifdef _OPENMP
+            #pragma omp for schedule(static)
+#endif
+            for(int64_t row = firstRow; row < (int64_t)size(); row++)
+            {
+                for(uint32_t i = 0; i < indices.size(); i++)
+                {
+                    float v     = getFloat(row, indices[i]);
+                    float range = maxVals[i] - minVals[i];
+                    float t     = (range > 0.0f ? (v - minVals[i]) / range : 0.0f);
+                    ind[i]      = (t >= 0.0f ? std::min(t, 1.0f) : 0.0f); //NaN -> 0
+                }
+                colorFunc(ind.data(), colors + 4*row);
+            }
+        }
+
+        return cache.colors;
+    }
+
+    const std::map<std::shared_ptr<AnnotationPosition>, std::shared_ptr<std::vector<glm::vec3>>>& AnnotationLogContainer::getAnnotationPositions() const
+    {
+        for(auto it = m_positions.begin(); it != m_positions.end(); ++it)
+            getPositionBuffer(it);
+        return m_positions;
+    }
+
+    const std::shared_ptr<std::vector<glm::vec3>>& AnnotationLogContainer::getPositionBuffer(std::map<std::shared_ptr<AnnotationPosition>, std::shared_ptr<std::vector<glm::vec3>>>::iterator it) const
+    {
+        if(it->second)
+            return it->second;
+
+        //Share the positions of another view reading the same columns
+        int32_t indices[3];
+        it->first->getPosIndices(indices);
+        for(auto& other : m_positions)
+        {
+            int32_t otherIndices[3];
+            other.first->getPosIndices(otherIndices);
+            if(other.second && std::equal(indices, indices+3, otherIndices))
+            {
+                it->second = other.second;
+                return it->second;
+            }
+        }
+
+        it->second = std::make_shared<std::vector<glm::vec3>>();
+        readPositions(*it->first, 0, *it->second);
+        return it->second;
+    }
+
+    void AnnotationLogContainer::readPositions(const AnnotationPosition& annot, uint32_t firstRow, std::vector<glm::vec3>& positions) const
+    {
+        if(firstRow >= size())
+            return;
+
+        int32_t indices[3];
+        annot.getPosIndices(indices);
+
+        size_t offset = positions.size();
+        positions.resize(offset + size() - firstRow);
+        glm::vec3* output = positions.data() + offset;
+
+        //Float columns are read directly, the other ones through the conversion of AnnotationLog::getFloat
+        for(uint32_t i = 0; i < 3; i++)
+        {
+            const float* values = annot.getComponentValues(i);
+            if(values)
+            {
+                for(uint32_t j = firstRow; j < size(); j++)
+                    output[j-firstRow][i] = values[j];
+            }
+            else if(indices[i] >= 0)
+            {
+                for(uint32_t j = firstRow; j < size(); j++)
+                    output[j-firstRow][i] = getFloat(j, indices[i]);
+            }
+            else
+            {
+                for(uint32_t j = firstRow; j < size(); j++)
+                    output[j-firstRow][i] = 0;
+            }
+        }
+    }
+
     std::vector<uint32_t> AnnotationLogContainer::getRemainingHeaders() const
     {
         std::vector<uint32_t> res;
@@ -115,9 +354,55 @@ namespace sereno
 
     void AnnotationLogContainer::onParse()
     {
+        //The values changed: positions and their spatial indices are built again at their next use
+        for(auto& it : m_positions)
+            it.second = nullptr;
+        m_positionIndices.clear();
+        m_mappedColors.clear();
+
         setTimeInd(m_timeIT);
     }
 
+    void AnnotationLogContainer::onAppendRows(uint32_t firstRow, uint32_t nbRows)
+    {
+        //Extend the time. The index is kept as is while the new rows stay in chronological order
+        if(m_timeIT >= 0)
+        {
+            bool sorted = isTimeSorted();
+            m_time.reserve(firstRow + nbRows);
+            for(uint32_t i = firstRow; i < firstRow + nbRows; i++)
+            {
+                float t = getFloat(i, m_timeIT);
+                if(std::isnan(t) || (!m_time.empty() && t < m_time.back()))
+                    sorted = false;
+                m_time.push_back(t);
+            }
+
+            if(sorted)
+                m_nbValidTime = m_time.size();
+            else
+                updateTimeIndex();
+        }
+
+        //Extend the positions that are already built. Shared positions are extended once
+        std::vector<std::vector<glm::vec3>*> extended;
+        for(auto& it : m_positions)
+        {
+            if(!it.second || std::find(extended.begin(), extended.end(), it.second.get()) != extended.end())
+                continue;
+            readPositions(*it.first, firstRow, *it.second);
+            extended.push_back(it.second.get());
+        }
+
+        for(auto& it : m_positionIndices)
+            if(it.second)
+                it.second->update();
+
+        //The listeners may read the positions: notify them once everything is up to date
+        for(auto& it : m_positions)
+            it.first->notifyAppendRows(firstRow, nbRows);
+    }
+
     bool AnnotationLogContainer::setTimeInd(int timeCol)
     {
         //Check if we already have this time. If yes --> error
@@ -147,9 +432,99 @@ namespace sereno
         }
         else
             m_time.clear();
+        updateTimeIndex();
         return true;
     }
 
+    void AnnotationLogContainer::updateTimeIndex()
+    {
+        m_timeOrder.clear();
+        m_nbValidTime = 0;
+
+        //Most logs are written in chronological order: no permutation is needed
+        bool sorted = true;
+        for(uint32_t i = 0; i < m_time.size(); i++)
+        {
+            if(std::isnan(m_time[i]))
+                sorted = false;
+            else
+            {
+                m_nbValidTime++;
+                if(i > 0 && m_time[i] < m_time[i-1])
+                    sorted = false;
+            }
+        }
+        if(sorted)
+            return;
+
+        //NaN values are put at the end so that the order stays a strict weak ordering
+        m_timeOrder.resize(m_time.size());
+        std::iota(m_timeOrder.begin(), m_timeOrder.end(), 0);
+        std::stable_sort(m_timeOrder.begin(), m_timeOrder.end(), [this](uint32_t a, uint32_t b)
+        {
+            return m_time[a] < m_time[b] || (std::isnan(m_time[b]) && !std::isnan(m_time[a]));
+        });
+    }
+
+    AnnotationLogContainer::TimeSpan AnnotationLogContainer::getTimeSpan(float t0, float t1) const
+    {
+        TimeSpan span;
+        if(!(t0 <= t1))
+            return span;
+
+        //Binary searches on the positions [0, m_nbValidTime[ of the time order
+        auto timeAt = [this](uint32_t i) {return m_time[getTimeSortedRow(i)];};
+        uint32_t lo = 0, hi = m_nbValidTime;
+        while(lo < hi)
+        {
+            uint32_t mid = lo + (hi-lo)/2;
+            if(timeAt(mid) < t0)
+                lo = mid+1;
+            else
+                hi = mid;
+        }
+        span.begin = lo;
+
+        hi = m_nbValidTime;
+        while(lo < hi)
+        {
+            uint32_t mid = lo + (hi-lo)/2;
+            if(t1 < timeAt(mid))
+                hi = mid;
+            else
+                lo = mid+1;
+        }
+        span.end = lo;
+        return span;
+    }
+
+    int32_t AnnotationLogContainer::getNearestTimeRow(float t) const
+    {
+        if(m_nbValidTime == 0 || std::isnan(t))
+            return -1;
+
+        auto timeAt = [this](uint32_t i) {return m_time[getTimeSortedRow(i)];};
+
+        //First position whose time is >= t
+        uint32_t lo = 0, hi = m_nbValidTime;
+        while(lo < hi)
+        {
+            uint32_t mid = lo + (hi-lo)/2;
+            if(timeAt(mid) < t)
+                lo = mid+1;
+            else
+                hi = mid;
+        }
+
+        if(lo == m_nbValidTime || (lo > 0 && t - timeAt(lo-1) <= timeAt(lo) - t))
+        {
+            //The preceding time is nearer: go back to the first position having this time
+            float prev = timeAt(lo-1);
+            lo = getTimeSpan(prev, prev).begin;
+        }
+        return getTimeSortedRow(lo);
+    }
+
     void AnnotationLogContainer::onUpdateHeaders(AnnotationLogComponent* component, const std::vector<int32_t>& oldHeaders)
     {
         bool changeHeaders = false;
@@ -200,7 +575,9 @@ namespace sereno
                 }
                 else
                 {
-                    it.second.assign(it.first->begin(), it.first->end());
+                    //Built again at their next use. Other views sharing the former positions keep them
+                    it.second = nullptr;
+                    m_positionIndices.erase(it.first);
                     return;
                 }
             }
@@ -0,0 +1,209 @@
+#include "Datasets/Annotation/AnnotationPositionIndex.h"
+#include <algorithm>
+#include <cmath>
+
+#ifndef MIN
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#endif
+
+#ifndef MAX
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+#endif
+
+namespace sereno
+{
+    /** \brief  The average number of positions per cell targeted when choosing the cell size */
+    #define INDEX_POINTS_PER_CELL 8
+
+    /** \brief  The growth factor (of the number of positions, or of an extent of their bounding box) beyond which the cell size is chosen again */
+    #define INDEX_REGRID_FACTOR 4
+
+    /** \brief  Is a position finite?
+     * \param pos the position to test
+     * \return   true if all the components are finite, false otherwise */
+    static inline bool _isFinite(const glm::vec3& pos)
+    {
+        return std::isfinite(pos.x) && std::isfinite(pos.y) && std::isfinite(pos.z);
+    }
+
+    AnnotationPositionIndex::AnnotationPositionIndex(std::shared_ptr<const std::vector<glm::vec3>> positions, float cellSize) : m_positions(positions), m_cellSize(MAX(cellSize, 0.0f)), m_autoCellSize(!(cellSize > 0.0f))
+    {
+        update();
+    }
+
+    void AnnotationPositionIndex::update()
+    {
+        if(m_positions == nullptr)
+            return;
+        const std::vector<glm::vec3>& positions = *m_positions;
+
+        //Extend the bounding box of the finite positions
+        for(uint32_t i = m_nbPoints; i < positions.size(); i++)
+        {
+            if(!_isFinite(positions[i]))
+                continue;
+            m_minPos = glm::min(m_minPos, positions[i]);
+            m_maxPos = glm::max(m_maxPos, positions[i]);
+            m_nbFinite++;
+        }
+
+        //Choose the cell size, and choose it again (re-indexing all the positions) once the positions outgrew the ones it was chosen for,
+        //e.g., when a followed log starts with a few positions
+        if(m_autoCellSize && m_nbFinite > 0)
+        {
+            bool regrid = (m_cellSize <= 0.0f || m_nbFinite >= INDEX_REGRID_FACTOR*m_gridNbFinite);
+            for(uint32_t i = 0; i < 3 && !regrid; i++)
+                regrid = ((double)m_maxPos[i] - m_minPos[i]) > INDEX_REGRID_FACTOR*m_gridExtent[i];
+
+            if(regrid)
+            {
+                //Cells of the volume (or area, or length, for flat data) of the box divided by the number of cells needed
+                double   volume = 1.0;
+                uint32_t nbDims = 0;
+                for(uint32_t i = 0; i < 3; i++)
+                {
+                    m_gridExtent[i] = (double)m_maxPos[i] - m_minPos[i];
+                    if(m_gridExtent[i] > 0.0)
+                    {
+                        volume *= m_gridExtent[i];
+                        nbDims++;
+                    }
+                }
+                double nbCells = MAX(1.0, (double)m_nbFinite / INDEX_POINTS_PER_CELL);
+                m_cellSize = (nbDims ? (float)pow(volume / nbCells, 1.0/nbDims) : 1.0f);
+                if(!(m_cellSize > 0.0f) || !std::isfinite(m_cellSize))
+                    m_cellSize = 1.0f;
+                m_gridNbFinite = m_nbFinite;
+
+                m_cells.clear();
+                m_cellPoints.clear();
+                m_cellCoords.clear();
+                m_nbPoints = 0;
+            }
+        }
+
+        if(m_cellSize <= 0.0f)
+        {
+            m_nbPoints = positions.size();
+            return;
+        }
+
+        for(; m_nbPoints < positions.size(); m_nbPoints++)
+        {
+            const glm::vec3& pos = positions[m_nbPoints];
+            if(!_isFinite(pos))
+                continue;
+
+            glm::ivec3 cell = getCell(pos);
+            auto it = m_cells.emplace(getCellKey(cell), (uint32_t)m_cellPoints.size());
+            if(it.second)
+            {
+                m_cellPoints.emplace_back();
+                m_cellCoords.push_back(cell);
+            }
+            m_cellPoints[it.first->second].push_back(m_nbPoints);
+        }
+    }
+
+    glm::ivec3 AnnotationPositionIndex::getCell(const glm::vec3& pos) const
+    {
+        const float maxCell = (float)(1 << (CELL_BITS-1));
+        glm::ivec3  cell;
+        for(uint32_t i = 0; i < 3; i++)
+            cell[i] = (int32_t)MIN(MAX(floorf(pos[i] / m_cellSize), -maxCell), maxCell-1);
+        return cell;
+    }
+
+    void AnnotationPositionIndex::queryAABB(const glm::vec3& minPos, const glm::vec3& maxPos, std::vector<uint32_t>& output) const
+    {
+        if(m_cells.empty() || !_isFinite(minPos) || !_isFinite(maxPos) || minPos.x > maxPos.x || minPos.y > maxPos.y || minPos.z > maxPos.z)
+            return;
+
+        const std::vector<glm::vec3>& positions = *m_positions;
+        forEachCell(getCell(minPos), getCell(maxPos), [&](const std::vector<uint32_t>& pointIDs)
+        {
+            for(uint32_t p : pointIDs)
+            {
+                const glm::vec3& pos = positions[p];
+                if(pos.x >= minPos.x && pos.x <= maxPos.x && pos.y >= minPos.y && pos.y <= maxPos.y && pos.z >= minPos.z && pos.z <= maxPos.z)
+                    output.push_back(p);
+            }
+        });
+    }
+
+    void AnnotationPositionIndex::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& output) const
+    {
+        if(m_cells.empty() || !_isFinite(center) || !(radius >= 0.0f) || !std::isfinite(radius))
+            return;
+
+        const std::vector<glm::vec3>& positions = *m_positions;
+        const float radius2 = radius*radius;
+        forEachCell(getCell(center - glm::vec3(radius)), getCell(center + glm::vec3(radius)), [&](const std::vector<uint32_t>& pointIDs)
+        {
+            for(uint32_t p : pointIDs)
+            {
+                glm::vec3 d = positions[p] - center;
+                if(d.x*d.x + d.y*d.y + d.z*d.z <= radius2)
+                    output.push_back(p);
+            }
+        });
+    }
+
+    int64_t AnnotationPositionIndex::queryNearest(const glm::vec3& pos, float maxDistance) const
+    {
+        if(m_cells.empty() || !_isFinite(pos) || !(maxDistance >= 0.0f))
+            return -1;
+
+        const std::vector<glm::vec3>& positions = *m_positions;
+        int64_t result    = -1;
+        float   bestDist2 = (std::isfinite(maxDistance) ? maxDistance*maxDistance : FLT_MAX);
+
+        auto testCell = [&](const std::vector<uint32_t>& pointIDs)
+        {
+            for(uint32_t p : pointIDs)
+            {
+                glm::vec3 d = positions[p] - pos;
+                float dist2 = d.x*d.x + d.y*d.y + d.z*d.z;
+                if(dist2 < bestDist2 || (dist2 == bestDist2 && result >= 0 && p < result))
+                {
+                    bestDist2 = dist2;
+                    result    = p;
+                }
+            }
+        };
+
+        //Browse the shells of cells at a Chebyshev distance k of the cell of pos.
+        //The positions of the shell k are at least (k-1)*m_cellSize far from pos
+        const glm::ivec3 center  = getCell(pos);
+        size_t           visited = 0;
+        for(int32_t k = 0; ; k++)
+        {
+            float minDist = MAX(k-1, 0) * m_cellSize;
+            if(k > 0 && minDist*minDist > bestDist2)
+                break;
+
+            //Sparse data: browsing the stored cells is cheaper than browsing empty shells
+            if(visited > m_cells.size())
+            {
+                for(const std::vector<uint32_t>& pointIDs : m_cellPoints)
+                    testCell(pointIDs);
+                break;
+            }
+
+            for(int32_t x = -k; x <= k; x++)
+                for(int32_t y = -k; y <= k; y++)
+                {
+                    bool onFace = (x == -k || x == k || y == -k || y == k);
+                    for(int32_t z = -k; z <= k; z += (onFace || k == 0 ? 1 : 2*k))
+                    {
+                        auto it = m_cells.find(getCellKey(center + glm::ivec3(x, y, z)));
+                        if(it != m_cells.end())
+                            testCell(m_cellPoints[it->second]);
+                        visited++;
+                    }
+                }
+        }
+
+        return result;
+    }
+}
@@ -1,5 +1,7 @@
 #include "Datasets/CloudPointDataset.h"
 #include "sciVisUtils.h"
+#include "MappedFile.h"
+#include "Datasets/Histogram.h"
 #include <cstdlib>
 #include <cstdio>
 #include <algorithm>
@@ -7,6 +9,7 @@
 #include <memory>
 #include <vector>
 #include <limits>
+#include <filesystem>
 
 
 #ifndef MIN
@@ -21,71 +24,171 @@ using namespace serenoSciVis;
 
 namespace sereno
 {
-    /** \brief  Utilitary function permitting to read the number of points of a file
-     * \param file the file to read. Its current cursor position is saved and restored 
+    /** \brief  The magic number starting the versioned cloud point files */
+    static const char     CLOUD_POINT_MAGIC[4]  = {'S', 'V', 'C', 'P'};
+
+    /** \brief  The latest version of the versioned cloud point files this library can read */
+    static const uint32_t CLOUD_POINT_VERSION   = 1;
+
+    /** \brief  Utilitary function permitting to read the header (number of points and fields) of a file
+     * \param path the file to read
+     * \param fields[out] the point fields (name and nbValuePerTuple) the file contains
+     * \param dataOffset[out] the position in bytes of the position array in the file
      * \param succeed a reference set at true if the function succeed its read, at false otherwise
      * \return   the number of points the file contain. Set at 0 if an error occured (see 'succeed')
      */
-    float _readNbPointsMetaData(FILE* file, bool& succeed)
+    uint32_t _readCloudPointHeader(const std::string& path, std::vector<PointFieldDesc>& fields, uint64_t& dataOffset, bool& succeed)
     {
-        size_t curPos = 0;
         succeed = false;
-        float nbPoints = 0;
-        uint8_t buffer[4];
-        if(file != NULL)
-        {
-            curPos = ftell(file);
-            //Determine the file size
-            fseek(file, 0, SEEK_END);
-            uint32_t fileSize = ftell(file);
-            if(fileSize < 4 || fileSize%4 != 0)
-            {
-                ERROR << "The file has an incorrect format (wrong size). Abort\n";
-                goto error;
-            }
-            fseek(file, 0, SEEK_SET);
+        fields.clear();
+
+        uint32_t nbPoints = 0;
+        uint32_t version  = 0;
+        uint32_t nbFields = 0;
+        uint64_t offset   = 0;
+        uint64_t expectedSize = 0;
+        uint8_t  buffer[4];
+        FILE*    file = NULL;
+
+        //Determine the file size. Files can be larger than 4GB
+        std::error_code err;
+        uint64_t fileSize = std::filesystem::file_size(path, err);
+        if(err)
+        {
+            ERROR << "Could not open the file " << path << ". Abort\n";
+            return 0;
+        }
+
+        if(fileSize < 4 || fileSize%4 != 0)
+        {
+            ERROR << "The file has an incorrect format (wrong size). Abort\n";
+            return 0;
+        }
+
+        //Only the header is read: the values are read by loadValues
+        file = fopen(path.c_str(), "rb");
+        auto readUint32 = [&](uint32_t& v)
+        {
+            if(offset + sizeof(uint32_t) > fileSize || fread(buffer, sizeof(uint8_t), sizeof(uint32_t), file) != sizeof(uint32_t))
+                return false;
+            v = uint8ToUint32(buffer);
+            offset += sizeof(uint32_t);
+            return true;
+        };
 
-            //Read the number of points
-            fread(buffer, sizeof(uint8_t), sizeof(uint32_t), file);
+        if(file == NULL || fread(buffer, sizeof(uint8_t), sizeof(uint32_t), file) != sizeof(uint32_t))
+        {
+            ERROR << "Could not read the file " << path << ". Abort\n";
+            goto end;
+        }
+        offset = sizeof(uint32_t);
+
+        //Legacy format: nbPoints, positions, one scalar value per point
+        if(memcmp(buffer, CLOUD_POINT_MAGIC, sizeof(CLOUD_POINT_MAGIC)) != 0)
+        {
             nbPoints = uint8ToUint32(buffer);
             if((fileSize-4)/(4*sizeof(float)) != nbPoints) //Escape the meta data to check the file size
             {
                 ERROR << "The file should contain " << nbPoints << " data point. Contain actually " << (fileSize-4)/(4*sizeof(float)) << " data point. Abort\n";
-                goto error;
+                nbPoints = 0;
+                goto end;
+            }
+
+            fields.resize(1);
+            fields[0].name            = "data";
+            fields[0].nbValuePerTuple = 1;
+            dataOffset = sizeof(uint32_t);
+            succeed    = true;
+            goto end;
+        }
+
+        //Versioned format
+        if(!readUint32(version) || !readUint32(nbPoints) || !readUint32(nbFields))
+        {
+            ERROR << "The file has an incorrect format (truncated header). Abort\n";
+            nbPoints = 0;
+            goto end;
+        }
+
+        if(version == 0 || version > CLOUD_POINT_VERSION)
+        {
+            ERROR << "The cloud point format version " << version << " is not supported (latest supported version: " << CLOUD_POINT_VERSION << "). Abort\n";
+            nbPoints = 0;
+            goto end;
+        }
+
+        expectedSize = 3*sizeof(float)*(uint64_t)nbPoints;
+        for(uint32_t i = 0; i < nbFields; i++)
+        {
+            PointFieldDesc desc;
+            uint32_t nameLength = 0;
+            if(!readUint32(nameLength) || offset + nameLength > fileSize)
+            {
+                ERROR << "The file has an incorrect format (truncated header). Abort\n";
+                nbPoints = 0;
+                goto end;
+            }
+
+            desc.name.resize(nameLength);
+            if(fread(&desc.name[0], sizeof(char), nameLength, file) != nameLength)
+            {
+                ERROR << "Could not read the file " << path << ". Abort\n";
+                nbPoints = 0;
+                goto end;
+            }
+            offset += nameLength;
+
+            if(!readUint32(desc.nbValuePerTuple) || desc.nbValuePerTuple == 0)
+            {
+                ERROR << "The file has an incorrect format (field " << desc.name << "). Abort\n";
+                nbPoints = 0;
+                goto end;
             }
+
+            expectedSize += sizeof(float)*(uint64_t)desc.nbValuePerTuple*nbPoints;
+            fields.push_back(desc);
+        }
+
+        //Data are 4 bytes aligned
+        offset = (offset+3) & ~3ull;
+        if(offset + expectedSize != fileSize)
+        {
+            ERROR << "The file should contain " << offset + expectedSize << " bytes. Contain actually " << fileSize << " bytes. Abort\n";
+            nbPoints = 0;
+            goto end;
         }
 
-        succeed = true;
-error:
+        dataOffset = offset;
+        succeed    = true;
+end:
+        if(!succeed)
+            fields.clear();
         if(file)
-            fseek(file, curPos, SEEK_SET);
+            fclose(file);
         return nbPoints;
     }
 
     CloudPointDataset::CloudPointDataset(const std::string& path) : m_filePath(path)
     {
         //Read meta data
-        FILE* file = fopen(m_filePath.c_str(), "r");
         bool succeed;
-        m_nbPoints = _readNbPointsMetaData(file, succeed);
-        fclose(file);
-
-        m_pointFieldDescs.resize(1);
-        m_pointFieldDescs[0].id = 0;
-        m_pointFieldDescs[0].minVal   = m_pointFieldDescs[0].maxVal = 0.0f;
-        m_pointFieldDescs[0].format   = VTK_FLOAT;
-        m_pointFieldDescs[0].nbTuples = m_nbPoints;
-        m_pointFieldDescs[0].nbValuePerTuple = 1;
-        m_pointFieldDescs[0].name = "data";
+        m_nbPoints = _readCloudPointHeader(m_filePath, m_pointFieldDescs, m_dataOffset, succeed);
 
+        for(uint32_t i = 0; i < m_pointFieldDescs.size(); i++)
+        {
+            m_pointFieldDescs[i].id       = i;
+            m_pointFieldDescs[i].minVal   = m_pointFieldDescs[i].maxVal = 0.0f;
+            m_pointFieldDescs[i].format   = VTK_FLOAT;
+            m_pointFieldDescs[i].nbTuples = m_nbPoints;
+        }
     }
 
     CloudPointDataset::~CloudPointDataset()
     {
-        if(m_positions)
-            free(m_positions);
         if(m_readThread.joinable())
             m_readThread.join();
+        if(m_positions)
+            free(m_positions);
     }
 
     std::thread* CloudPointDataset::loadValues(LoadCallback clbk, void* userData)
@@ -93,162 +196,417 @@ error:
         if(m_nbPoints == 0)
         {
             WARNING << "No points to read about... Does the file exist?\n";
-            clbk(this, 0, userData);
+            if(clbk)
+                clbk(this, 0, userData);
+            return NULL;
         }
-#define _BUFFER_SIZE 4096
+
         if(m_readThreadRunning == false)
         {
             m_readThreadRunning = true;
             m_readThread = std::thread([this, clbk, userData]()
             {
                 //Normally, with the constructor, this should always exist. But well...
-                FILE* file = fopen(m_filePath.c_str(), "r");
-                if(file != NULL)
+                MappedFile file(m_filePath);
+                const size_t nbPoints = m_nbPoints;
+                const size_t nbFields = m_pointFieldDescs.size();
+
+                uint64_t dataSize = 3*sizeof(float)*(uint64_t)nbPoints;
+                for(const PointFieldDesc& desc : m_pointFieldDescs)
+                    dataSize += sizeof(float)*(uint64_t)desc.nbValuePerTuple*nbPoints;
+
+                if(!file.isOpen() || file.getSize() < m_dataOffset + dataSize)
                 {
-                    fseek(file, 4, SEEK_SET); //Skip metadata
+                    if(clbk)
+                        clbk(this, 0, userData);
+                    m_readThreadRunning = false;
+                    return;
+                }
+
+                //One column per point field, stored after the positions
+                const uint8_t* posData = file.getData() + m_dataOffset;
+                std::vector<const uint8_t*> fieldData(nbFields);
+                std::vector<float*>         fieldValues(nbFields, NULL);
+                bool allocated = true;
+                {
+                    const uint8_t* cur = posData + 3*sizeof(float)*nbPoints;
+                    for(size_t f = 0; f < nbFields; f++)
+                    {
+                        fieldData[f]   = cur;
+                        fieldValues[f] = (float*)malloc(sizeof(float)*m_pointFieldDescs[f].nbValuePerTuple*nbPoints);
+                        allocated      = allocated && fieldValues[f] != NULL;
+                        cur           += sizeof(float)*m_pointFieldDescs[f].nbValuePerTuple*nbPoints;
+                    }
+                }
 
-                    uint8_t buffer[_BUFFER_SIZE];
-                    float* data = NULL;
-                    float minVal = std::numeric_limits<float>::max();
-                    float maxVal = -minVal;
-                    int32_t i = 0;
+                float* positions = (float*)malloc(3*sizeof(float)*nbPoints);
+                if(positions == NULL || !allocated)
+                {
+                    ERROR << "Could not allocate the memory to load " << nbPoints << " points\n";
+                    free(positions);
+                    for(float* v : fieldValues)
+                        free(v);
+                    if(clbk)
+                        clbk(this, 0, userData);
+                    m_readThreadRunning = false;
+                    return;
+                }
 
-                    m_positions = (float*)malloc(3*sizeof(float)*m_nbPoints);
-                    data        = (float*)malloc(sizeof(float)*m_nbPoints);
+                std::vector<float> fieldMin(nbFields, std::numeric_limits<float>::max());
+                std::vector<float> fieldMax(nbFields, std::numeric_limits<float>::lowest());
+                float minX = std::numeric_limits<float>::max(),    minY = minX, minZ = minX;
+                float maxX = std::numeric_limits<float>::lowest(), maxY = maxX, maxZ = maxX;
 
-                    m_minPos.x = m_minPos.y = m_minPos.z = std::numeric_limits<float>::max();
-                    m_maxPos.x = m_maxPos.y = m_maxPos.z = std::numeric_limits<float>::min();
+                //Convert the data in chunks (positions and point fields) and reduce the bounding box and the data ranges at the same time
+                {
+#ifdef _OPENMP
+                    std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+                    const size_t  CHUNK_SIZE = 1 << 16;
+                    const int64_t nbChunks   = (nbPoints + CHUNK_SIZE - 1)/CHUNK_SIZE;
 
-                    //Read all points
-                    i = m_nbPoints-1;
-                    while(i >= 0)
+#if defined(_OPENMP)
+                    #pragma omp parallel reduction(min:minX,minY,minZ) reduction(max:maxX,maxY,maxZ)
+#endif
                     {
-                        //Use as much as possible the whole buffer to avoid "small read chunk"
-                        uint32_t nbPointInRead = MIN(i+1, (int32_t)(_BUFFER_SIZE/(3*sizeof(float))));
-                        fread(buffer, sizeof(uint8_t), 3*sizeof(float)*nbPointInRead, file);
+                        std::vector<float> privateMin(nbFields, std::numeric_limits<float>::max());
+                        std::vector<float> privateMax(nbFields, std::numeric_limits<float>::lowest());
 
-                        //Save the data position
-                        for(uint32_t j = 0; j < nbPointInRead; j++, i--)
-                            for(uint32_t k = 0; k < 3; k++)
+#if defined(_OPENMP)
+                        #pragma omp for schedule(static)
+#endif
+                        for(int64_t c = 0; c < nbChunks; c++)
+                        {
+                            size_t begin = c*CHUNK_SIZE;
+                            size_t end   = MIN(begin+CHUNK_SIZE, nbPoints);
+
+                            bigEndianToFloats(positions + 3*begin, posData + 3*sizeof(float)*begin, 3*(end-begin));
+                            for(size_t i = begin; i < end; i++)
                             {
-                                float pos = uint8ToFloat(buffer+sizeof(float)*(3*j+k));
-                                m_positions[3*(m_nbPoints-1-i) + k] = pos;
-                                if(m_minPos[k] > pos)
-                                    m_minPos[k] = pos;
-                                if(m_maxPos[k] < pos)
-                                    m_maxPos[k] = pos;
+                                minX = MIN(minX, positions[3*i+0]);
+                                minY = MIN(minY, positions[3*i+1]);
+                                minZ = MIN(minZ, positions[3*i+2]);
+                                maxX = MAX(maxX, positions[3*i+0]);
+                                maxY = MAX(maxY, positions[3*i+1]);
+                                maxZ = MAX(maxZ, positions[3*i+2]);
                             }
-                    }
 
-                    //Do the same for point data (float scalar)
-                    i = m_nbPoints-1;
-                    while(i >= 0)
-                    {
-                        //Use as much as possible the whole buffer to avoid "small read chunk"
-                        uint32_t nbPointInRead = MIN(i+1, (int32_t)(_BUFFER_SIZE/(sizeof(float))));
-                        fread(buffer, sizeof(uint8_t), nbPointInRead*sizeof(float), file);
+                            //Scalar fields use their value, vector fields their magnitude
+                            for(size_t f = 0; f < nbFields; f++)
+                            {
+                                const uint32_t nbValues = m_pointFieldDescs[f].nbValuePerTuple;
+                                float*         values   = fieldValues[f];
+                                bigEndianToFloats(values + nbValues*begin, fieldData[f] + nbValues*sizeof(float)*begin, nbValues*(end-begin));
+
+                                for(size_t i = begin; i < end; i++)
+                                {
+                                    float mag = values[i];
+                                    if(nbValues > 1)
+                                    {
+                                        mag = 0.0f;
+                                        for(uint32_t k = 0; k < nbValues; k++)
+                                            mag += values[nbValues*i+k]*values[nbValues*i+k];
+                                        mag = sqrt(mag);
+                                    }
+                                    privateMin[f] = MIN(privateMin[f], mag);
+                                    privateMax[f] = MAX(privateMax[f], mag);
+                                }
+                            }
+                        }
 
-                        //Save the data position
-                        for(uint32_t j = 0; j < nbPointInRead; j++, i--)
+                        //Merge everything
+#if defined(_OPENMP)
+                        #pragma omp critical
+#endif
                         {
-                            data[m_nbPoints-1-i] = uint8ToFloat(buffer+sizeof(float)*j);
-                            minVal = MIN(minVal, data[m_nbPoints-1-i]);
-                            maxVal = MAX(maxVal, data[m_nbPoints-1-i]);
+                            for(size_t f = 0; f < nbFields; f++)
+                            {
+                                fieldMin[f] = MIN(fieldMin[f], privateMin[f]);
+                                fieldMax[f] = MAX(fieldMax[f], privateMax[f]);
+                            }
                         }
                     }
+                }
 
-                    m_pointFieldDescs[0].minVal = minVal;
-                    m_pointFieldDescs[0].maxVal = maxVal;
-                    m_pointFieldDescs[0].values.emplace_back(data, _FreeDeleter());
-
-                    m_valuesLoaded = true;
-
-                    fclose(file);
+                m_positions = positions;
+                m_minPos    = glm::vec3(minX, minY, minZ);
+                m_maxPos    = glm::vec3(maxX, maxY, maxZ);
 
-                    if(clbk)
-                        clbk(this, 1, userData);
-                    m_readThreadRunning = false;
-                }
-                else
+                for(size_t f = 0; f < nbFields; f++)
                 {
-                    if(clbk)
-                        clbk(this, 0, userData);
-                    m_readThreadRunning = false;
-                    return;
+                    m_pointFieldDescs[f].minVal = fieldMin[f];
+                    m_pointFieldDescs[f].maxVal = fieldMax[f];
+                    m_pointFieldDescs[f].values.emplace_back(fieldValues[f], _FreeDeleter());
                 }
+
+                //Post-process the points before flagging them as loaded: reorderPoints replaces all the arrays
+                if(m_reorderPoints)
+                    doReorderPoints(m_reorderCurve);
+                if(m_buildSpatialIndex)
+                    doBuildSpatialIndex();
+                if(m_buildLOD)
+                    doBuildLOD(m_lodNodeQuota);
+
+                m_valuesLoaded = true;
+                if(clbk)
+                    clbk(this, 1, userData);
+                m_readThreadRunning = false;
             });
 
             return &m_readThread;
         }
         return NULL;
-#undef _BUFFER_SIZE
     }
 
-    bool CloudPointDataset::create1DHistogram(uint32_t* output, uint32_t width, uint32_t ptFieldXID) const
+    bool CloudPointDataset::buildSpatialIndex(uint32_t maxLeafSize)
     {
-        //Check property
-        if(ptFieldXID != 0)
+        if(!m_valuesLoaded || m_positions == NULL)
         {
-            ERROR << "Point Field X could not be found. Expected value: 0" << std::endl;
+            WARNING << "Cannot build the spatial index of a dataset not loaded yet\n";
             return false;
         }
 
-        //Reinitialize the image
-        for(uint32_t i=0; i < width; i++)
-            output[i] = 0;
+        doBuildSpatialIndex(maxLeafSize);
+        return true;
+    }
+
+    bool CloudPointDataset::buildLOD(uint32_t nodeQuota)
+    {
+        if(!m_valuesLoaded || m_positions == NULL)
+        {
+            WARNING << "Cannot build the level-of-detail hierarchy of a dataset not loaded yet\n";
+            return false;
+        }
+
+        doBuildLOD(nodeQuota);
+        return true;
+    }
+
+    bool CloudPointDataset::reorderPoints(SpaceFillingCurveType curve)
+    {
+        if(!m_valuesLoaded || m_positions == NULL)
+        {
+            WARNING << "Cannot reorder the points of a dataset not loaded yet\n";
+            return false;
+        }
+
+        return doReorderPoints(curve);
+    }
+
+    void CloudPointDataset::doBuildSpatialIndex(uint32_t maxLeafSize)
+    {
+        //The level-of-detail hierarchy references the previous spatial index
+        bool rebuildLOD = (m_lod != nullptr);
+        m_lod.reset();
+
+        m_spatialIndex.reset(new CloudPointOctree(m_positions, m_nbPoints, m_minPos, m_maxPos, maxLeafSize));
+        if(rebuildLOD)
+            doBuildLOD(m_lodNodeQuota);
+    }
 
-        //Constant values
-        const PointFieldDesc& ptX = m_pointFieldDescs[0];
-        const float xDiv = ptX.maxVal - ptX.minVal;
+    void CloudPointDataset::doBuildLOD(uint32_t nodeQuota)
+    {
+        if(m_spatialIndex == nullptr)
+            doBuildSpatialIndex();
 
-        float* data = (float*)ptX.values[0].get();
+        m_lodNodeQuota = nodeQuota;
+        m_lod.reset(new CloudPointLOD(*m_spatialIndex, nodeQuota));
+    }
 
+    bool CloudPointDataset::doReorderPoints(SpaceFillingCurveType curve)
+    {
+        //Volumetric masks are indexed by the current point order. Uniform masks do not depend on it, other masks would be silently scrambled
+        for(const SubDataset* sd : m_subDatasets)
+        {
+            size_t count = sd->countVolumetricMask();
+            if(count != 0 && count != m_nbPoints)
+            {
+                WARNING << "Cannot reorder the points while the SubDataset " << sd->getName() << " holds a volumetric selection\n";
+                return false;
+            }
+        }
+
+        const size_t nbPoints = m_nbPoints;
+        uint64_t* codes     = (uint64_t*)malloc(sizeof(uint64_t)*nbPoints);
+        uint32_t* perm      = (uint32_t*)malloc(sizeof(uint32_t)*nbPoints);
+        float*    positions = (float*)malloc(3*sizeof(float)*nbPoints);
+
+        //Allocate every destination array before modifying anything, so that a failure leaves the dataset untouched
+        std::vector<float*> fieldValues;
+        bool allocated = (codes != NULL && perm != NULL && positions != NULL);
+        for(const PointFieldDesc& desc : m_pointFieldDescs)
+            for(size_t v = 0; v < desc.values.size() && allocated; v++)
+            {
+                fieldValues.push_back((float*)malloc(sizeof(float)*desc.nbValuePerTuple*nbPoints));
+                allocated = (fieldValues.back() != NULL);
+            }
+
+        if(allocated)
+        {
 #ifdef _OPENMP
-        std::lock_guard<std::mutex> ompLock(ompMutex);
+            std::lock_guard<std::mutex> ompLock(ompMutex);
 #endif
+            const float minPos[] = {m_minPos.x, m_minPos.y, m_minPos.z};
+            const float maxPos[] = {m_maxPos.x, m_maxPos.y, m_maxPos.z};
+            computeSpaceFillingCurveCodes(m_positions, nbPoints, minPos, maxPos, curve, codes);
 
 #if defined(_OPENMP)
-        uint32_t* privateHisto = nullptr;
-#pragma omp parallel private(privateHisto)
+            #pragma omp parallel for schedule(static)
+#endif
+            for(int64_t i = 0; i < (int64_t)nbPoints; i++)
+                perm[i] = i;
+            allocated = radixSort(codes, perm, nbPoints, 3*SPACE_FILLING_CURVE_BITS);
+        }
+
+        if(!allocated)
         {
-            //Initialize a private histogram
-            privateHisto = (uint32_t*)malloc(sizeof(uint32_t)*width);
-            for(uint32_t i=0; i<width; i++) 
-                privateHisto[i] = 0;
+            ERROR << "Could not allocate the memory to reorder " << nbPoints << " points\n";
+            free(codes);
+            free(perm);
+            free(positions);
+            for(float* v : fieldValues)
+                free(v);
+            return false;
+        }
 
-            #pragma omp for
-            for(uint32_t i = 0; i < ptX.nbTuples; i++)
+        {
+#ifdef _OPENMP
+            std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+            //Gather the positions
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(static)
+#endif
+            for(int64_t i = 0; i < (int64_t)nbPoints; i++)
+                for(uint8_t k = 0; k < 3; k++)
+                    positions[3*i+k] = m_positions[3*perm[i]+k];
+
+            //Gather the point field values
+            size_t fieldID = 0;
+            for(PointFieldDesc& desc : m_pointFieldDescs)
             {
-                uint32_t x = MIN(width*(data[i]-ptX.minVal)/xDiv, width-1);
-                privateHisto[x]++;
+                const uint32_t nbValues = desc.nbValuePerTuple;
+                for(std::shared_ptr<void>& values : desc.values)
+                {
+                    const float* src = (const float*)values.get();
+                    float*       dst = fieldValues[fieldID++];
+
+#if defined(_OPENMP)
+                    #pragma omp parallel for schedule(static)
+#endif
+                    for(int64_t i = 0; i < (int64_t)nbPoints; i++)
+                        for(uint32_t k = 0; k < nbValues; k++)
+                            dst[nbValues*i+k] = src[nbValues*perm[i]+k];
+
+                    values = std::shared_ptr<void>(dst, _FreeDeleter());
+                }
             }
 
-            //Merge everything
-            #pragma omp critical 
+            //Compose with the previous permutation, if any
+            if(m_pointOriginalIDs.size())
             {
-                for(uint32_t i=0; i<width; i++) 
-                    output[i] += privateHisto[i];
+#if defined(_OPENMP)
+                #pragma omp parallel for schedule(static)
+#endif
+                for(int64_t i = 0; i < (int64_t)nbPoints; i++)
+                    perm[i] = m_pointOriginalIDs[perm[i]];
             }
+        }
+
+        m_pointOriginalIDs.assign(perm, perm+nbPoints);
+        free(m_positions);
+        m_positions = positions;
+        free(codes);
+        free(perm);
+
+        //The recorded mask edits (and the edits in progress) are indexed by the previous point order
+        for(SubDataset* sd : m_subDatasets)
+        {
+            sd->endVolumetricMaskEdit(false);
+            sd->getVolumetricMaskHistory().clear();
+        }
+
+        //The spatial index references the previous point order
+        if(m_spatialIndex)
+            doBuildSpatialIndex();
+        return true;
+    }
 
-            free(privateHisto);
+    bool CloudPointDataset::mapMaskToOriginalOrder(const uint8_t* mask, uint8_t* output) const
+    {
+        const size_t maskSize = (m_nbPoints+7)/8;
+        if(m_pointOriginalIDs.size() == 0)
+        {
+            if(mask != output)
+                memcpy(output, mask, maskSize);
+            return true;
         }
-#else
+
+        uint8_t* tmp = (mask == output ? (uint8_t*)malloc(maskSize) : output);
+        if(tmp == NULL)
         {
-            for(uint32_t i = 0; i < ptX.nbTuples; i++)
+            ERROR << "Could not allocate the memory to map a mask of " << m_nbPoints << " points\n";
+            return false;
+        }
+
+#ifdef _OPENMP
+        std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+
+        //Inverse permutation: file order -> current order
+        std::vector<uint32_t> currentIDs(m_nbPoints);
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(static)
+#endif
+        for(int64_t i = 0; i < (int64_t)m_nbPoints; i++)
+            currentIDs[m_pointOriginalIDs[i]] = i;
+
+        //Gather byte per byte to avoid concurrent writes on the same byte
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(static)
+#endif
+        for(int64_t b = 0; b < (int64_t)maskSize; b++)
+        {
+            uint8_t byte = 0;
+            for(uint32_t bit = 0; bit < 8 && 8*b+bit < m_nbPoints; bit++)
             {
-                float xVal = data[i];
-                uint32_t x = MIN(width*(xVal-ptX.minVal)/xDiv, width-1);
-                output[x]++;
+                uint32_t id = currentIDs[8*b+bit];
+                byte |= ((mask[id/8] >> (id%8)) & 0x01) << bit;
             }
+            tmp[b] = byte;
         }
-#endif
 
-            return true;
+        if(tmp != output)
+        {
+            memcpy(output, tmp, maskSize);
+            free(tmp);
+        }
+        return true;
+    }
+
+    bool CloudPointDataset::create1DHistogram(uint32_t* output, uint32_t width, uint32_t ptFieldXID) const
+    {
+        //Check property
+        if(ptFieldXID >= m_pointFieldDescs.size() || !m_valuesLoaded)
+        {
+            ERROR << "Point Field X could not be found." << std::endl;
+            return false;
+        }
+
+        computePointField1DHistogram(m_pointFieldDescs[ptFieldXID], output, width);
+        return true;
     }
 
     bool CloudPointDataset::create2DHistogram(uint32_t* output, uint32_t width, uint32_t height, uint32_t ptFieldXID, uint32_t ptFieldYID) const
     {
-        ERROR << "Cannot compute 2D Histogram since this kind of Dataset possess only one scalar value per data point\n";
-        return false; /*!< No 2D information*/
+        //Check property
+        if(ptFieldXID >= m_pointFieldDescs.size() || ptFieldYID >= m_pointFieldDescs.size() || !m_valuesLoaded)
+        {
+            ERROR << "Point Field X or Point Field Y could not be found." << std::endl;
+            return false;
+        }
+
+        computePointField2DHistogram(m_pointFieldDescs[ptFieldXID], m_pointFieldDescs[ptFieldYID], output, width, height);
+        return true;
     }
 }
@@ -0,0 +1,304 @@
+#include "Datasets/CloudPointLOD.h"
+#include "sciVisUtils.h"
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace sereno
+{
+    /** \brief  Hash function (splitmix64) used to draw reproducible pseudo-random numbers in parallel
+     * \param x the value to hash
+     * \return   the hashed value */
+    static inline uint64_t _hashSplitMix64(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ULL;
+        x  = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x  = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    /** \brief  Compute a progressive order of [0, n[ using a bit-reversal permutation: any prefix of the order is spread evenly over [0, n[
+     * \param n the number of elements to order
+     * \param order[out] the computed order. Size: n */
+    static void _progressiveOrder(uint32_t n, std::vector<uint32_t>& order)
+    {
+        order.clear();
+        uint32_t nbBits = 0;
+        while((1ull << nbBits) < n)
+            nbBits++;
+
+        for(uint64_t i = 0; i < (1ull << nbBits); i++)
+        {
+            uint32_t r = 0;
+            for(uint32_t b = 0; b < nbBits; b++)
+                r |= ((i >> b) & 0x01) << (nbBits-1-b);
+            if(r < n)
+                order.push_back(r);
+        }
+    }
+
+    CloudPointLOD::CloudPointLOD(const CloudPointOctree& octree, uint32_t nodeQuota) : m_octree(octree)
+    {
+        const std::vector<CloudPointOctreeNode>& nodes   = octree.getNodes();
+        const std::vector<uint32_t>&             indices = octree.getIndices();
+
+        nodeQuota = std::max(nodeQuota, 1u);
+        m_nodeSampleBegin.resize(nodes.size());
+        m_nodeSampleCount.resize(nodes.size());
+        m_samples.reserve(octree.getNbPoints());
+
+        //Points (indices in the sorted point IDs) already owned by an ancestor
+        std::vector<uint8_t> taken(octree.getNbPoints(), 0);
+
+#ifdef _OPENMP
+        std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+
+        //Octree nodes are stored level by level. Nodes of the same level do not share points and can be handled in parallel
+        size_t levelBegin = 0;
+        while(levelBegin < nodes.size())
+        {
+            size_t levelEnd = levelBegin;
+            while(levelEnd < nodes.size() && nodes[levelEnd].depth == nodes[levelBegin].depth)
+                levelEnd++;
+
+            std::vector<std::vector<uint32_t>> levelSamples(levelEnd - levelBegin);
+
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(dynamic)
+#endif
+            for(int64_t l = 0; l < (int64_t)(levelEnd - levelBegin); l++)
+            {
+                const uint32_t              nodeID = levelBegin + l;
+                const CloudPointOctreeNode& node   = nodes[nodeID];
+
+                std::vector<uint32_t> remaining;
+                for(uint32_t j = node.begin; j < node.end; j++)
+                    if(!taken[j])
+                        remaining.push_back(j);
+
+                //Pick one random point per stratum. Strata are contiguous ranges along the Morton curve, hence spatially coherent
+                std::vector<uint32_t> picks;
+                if(node.isLeaf || remaining.size() <= nodeQuota)
+                    picks = std::move(remaining);
+                else
+                {
+                    picks.resize(nodeQuota);
+                    for(uint32_t s = 0; s < nodeQuota; s++)
+                    {
+                        uint64_t begin = (uint64_t)s*remaining.size()/nodeQuota;
+                        uint64_t end   = (uint64_t)(s+1)*remaining.size()/nodeQuota;
+                        picks[s] = remaining[begin + _hashSplitMix64(((uint64_t)nodeID << 32) | s) % (end-begin)];
+                    }
+                }
+
+                std::vector<uint32_t> order;
+                _progressiveOrder(picks.size(), order);
+
+                std::vector<uint32_t>& samples = levelSamples[l];
+                samples.resize(picks.size());
+                for(uint32_t i = 0; i < order.size(); i++)
+                {
+                    samples[i] = indices[picks[order[i]]];
+                    taken[picks[order[i]]] = 1;
+                }
+            }
+
+            for(size_t l = 0; l < levelSamples.size(); l++)
+            {
+                m_nodeSampleBegin[levelBegin+l] = m_samples.size();
+                m_nodeSampleCount[levelBegin+l] = levelSamples[l].size();
+                m_samples.insert(m_samples.end(), levelSamples[l].begin(), levelSamples[l].end());
+            }
+            levelBegin = levelEnd;
+        }
+    }
+
+    template <typename NodeTest, typename PointTest>
+    uint32_t CloudPointLOD::query(uint32_t budget, const NodeTest& nodeTest, const PointTest& pointTest, std::vector<uint32_t>& output) const
+    {
+        /** \brief  A node to take the points from */
+        struct Entry
+        {
+            uint32_t nodeID; /*!< The node ID*/
+            bool     inside; /*!< Is the node entirely inside the queried volume?*/
+        };
+
+        const std::vector<CloudPointOctreeNode>& nodes = m_octree.getNodes();
+        uint32_t appended = 0;
+
+        //Number of samples of a node inside the queried volume
+        auto countSamples = [&](const Entry& e)
+        {
+            if(e.inside)
+                return m_nodeSampleCount[e.nodeID];
+
+            const uint32_t* samples = m_samples.data() + m_nodeSampleBegin[e.nodeID];
+            uint32_t count = 0;
+            for(uint32_t i = 0; i < m_nodeSampleCount[e.nodeID]; i++)
+                if(pointTest(m_octree.getPosition(samples[i])))
+                    count++;
+            return count;
+        };
+
+        //Append the first "count" samples of a node inside the queried volume
+        auto addSamples = [&](const Entry& e, uint32_t count)
+        {
+            const uint32_t* samples = m_samples.data() + m_nodeSampleBegin[e.nodeID];
+            for(uint32_t i = 0; i < m_nodeSampleCount[e.nodeID] && count > 0; i++)
+            {
+                if(e.inside || pointTest(m_octree.getPosition(samples[i])))
+                {
+                    output.push_back(samples[i]);
+                    appended++;
+                    count--;
+                }
+            }
+        };
+
+        std::vector<Entry> current;
+        std::vector<Entry> next;
+        if(nodes.size())
+        {
+            int32_t state = nodeTest(nodes[0]);
+            if(state >= 0)
+                current.push_back({0, state > 0});
+        }
+
+        //Take whole levels while the budget allows it
+        uint64_t remainingBudget = budget;
+        std::vector<uint32_t> counts;
+        while(current.size() && remainingBudget > 0)
+        {
+            uint64_t levelCount = 0;
+            counts.resize(current.size());
+            for(uint32_t i = 0; i < current.size(); i++)
+            {
+                counts[i]   = countSamples(current[i]);
+                levelCount += counts[i];
+            }
+
+            //The last level does not fit: take the same proportion of every node. Sample prefixes remain spatially stratified
+            //The points lost by rounding down every node are handed out with the largest-remainder method so that the budget is filled
+            if(levelCount > remainingBudget)
+            {
+                std::vector<uint32_t> quotas(current.size());
+                std::vector<uint64_t> remainders(current.size());
+                std::vector<uint32_t> order(current.size());
+                uint64_t leftover = remainingBudget;
+                for(uint32_t i = 0; i < current.size(); i++)
+                {
+                    uint64_t share = counts[i]*remainingBudget;
+                    quotas[i]      = (uint32_t)(share / levelCount);
+                    remainders[i]  = share % levelCount;
+                    order[i]       = i;
+                    leftover      -= quotas[i];
+                }
+
+                std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+                {
+                    return remainders[a] > remainders[b] || (remainders[a] == remainders[b] && a < b);
+                });
+                for(uint32_t i = 0; i < order.size() && leftover > 0; i++)
+                {
+                    if(quotas[order[i]] < counts[order[i]])
+                    {
+                        quotas[order[i]]++;
+                        leftover--;
+                    }
+                }
+
+                for(uint32_t i = 0; i < current.size(); i++)
+                    addSamples(current[i], quotas[i]);
+                break;
+            }
+
+            next.clear();
+            for(uint32_t i = 0; i < current.size(); i++)
+            {
+                const Entry& e = current[i];
+                addSamples(e, counts[i]);
+                for(uint32_t c = 0; c < 8; c++)
+                {
+                    int32_t childID = nodes[e.nodeID].children[c];
+                    if(childID < 0)
+                        continue;
+                    if(e.inside)
+                        next.push_back({(uint32_t)childID, true});
+                    else
+                    {
+                        int32_t state = nodeTest(nodes[childID]);
+                        if(state >= 0)
+                            next.push_back({(uint32_t)childID, state > 0});
+                    }
+                }
+            }
+            remainingBudget -= levelCount;
+            std::swap(current, next);
+        }
+
+        return appended;
+    }
+
+    uint32_t CloudPointLOD::query(uint32_t budget, std::vector<uint32_t>& output) const
+    {
+        return query(budget, [](const CloudPointOctreeNode&) {return 1;}, [](const glm::vec3&) {return true;}, output);
+    }
+
+    uint32_t CloudPointLOD::queryAABB(uint32_t budget, const glm::vec3& minPos, const glm::vec3& maxPos, std::vector<uint32_t>& output) const
+    {
+        return query(budget, [&](const CloudPointOctreeNode& node)
+        {
+            bool inside = true;
+            for(uint8_t k = 0; k < 3; k++)
+            {
+                if(node.maxPos[k] < minPos[k] || node.minPos[k] > maxPos[k])
+                    return -1;
+                inside = inside && node.minPos[k] >= minPos[k] && node.maxPos[k] <= maxPos[k];
+            }
+            return (inside ? 1 : 0);
+        },
+        [&](const glm::vec3& pos)
+        {
+            for(uint8_t k = 0; k < 3; k++)
+                if(pos[k] < minPos[k] || pos[k] > maxPos[k])
+                    return false;
+            return true;
+        }, output);
+    }
+
+    uint32_t CloudPointLOD::queryFrustum(uint32_t budget, const glm::vec4* planes, std::vector<uint32_t>& output) const
+    {
+        return query(budget, [&](const CloudPointOctreeNode& node)
+        {
+            bool inside = true;
+            for(uint8_t i = 0; i < 6; i++)
+            {
+                const glm::vec3 normal(planes[i].x, planes[i].y, planes[i].z);
+
+                //The box corners the farthest along and against the plane normal
+                glm::vec3 pVertex, nVertex;
+                for(uint8_t k = 0; k < 3; k++)
+                {
+                    pVertex[k] = (normal[k] >= 0.0f ? node.maxPos[k] : node.minPos[k]);
+                    nVertex[k] = (normal[k] >= 0.0f ? node.minPos[k] : node.maxPos[k]);
+                }
+
+                if(glm::dot(normal, pVertex) + planes[i].w < 0.0f)
+                    return -1;
+                if(glm::dot(normal, nVertex) + planes[i].w < 0.0f)
+                    inside = false;
+            }
+            return (inside ? 1 : 0);
+        },
+        [&](const glm::vec3& pos)
+        {
+            for(uint8_t i = 0; i < 6; i++)
+                if(glm::dot(glm::vec3(planes[i].x, planes[i].y, planes[i].z), pos) + planes[i].w < 0.0f)
+                    return false;
+            return true;
+        }, output);
+    }
+}
@@ -0,0 +1,192 @@
+#include "Datasets/CloudPointOctree.h"
+#include "SpaceFillingCurve.h"
+#include "sciVisUtils.h"
+#include <algorithm>
+#include <iostream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace sereno
+{
+    CloudPointOctree::CloudPointOctree(const float* positions, uint32_t nbPoints, const glm::vec3& minPos, const glm::vec3& maxPos, uint32_t maxLeafSize) : m_positions(positions)
+    {
+        if(nbPoints == 0 || positions == NULL)
+            return;
+        maxLeafSize = std::max(maxLeafSize, 1u);
+
+        std::vector<uint64_t> codes(nbPoints);
+        m_indices.resize(nbPoints);
+
+#ifdef _OPENMP
+        std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+
+        //Compute the Morton code of every point and sort the points along the curve
+        const float minArr[] = {minPos.x, minPos.y, minPos.z};
+        const float maxArr[] = {maxPos.x, maxPos.y, maxPos.z};
+        computeSpaceFillingCurveCodes(positions, nbPoints, minArr, maxArr, SPACE_FILLING_CURVE_MORTON, codes.data());
+
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(static)
+#endif
+        for(int64_t i = 0; i < (int64_t)nbPoints; i++)
+            m_indices[i] = i;
+        if(!radixSort(codes.data(), m_indices.data(), nbPoints, 3*SPACE_FILLING_CURVE_BITS))
+        {
+            ERROR << "Could not allocate the memory to index " << nbPoints << " points\n";
+            m_indices.clear();
+            return;
+        }
+
+        //Create the root
+        CloudPointOctreeNode root;
+        root.minPos = minPos;
+        root.maxPos = maxPos;
+        root.begin  = 0;
+        root.end    = nbPoints;
+        root.depth  = 0;
+        root.isLeaf = (nbPoints <= maxLeafSize);
+        std::fill(root.children, root.children+8, -1);
+        m_nodes.push_back(root);
+
+        //Build the octree level by level. Each child is a contiguous sub-range of its parent because points are sorted along the Morton curve
+        std::vector<uint32_t> level = {0};
+        std::vector<uint32_t> splits;
+        while(level.size())
+        {
+            splits.resize(9*level.size());
+
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(dynamic, 64)
+#endif
+            for(int64_t l = 0; l < (int64_t)level.size(); l++)
+            {
+                const CloudPointOctreeNode& node = m_nodes[level[l]];
+                uint32_t* s = splits.data() + 9*l;
+                s[0] = node.begin;
+                s[8] = node.end;
+                if(node.isLeaf)
+                    continue;
+
+                const uint32_t shift  = 3*(SPACE_FILLING_CURVE_BITS - node.depth - 1);
+                const uint64_t prefix = (codes[node.begin] >> (shift+3)) << (shift+3);
+                for(uint32_t c = 1; c < 8; c++)
+                    s[c] = std::lower_bound(codes.begin()+s[c-1], codes.begin()+node.end, prefix | ((uint64_t)c << shift)) - codes.begin();
+            }
+
+            std::vector<uint32_t> nextLevel;
+            for(uint32_t l = 0; l < level.size(); l++)
+            {
+                CloudPointOctreeNode parent = m_nodes[level[l]]; //Copy: m_nodes is modified in this loop
+                if(parent.isLeaf)
+                    continue;
+
+                const uint32_t* s    = splits.data() + 9*l;
+                const glm::vec3 half = (parent.maxPos - parent.minPos)*0.5f;
+                for(uint32_t c = 0; c < 8; c++)
+                {
+                    if(s[c] == s[c+1])
+                        continue;
+
+                    CloudPointOctreeNode child;
+                    child.minPos = parent.minPos + half*glm::vec3(c&1, (c>>1)&1, (c>>2)&1);
+                    child.maxPos = child.minPos + half;
+                    child.begin  = s[c];
+                    child.end    = s[c+1];
+                    child.depth  = parent.depth+1;
+                    child.isLeaf = (child.getNbPoints() <= maxLeafSize || child.depth == SPACE_FILLING_CURVE_BITS);
+                    std::fill(child.children, child.children+8, -1);
+
+                    m_nodes[level[l]].children[c] = m_nodes.size();
+                    nextLevel.push_back(m_nodes.size());
+                    m_nodes.push_back(child);
+                }
+            }
+            level = std::move(nextLevel);
+        }
+    }
+
+    template <typename NodeTest, typename PointTest>
+    void CloudPointOctree::query(const NodeTest& nodeTest, const PointTest& pointTest, std::vector<uint32_t>& output) const
+    {
+        if(m_nodes.size() == 0)
+            return;
+
+        std::vector<uint32_t> stack = {0};
+        while(stack.size())
+        {
+            const CloudPointOctreeNode& node = m_nodes[stack.back()];
+            stack.pop_back();
+
+            int32_t state = nodeTest(node);
+            if(state < 0)
+                continue;
+            else if(state > 0)
+                output.insert(output.end(), m_indices.begin()+node.begin, m_indices.begin()+node.end);
+            else if(node.isLeaf)
+            {
+                for(uint32_t i = node.begin; i < node.end; i++)
+                    if(pointTest(getPosition(m_indices[i])))
+                        output.push_back(m_indices[i]);
+            }
+            else
+            {
+                for(uint32_t c = 0; c < 8; c++)
+                    if(node.children[c] >= 0)
+                        stack.push_back(node.children[c]);
+            }
+        }
+    }
+
+    void CloudPointOctree::queryAABB(const glm::vec3& minPos, const glm::vec3& maxPos, std::vector<uint32_t>& output) const
+    {
+        query([&](const CloudPointOctreeNode& node)
+        {
+            bool inside = true;
+            for(uint8_t k = 0; k < 3; k++)
+            {
+                if(node.maxPos[k] < minPos[k] || node.minPos[k] > maxPos[k])
+                    return -1;
+                inside = inside && node.minPos[k] >= minPos[k] && node.maxPos[k] <= maxPos[k];
+            }
+            return (inside ? 1 : 0);
+        },
+        [&](const glm::vec3& pos)
+        {
+            for(uint8_t k = 0; k < 3; k++)
+                if(pos[k] < minPos[k] || pos[k] > maxPos[k])
+                    return false;
+            return true;
+        }, output);
+    }
+
+    void CloudPointOctree::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& output) const
+    {
+        const float r2 = radius*radius;
+        query([&](const CloudPointOctreeNode& node)
+        {
+            float minDist2 = 0.0f;
+            float maxDist2 = 0.0f;
+            for(uint8_t k = 0; k < 3; k++)
+            {
+                float dMin = node.minPos[k] - center[k];
+                float dMax = center[k] - node.maxPos[k];
+                float d    = std::max(std::max(dMin, dMax), 0.0f);
+                minDist2  += d*d;
+
+                float far  = std::max(std::abs(dMin), std::abs(dMax));
+                maxDist2  += far*far;
+            }
+            if(minDist2 > r2)
+                return -1;
+            return (maxDist2 <= r2 ? 1 : 0);
+        },
+        [&](const glm::vec3& pos)
+        {
+            glm::vec3 d = pos - center;
+            return glm::dot(d, d) <= r2;
+        }, output);
+    }
+}
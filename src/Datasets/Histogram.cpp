@@ -0,0 +1,169 @@
+#include "Datasets/Histogram.h"
+#include "sciVisUtils.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef MIN
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#endif
+
+#ifndef MAX
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+#endif
+
+namespace sereno
+{
+    /** \brief  Get the bin of a value
+     * \param val the value to evaluate
+     * \param minVal the minimum value of the range
+     * \param div the range amplitude (maxVal - minVal)
+     * \param nbBins the number of bins
+     * \return   the bin indice, clamped in [0, nbBins-1] */
+    static inline uint32_t _histogramBin(float val, float minVal, float div, uint32_t nbBins)
+    {
+        if(!(div > 0.0f))
+            return 0;
+        float pos = nbBins*(val-minVal)/div;
+        if(!(pos > 0.0f))
+            return 0;
+        return MIN((uint32_t)pos, nbBins-1);
+    }
+
+    /** \brief  Accumulate the bins of point field tuples over all their timesteps, in parallel
+     * @tparam Bin the type of bin
+     * \param nbTimesteps the number of timesteps to evaluate
+     * \param nbTuples the number of tuples to evaluate
+     * \param selection the tuples to evaluate, or NULL to evaluate them all. Only the ranges of selected tuples are visited
+     * \param nbBins the number of bins of the histogram
+     * \param output the output histogram. Size: nbBins
+     * \param bin function returning the bin of a tuple, or -1 to discard it: int64_t bin(uint32_t timestep, size_t tupleID) */
+    template <typename Bin>
+    static void _computeHistogram(uint32_t nbTimesteps, size_t nbTuples, const CompressedBitmask* selection, uint32_t nbBins, uint32_t* output, const Bin& bin)
+    {
+        memset(output, 0x00, sizeof(uint32_t)*nbBins);
+        if(nbBins == 0)
+            return;
+
+#ifdef _OPENMP
+        std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+
+        for(uint32_t t = 0; t < nbTimesteps; t++)
+        {
+            //Create a private histogram per thread. Work with this private histogram and merge at the end
+#if defined(_OPENMP)
+            #pragma omp parallel
+#endif
+            {
+                uint32_t* privateHisto = (uint32_t*)calloc(nbBins, sizeof(uint32_t));
+                auto      accumulate   = [&](size_t i)
+                {
+                    int64_t b = bin(t, i);
+                    if(b >= 0)
+                        privateHisto[b]++;
+                };
+
+                if(selection)
+                {
+                    //One chunk of the selection per iteration: empty chunks cost nothing
+#if defined(_OPENMP)
+                    #pragma omp for schedule(dynamic)
+#endif
+                    for(int64_t c = 0; c < (int64_t)selection->getNbChunks(); c++)
+                        selection->forEachRange(c*CompressedBitmask::CHUNK_BITS, MIN((c+1)*CompressedBitmask::CHUNK_BITS, nbTuples), [&](size_t begin, size_t end)
+                        {
+                            for(size_t i = begin; i < end; i++)
+                                accumulate(i);
+                        });
+                }
+                else
+                {
+#if defined(_OPENMP)
+                    #pragma omp for schedule(static)
+#endif
+                    for(int64_t i = 0; i < (int64_t)nbTuples; i++)
+                        accumulate(i);
+                }
+
+                //Merge everything
+#if defined(_OPENMP)
+                #pragma omp critical
+#endif
+                {
+                    for(uint32_t i = 0; i < nbBins; i++)
+                        output[i] += privateHisto[i];
+                }
+
+                free(privateHisto);
+            }
+        }
+    }
+
+    /** \brief  Compute the 1D histogram of a point field, see computePointField1DHistogram
+     * \param ptX the point field to evaluate
+     * \param selection the tuples to evaluate, or NULL to evaluate them all
+     * \param output the output image. Size: width
+     * \param width the number of bins */
+    static void _compute1DHistogram(const PointFieldDesc& ptX, const CompressedBitmask* selection, uint32_t* output, uint32_t width)
+    {
+        const float xDiv = ptX.maxVal - ptX.minVal;
+        _computeHistogram(ptX.values.size(), ptX.nbTuples, selection, width, output, [&](uint32_t t, size_t i) -> int64_t
+        {
+            float xVal = readPointFieldMagnitude((const uint8_t*)ptX.values[t].get(), ptX, i);
+            if(std::isnan(xVal))
+                return -1;
+            return _histogramBin(xVal, ptX.minVal, xDiv, width);
+        });
+    }
+
+    /** \brief  Compute the 2D histogram of two point fields, see computePointField2DHistogram
+     * \param ptX the point field of the X axis
+     * \param ptY the point field of the Y axis
+     * \param selection the tuples to evaluate, or NULL to evaluate them all
+     * \param output the output image. Size: width*height. X values are stored first (row-major)
+     * \param width the number of bins along the X axis
+     * \param height the number of bins along the Y axis */
+    static void _compute2DHistogram(const PointFieldDesc& ptX, const PointFieldDesc& ptY, const CompressedBitmask* selection, uint32_t* output, uint32_t width, uint32_t height)
+    {
+        if(width == 0 || height == 0)
+            return;
+
+        const float xDiv = ptX.maxVal - ptX.minVal;
+        const float yDiv = ptY.maxVal - ptY.minVal;
+        _computeHistogram(MIN(ptX.values.size(), ptY.values.size()), MIN(ptX.nbTuples, ptY.nbTuples), selection, width*height, output, [&](uint32_t t, size_t i) -> int64_t
+        {
+            float xVal = readPointFieldMagnitude((const uint8_t*)ptX.values[t].get(), ptX, i);
+            float yVal = readPointFieldMagnitude((const uint8_t*)ptY.values[t].get(), ptY, i);
+            if(std::isnan(xVal) || std::isnan(yVal))
+                return -1;
+
+            uint32_t x = _histogramBin(xVal, ptX.minVal, xDiv, width);
+            uint32_t y = _histogramBin(yVal, ptY.minVal, yDiv, height);
+            return y*width + x;
+        });
+    }
+
+    void computePointField1DHistogram(const PointFieldDesc& ptX, uint32_t* output, uint32_t width)
+    {
+        _compute1DHistogram(ptX, NULL, output, width);
+    }
+
+    void computePointField1DHistogram(const PointFieldDesc& ptX, const CompressedBitmask& selection, uint32_t* output, uint32_t width)
+    {
+        _compute1DHistogram(ptX, &selection, output, width);
+    }
+
+    void computePointField2DHistogram(const PointFieldDesc& ptX, const PointFieldDesc& ptY, uint32_t* output, uint32_t width, uint32_t height)
+    {
+        _compute2DHistogram(ptX, ptY, NULL, output, width, height);
+    }
+
+    void computePointField2DHistogram(const PointFieldDesc& ptX, const PointFieldDesc& ptY, const CompressedBitmask& selection, uint32_t* output, uint32_t width, uint32_t height)
+    {
+        _compute2DHistogram(ptX, ptY, &selection, output, width, height);
+    }
+}
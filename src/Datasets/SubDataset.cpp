@@ -12,13 +12,9 @@ namespace sereno
     {
         m_parent = parent;
 
-        //Initialize the volumetric mask
+        //Initialize the volumetric mask. An empty mask is stored compressed
         if(parent)
-        {
-            size_t nbData = sizeof(uint8_t)*(parent->getNbSpatialData()+7)/8;
-            m_volumetricMask = (uint8_t*)malloc(nbData);
-            resetVolumetricMask(false, false);
-        }
+            m_compressedVolumetricMask.resize(parent->getNbSpatialData(), false);
         setID(id);
     }
 
@@ -49,12 +45,15 @@ namespace sereno
             for(auto& it : sd.m_annotationPositions)
                 m_annotationPositions.push_back(std::shared_ptr<DrawableAnnotationPosition>(new DrawableAnnotationPosition(*it.get())));
 
-            if(m_parent)
-            {
-                size_t nbData = sizeof(uint8_t)*(m_parent->getNbSpatialData()+7)/8;
-                m_volumetricMask = (uint8_t*)malloc(nbData);
-                memcpy(m_volumetricMask, sd.m_volumetricMask, nbData);
-            }
+            m_volumetricMask             = sd.m_volumetricMask;
+            m_compressedVolumetricMask   = sd.m_compressedVolumetricMask;
+            m_isVolumetricMaskCompressed = sd.m_isVolumetricMaskCompressed;
+            m_isVolumetricMaskEdited     = false;
+            m_volumetricMaskEditBase.resize(0);
+            compactVolumetricMask();
+
+            //The recorded edits do not apply to the copied mask
+            m_volumetricMaskHistory.clear();
         }
 
         return *this;
@@ -62,8 +61,6 @@ namespace sereno
 
     SubDataset::~SubDataset()
     {
-        if(m_volumetricMask)
-            free(m_volumetricMask);
         if(m_sdGroup)
             m_sdGroup->removeSubDataset(this);
     }
@@ -95,13 +92,168 @@ namespace sereno
 
     size_t SubDataset::getVolumetricMaskSize() const 
     {
-        return sizeof(uint8_t)*(m_parent->getNbSpatialData()+7)/8;
+        return (m_isVolumetricMaskCompressed ? (m_compressedVolumetricMask.size()+7)/8 : m_volumetricMask.getNbBytes());
     }
 
     void SubDataset::resetVolumetricMask(bool t, bool enable)
     {
-        memset(m_volumetricMask, (t ? 0xff : 0x00), getVolumetricMaskSize());
+        endVolumetricMaskEdit();
+
+        //Uniform masks are always compressed
+        if(!m_isVolumetricMaskCompressed)
+        {
+            m_compressedVolumetricMask.resize(m_volumetricMask.size(), t);
+            m_volumetricMask.resize(0);
+            m_isVolumetricMaskCompressed = true;
+        }
+        else
+            m_compressedVolumetricMask.reset(t);
         m_enableVolumetricMask = enable;
+
+        //The recorded edits (XOR deltas) only apply to the mask they were computed from
+        m_volumetricMaskHistory.clear();
+    }
+
+    void SubDataset::expandVolumetricMask()
+    {
+        if(!m_isVolumetricMaskCompressed)
+            return;
+        m_compressedVolumetricMask.toBitmask(m_volumetricMask);
+        m_compressedVolumetricMask.resize(0);
+        m_isVolumetricMaskCompressed = false;
+    }
+
+    Bitmask& SubDataset::beginVolumetricMaskEdit()
+    {
+        if(!m_isVolumetricMaskEdited)
+        {
+            expandVolumetricMask();
+            m_volumetricMaskEditBase = m_volumetricMask;
+            m_isVolumetricMaskEdited = true;
+        }
+        return m_volumetricMask;
+    }
+
+    void SubDataset::endVolumetricMaskEdit(bool record)
+    {
+        if(!m_isVolumetricMaskEdited)
+            return;
+
+        if(record)
+            m_volumetricMaskHistory.push(m_volumetricMaskEditBase, m_volumetricMask);
+        else
+            m_volumetricMaskHistory.clear();
+        m_volumetricMaskEditBase.resize(0);
+        m_isVolumetricMaskEdited = false;
+        compactVolumetricMask();
+    }
+
+    void SubDataset::compactVolumetricMask()
+    {
+        if(m_isVolumetricMaskCompressed || m_isVolumetricMaskEdited)
+            return;
+
+        //Keep the dense representation if the compression does not save at least half of the memory
+        CompressedBitmask compressed(m_volumetricMask);
+        if(compressed.getMemorySize() > m_volumetricMask.getNbBytes()/2)
+            return;
+
+        m_compressedVolumetricMask   = std::move(compressed);
+        m_volumetricMask.resize(0);
+        m_isVolumetricMaskCompressed = true;
+    }
+
+    CompressedBitmask SubDataset::getCompressedVolumetricMask() const
+    {
+        if(m_isVolumetricMaskCompressed)
+            return m_compressedVolumetricMask;
+        return CompressedBitmask(m_volumetricMask);
+    }
+
+    void SubDataset::combineVolumetricMaskInto(Bitmask& target, BitmaskOp op) const
+    {
+        if(m_isVolumetricMaskCompressed)
+            m_compressedVolumetricMask.combineInto(target, op);
+        else
+            target.combine(m_volumetricMask, op);
+    }
+
+    bool SubDataset::copyVolumetricMask(const SubDataset& sd)
+    {
+        if(sd.getVolumetricMaskSize() != getVolumetricMaskSize())
+            return false;
+        endVolumetricMaskEdit();
+
+        //Compressed containers are shared: no mask data is copied
+        if(sd.m_isVolumetricMaskCompressed)
+        {
+            m_compressedVolumetricMask = sd.m_compressedVolumetricMask;
+            m_volumetricMask.resize(0);
+        }
+        else
+        {
+            m_volumetricMask = sd.m_volumetricMask;
+            m_compressedVolumetricMask.resize(0);
+        }
+        m_isVolumetricMaskCompressed = sd.m_isVolumetricMaskCompressed;
+        m_volumetricMaskHistory.clear();
+
+        //The mask of sd may be being edited
+        compactVolumetricMask();
+        return true;
+    }
+
+    void SubDataset::combineVolumetricMask(const Bitmask& mask, BitmaskOp op, bool record)
+    {
+        endVolumetricMaskEdit();
+        expandVolumetricMask();
+        if(!record)
+        {
+            m_volumetricMask.combine(mask, op);
+            m_volumetricMaskHistory.clear();
+        }
+        else
+        {
+            Bitmask before = m_volumetricMask;
+            m_volumetricMask.combine(mask, op);
+            m_volumetricMaskHistory.push(before, m_volumetricMask);
+        }
+        compactVolumetricMask();
+    }
+
+    bool SubDataset::applyVolumetricMaskDelta(const uint8_t* delta, size_t size, bool record)
+    {
+        endVolumetricMaskEdit();
+        expandVolumetricMask();
+        bool applied = VolumetricMaskHistory::applyDelta(m_volumetricMask, delta, size);
+        if(applied && record)
+            m_volumetricMaskHistory.pushDelta(std::vector<uint8_t>(delta, delta+size));
+        else if(applied)
+            m_volumetricMaskHistory.clear();
+        compactVolumetricMask();
+        return applied;
+    }
+
+    bool SubDataset::undoVolumetricMask()
+    {
+        endVolumetricMaskEdit();
+        if(!m_volumetricMaskHistory.canUndo())
+            return false;
+        expandVolumetricMask();
+        bool undone = m_volumetricMaskHistory.undo(m_volumetricMask);
+        compactVolumetricMask();
+        return undone;
+    }
+
+    bool SubDataset::redoVolumetricMask()
+    {
+        endVolumetricMaskEdit();
+        if(!m_volumetricMaskHistory.canRedo())
+            return false;
+        expandVolumetricMask();
+        bool redone = m_volumetricMaskHistory.redo(m_volumetricMask);
+        compactVolumetricMask();
+        return redone;
     }
 
     glm::mat4 SubDataset::getModelWorldMatrix() const
@@ -77,10 +77,9 @@ namespace sereno
                     else
                         it.first->setTransferFunction(nullptr);
 
-                    if(it.second->isVolumetricMaskEnabled() && it.second->getVolumetricMaskSize() == it.first->getVolumetricMaskSize())
-                    {
-                        memcpy(it.first->getVolumetricMask(), it.second->getVolumetricMask(), it.second->getVolumetricMaskSize());
-                    }
+                    //The copy clears the volumetric mask history of the subjective view
+                    if(it.second->isVolumetricMaskEnabled())
+                        it.first->copyVolumetricMask(*it.second);
                 }
             }
         }
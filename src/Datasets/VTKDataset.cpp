@@ -1,4 +1,5 @@
 #include "Datasets/VTKDataset.h"
+#include "Datasets/Histogram.h"
 #include <omp.h>
 #include <filesystem>
 
@@ -25,7 +26,7 @@ namespace sereno
         for(uint32_t j = 0; j < ptFieldValue.nbValuePerTuple; j++) 
         { 
             float readVal = readParsedVTKValue<float>(vals + x*formatSize*ptFieldValue.nbValuePerTuple + j*formatSize, ptFieldValue.format); 
-            mag = readVal*readVal; 
+            mag += readVal*readVal; 
         } 
           
         mag = sqrt(mag);
@@ -66,8 +67,6 @@ namespace sereno
     {
         if(m_readThread.joinable())
             m_readThread.join();
-        if(m_mask)
-            free(m_mask);
     }
 
     bool VTKDataset::addTimestep(std::shared_ptr<VTKParser>& parser)
@@ -125,11 +124,12 @@ namespace sereno
                     {
                         //Save some space by using 1 bit == 1 value
                         uint8_t* maskData = (uint8_t*)getParser()->parseAllFieldValues(val);
-                        m_mask = (uint8_t*)calloc((val->nbTuples+7)/8, sizeof(uint8_t));
+                        m_mask.resize(val->nbTuples, false);
+                        uint8_t* maskBytes = m_mask.data();
                         for(uint32_t i = 0, k=0; i < val->nbTuples; k++)
                             for(uint32_t j = 0; j < 8 && i < val->nbTuples; j++, i++)
                                 if(maskData[i]) 
-                                    m_mask[k] |= (1 << j);
+                                    maskBytes[k] |= (1 << j);
 
                         free(maskData);
                         break;
@@ -199,7 +199,7 @@ namespace sereno
 
                                         if(std::isnan(readVal))
                                             goto endNan;
-                                        mag = readVal*readVal;
+                                        mag += readVal*readVal;
                                     }
                                     
                                     mag = sqrt(mag);
@@ -490,108 +490,7 @@ endNan:;
             return false;
         }
 
-        //Reinitialize the image
-        for(uint32_t i=0; i < width; i++)
-            output[i] = 0;
-
-        //Constant values
-        const PointFieldDesc& ptX = m_pointFieldDescs[ptFieldXID];
-        const float xDiv = ptX.maxVal - ptX.minVal;
-        uint8_t ptXFormat = VTKValueFormatInt(ptX.format);
-
-#ifdef _OPENMP
-        std::lock_guard<std::mutex> ompLock(ompMutex);
-#endif
-
-        for(uint32_t t = 0; t < ptX.values.size(); t++)
-        {
-#if defined(_OPENMP)
-            uint32_t* privateHisto = nullptr;
-#pragma omp parallel private(privateHisto)
-            {
-                //Initialize a private histogram
-                privateHisto = (uint32_t*)malloc(sizeof(uint32_t)*width);
-                for(uint32_t i=0; i<width; i++) 
-                    privateHisto[i] = 0;
-
-                //Check conditions OUTSIDE for loop for optimization issue
-                if(ptX.nbValuePerTuple == 1)
-                {
-                    #pragma omp for
-                    for(uint32_t i = 0; i < ptX.nbTuples; i++)
-                    {
-                        float xVal = readParsedVTKValue<float>((uint8_t*)ptX.values[t].get() + i*ptXFormat, ptX.format);
-                        if(std::isnan(xVal))
-                            continue;
-                        float pos = (xVal-ptX.minVal)/xDiv;
-                        uint32_t x = MIN(width*pos, width-1);
-                        privateHisto[x]++;
-                    }
-                } 
-
-                else
-                {
-                    #pragma omp for
-                    for(uint32_t i=0; i<ptX.nbTuples; i++) 
-                    {
-                        float xVal = 0.0;
-                        for(uint32_t k = 0; k < ptX.nbValuePerTuple; k++)
-                        {
-                            float val = readParsedVTKValue<float>((uint8_t*)ptX.values[t].get() + i*ptXFormat*ptX.nbValuePerTuple + k*ptXFormat, ptX.format);
-                            xVal = val*val;
-                        }
-                        if(std::isnan(xVal))
-                            continue;
-                        xVal = sqrt(xVal);
-
-                        uint32_t x = MIN(width*(xVal-ptX.minVal)/xDiv, width-1);
-                        privateHisto[x]++;
-                    }
-                }
-
-                //Merge everything
-                #pragma omp critical 
-                {
-                    for(uint32_t i=0; i<width; i++) 
-                        output[i] += privateHisto[i];
-                }
-
-                free(privateHisto);
-            }
-#else
-            //Check conditions OUTSIDE for loop for optimization issue
-            if(ptX.nbValuePerTuple == 1)
-            {
-                for(uint32_t i = 0; i < ptX.nbTuples; i++)
-                {
-                    float xVal = readParsedVTKValue<float>((uint8_t*)ptX.values[t].get() + i*ptXFormat, ptX.format);
-                    if(std::isnan(xVal))
-                        continue;
-                    uint32_t x = MIN(width*(xVal-ptX.minVal)/xDiv, width-1);
-                    output[x]++;
-                }
-            } 
-
-            else
-            {
-                for(uint32_t i=0; i<ptX.nbTuples; i++) 
-                {
-                    float xVal = 0.0;
-                    for(uint32_t k = 0; k < ptX.nbValuePerTuple; k++)
-                    {
-                        float val = readParsedVTKValue<float>((uint8_t*)ptX.values[t].get() + i*ptXFormat*ptX.nbValuePerTuple + k*ptXFormat, ptX.format);
-                        xVal = val*val;
-                    }
-                    if(std::isnan(xVal))
-                        continue;
-                    xVal = sqrt(xVal);
-
-                    uint32_t x = MIN(width*(xVal-ptX.minVal)/xDiv, width-1);
-                    output[x]++;
-                }
-            }
-#endif
-        }
+        computePointField1DHistogram(m_pointFieldDescs[ptFieldXID], output, width);
         return true;
     }
 
@@ -604,237 +503,7 @@ endNan:;
             return false;
         }
 
-        //Reinitialize the image
-        memset(output, 0x00, sizeof(uint32_t)*width*height);
-
-        //Fetch common values
-        const PointFieldDesc& ptX = m_pointFieldDescs[ptFieldXID];
-        const PointFieldDesc& ptY = m_pointFieldDescs[ptFieldYID];
-
-        const float xDiv = ptX.maxVal - ptX.minVal;
-        const float yDiv = ptY.maxVal - ptY.minVal;
-
-        const int ptXFormat = VTKValueFormatInt(ptX.format);
-        const int ptYFormat = VTKValueFormatInt(ptY.format);
-
-        for(uint32_t t = 0; t < ptX.values.size() && t < ptY.values.size(); t++)
-        {
-            //Create a private histogram per thread. Work with this private histogram and merge at the end
-#ifdef _OPENMP
-#pragma omp parallel
-            {
-                //Initialize a private histogram
-                uint32_t* privateHisto = (uint32_t*)malloc(sizeof(uint32_t)*width*height);
-                memset(privateHisto, 0x00, sizeof(uint32_t)*width*height);
-
-                //Make conditions OUTSIDE of the for loops for optimization issue
-                //ptX.nbTuples == ptY.nbTuples
-                if(ptX.nbValuePerTuple == 1 && ptY.nbValuePerTuple == 1)
-                {
-                    #pragma omp for
-                    for(uint32_t i = 0; i < ptX.nbTuples; i++)
-                    {
-                        float xVal = readParsedVTKValue<float>((uint8_t*)ptX.values[t].get() + i*ptXFormat, ptX.format);
-                        if(std::isnan(xVal))
-                            continue;
-                        uint32_t x = MIN(width*(xVal-ptX.minVal)/xDiv, width-1);
-
-                        float yVal = readParsedVTKValue<float>((uint8_t*)ptY.values[t].get() + i*ptYFormat, ptY.format);
-                        if(std::isnan(yVal))
-                            continue;
-                        uint32_t y = MIN(height*(yVal-ptY.minVal)/yDiv, height-1);
-
-                        privateHisto[y*width + x]+=1;
-                    }
-                }
-
-                else if(ptX.nbValuePerTuple == 1 && ptY.nbTuples > 1)
-                {
-                    #pragma omp for
-                    for(uint32_t i = 0; i < ptX.nbValuePerTuple; i++)
-                    {
-                        float xVal = readParsedVTKValue<float>((uint8_t*)ptX.values[t].get() + i*ptXFormat, ptX.format);
-                        if(std::isnan(xVal))
-                            continue;
-                        uint32_t x = MIN(width*(xVal-ptX.minVal)/xDiv, width-1);
-
-                        //Take the magnitude
-                        float yVal = 0.0;
-                        for(uint32_t k = 0; k < ptY.nbValuePerTuple; k++)
-                        {
-                            float val = readParsedVTKValue<float>((uint8_t*)ptY.values[t].get() + i*ptYFormat*ptY.nbValuePerTuple + k*ptYFormat, ptY.format);
-                            yVal = val*val;
-                        }
-                        if(std::isnan(yVal))
-                            continue;
-                        uint32_t y = MIN(height*(sqrt(yVal) - ptY.minVal)/yDiv, height-1);
-
-                        privateHisto[y*width + x]++;
-                    }
-                }
-
-                else if(ptX.nbValuePerTuple > 1 && ptY.nbValuePerTuple == 1)
-                {
-                    #pragma omp for
-                    for(uint32_t i=0; i<ptX.nbTuples; i++) 
-                    {
-                        float xVal = 0.0;
-                        for(uint32_t k = 0; k < ptX.nbValuePerTuple; k++)
-                        {
-                            float val = readParsedVTKValue<float>((uint8_t*)ptX.values[t].get() + i*ptXFormat*ptX.nbValuePerTuple + k*ptXFormat, ptX.format);
-                            xVal = val*val;
-                        }
-                        if(std::isnan(xVal))
-                            continue;
-                        xVal = sqrt(xVal);
-
-                        float yVal = readParsedVTKValue<float>((uint8_t*)ptY.values[t].get() + i*ptYFormat, ptY.format);
-                        if(std::isnan(yVal))
-                            continue;
-                        uint32_t x = MIN((xVal - ptX.minVal)/xDiv, width-1);
-                        uint32_t y = MIN((yVal - ptY.minVal)/yDiv, height-1);
-                        privateHisto[y*width + x]++;
-                    }
-                }
-
-                else
-                {
-                    #pragma omp for
-                    for(uint32_t i=0; i<ptX.nbTuples; i++) 
-                    {
-                        float xVal = 0.0;
-                        for(uint32_t k = 0; k < ptX.nbValuePerTuple; k++)
-                        {
-                            float val = readParsedVTKValue<float>((uint8_t*)ptX.values[t].get() + i*ptXFormat*ptX.nbValuePerTuple + k*ptXFormat, ptX.format);
-                            xVal = val*val;
-                        }
-                        if(std::isnan(xVal))
-                            continue;
-                        xVal = sqrt(xVal);
-
-                        float yVal = 0.0;
-                        for(uint32_t k = 0; k < ptY.nbValuePerTuple; k++)
-                        {
-                            float val = readParsedVTKValue<float>((uint8_t*)ptY.values[t].get() + i*ptYFormat*ptY.nbValuePerTuple + k*ptYFormat, ptY.format);
-                            yVal = val*val;
-                        }
-                        if(std::isnan(yVal))
-                            continue;
-                        yVal = sqrt(yVal);
-
-                        uint32_t x = MIN((xVal - ptX.minVal)/xDiv, width-1);
-                        uint32_t y = MIN((yVal - ptY.minVal)/yDiv, height-1);
-                        privateHisto[y*width + x]++;
-                    }
-                }
-
-                //Merge everything
-                #pragma omp critical 
-                {
-                    for(uint32_t i=0; i<width*height; i++) 
-                        output[i] += privateHisto[i];
-                }
-
-                free(privateHisto);
-            }
-#else
-            //Make conditions OUTSIDE of the for loops
-            if(ptX.nbValuePerTuple == 1 && ptY.nbValuePerTuple == 1)
-            {
-                for(uint32_t i = 0; i < ptX.nbTuples; i++)
-                {
-                    float xVal = readParsedVTKValue<float>((uint8_t*)ptX.values[t].get() + i*ptXFormat, ptX.format);
-                    if(std::isnan(xVal))
-                        continue;
-                    uint32_t x = MIN(width*(xVal-ptX.minVal)/xDiv, width-1);
-
-                    float yVal = readParsedVTKValue<float>((uint8_t*)ptY.values[t].get() + i*ptYFormat, ptY.format);
-                    if(std::isnan(yVal))
-                        continue;
-                    uint32_t y = MIN(height*(yVal-ptY.minVal)/yDiv, height-1);
-
-                    output[y*width + x]++;
-                }
-            }
-
-            else if(ptX.nbValuePerTuple == 1 && ptY.nbTuples > 1)
-            {
-                for(uint32_t i = 0; i < ptX.nbValuePerTuple; i++)
-                {
-                    float xVal = readParsedVTKValue<float>((uint8_t*)ptX.values[t].get() + i*ptXFormat, ptX.format);
-                    if(std::isnan(xVal))
-                        continue;
-                    uint32_t x = MIN(width*(xVal-ptX.minVal)/xDiv, width-1);
-
-                    //Take the magnitude
-                    float yVal = 0.0;
-                    for(uint32_t k = 0; k < ptY.nbValuePerTuple; k++)
-                    {
-                        float val = readParsedVTKValue<float>((uint8_t*)ptY.values[t].get() + i*ptYFormat*ptY.nbValuePerTuple + k*ptYFormat, ptY.format);
-                        yVal = val*val;
-                    }
-                    if(std::isnan(yVal))
-                        continue;
-                    uint32_t y = MIN(height*(sqrt(yVal) - ptY.minVal)/yDiv, height-1);
-
-                    output[y*width + x]++;
-                }
-            }
-
-            else if(ptX.nbValuePerTuple > 1 && ptY.nbValuePerTuple == 1)
-            {
-                for(uint32_t i=0; i<ptX.nbTuples; i++) 
-                {
-                    float xVal = 0.0;
-                    for(uint32_t k = 0; k < ptX.nbValuePerTuple; k++)
-                    {
-                        float val = readParsedVTKValue<float>((uint8_t*)ptX.values[t].get() + i*ptXFormat*ptX.nbValuePerTuple + k*ptXFormat, ptX.format);
-                        xVal = val*val;
-                    }
-                    if(std::isnan(xVal))
-                        continue;
-                    xVal = sqrt(xVal);
-
-                    float yVal = readParsedVTKValue<float>((uint8_t*)ptY.values[t].get() + i*ptYFormat, ptY.format);
-                    if(std::isnan(yVal))
-                        continue;
-                    uint32_t x = MIN((xVal - ptX.minVal)/xDiv, width-1);
-                    uint32_t y = MIN((yVal - ptY.minVal)/yDiv, height-1);
-                    output[y*width + x]++;
-                }
-            }
-
-            else
-            {
-                for(uint32_t i=0; i<ptX.nbTuples; i++) 
-                {
-                    float xVal = 0.0;
-                    for(uint32_t k = 0; k < ptX.nbValuePerTuple; k++)
-                    {
-                        float val = readParsedVTKValue<float>((uint8_t*)ptX.values[t].get() + i*ptXFormat*ptX.nbValuePerTuple + k*ptXFormat, ptX.format);
-                        xVal = val*val;
-                    }
-                    if(std::isnan(xVal))
-                        continue;
-                    xVal = sqrt(xVal);
-
-                    float yVal = 0.0;
-                    for(uint32_t k = 0; k < ptY.nbValuePerTuple; k++)
-                    {
-                        float val = readParsedVTKValue<float>((uint8_t*)ptY.values[t].get() + i*ptYFormat*ptY.nbValuePerTuple + k*ptYFormat, ptY.format);
-                        yVal = val*val;
-                    }
-                    if(std::isnan(yVal))
-                        continue;
-                    yVal = sqrt(yVal);
-
-                    uint32_t x = MIN((xVal - ptX.minVal)/xDiv, width-1);
-                    uint32_t y = MIN((yVal - ptY.minVal)/yDiv, height-1);
-                    output[y*width + x]++;
-                }
-            }
-#endif
-        }
+        computePointField2DHistogram(m_pointFieldDescs[ptFieldXID], m_pointFieldDescs[ptFieldYID], output, width, height);
         return true;
     }
 }
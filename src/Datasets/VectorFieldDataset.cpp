@@ -1,14 +1,72 @@
 #include "Datasets/VectorFieldDataset.h"
+#include "Datasets/Histogram.h"
 #include "sciVisUtils.h"
+#include "MappedFile.h"
+#include <cmath>
+#include <filesystem>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef MIN
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#endif
+
+#ifndef MAX
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+#endif
 
 using namespace serenoSciVis;
 
 namespace sereno
 {
+    /* \brief Compute the rotation quaternion of a velocity (see VectorFieldDataset::getRotationQuaternion)
+     * \param vel the velocity (x, y, z)
+     * \return the rotation quaternion. The null velocity gives the identity */
+    static inline Quaternionf _velocityToQuaternion(const float* vel)
+    {
+        float amp = sqrt(vel[0]*vel[0] + vel[1]*vel[1] + vel[2]*vel[2]);
+        if(amp == 0.0f)
+            return Quaternionf();
+
+        float pitch = atan2(vel[1], vel[0]);
+        float roll  = asin(MAX(-1.0f, MIN(1.0f, vel[2]/amp)));
+        return Quaternionf(pitch, roll, 0);
+    }
+
+    /* \brief Apply a function on every cell of a strided sub-grid, in parallel
+     * \param size the grid size
+     * \param stride the stride between two cells of the sub-grid
+     * \param func the function to call per cell: func(size_t subGridID, size_t gridID, uint32_t x, uint32_t y, uint32_t z) */
+    template <typename Func>
+    static void _forEachStridedCell(const uint32_t* size, uint32_t stride, const Func& func)
+    {
+        uint32_t subSize[3];
+        for(uint8_t i = 0; i < 3; i++)
+            subSize[i] = (size[i] + stride - 1)/stride;
+
+#ifdef _OPENMP
+        std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(static)
+#endif
+        for(int64_t s = 0; s < (int64_t)subSize[1]*subSize[2]; s++)
+        {
+            uint32_t y = (s % subSize[1])*stride;
+            uint32_t z = (s / subSize[1])*stride;
+            size_t   subGridID = s*subSize[0];
+            size_t   gridID    = (size_t)size[0]*(y + (size_t)size[1]*z);
+            for(uint32_t x = 0; x < size[0]; x+=stride, subGridID++)
+                func(subGridID, gridID + x, x, y, z);
+        }
+    }
+
     VectorFieldDataset::VectorFieldDataset(FILE* file, const std::string& name) : Dataset()
     {
-#define BUFFER_SIZE 3*sizeof(float)*270
-        uint8_t buffer[BUFFER_SIZE];
+        uint8_t buffer[3*sizeof(uint32_t)];
 
         //Read widthxheightxdepth
         uint32_t readSize = fread(buffer, sizeof(uint8_t), 3*sizeof(uint32_t), file);
@@ -18,46 +76,64 @@ namespace sereno
             m_size[i] = uint8ToUint32(buffer+sizeof(uint32_t)*i);
 
         //Check and get the data size
-        uint32_t pos = ftell(file);
+        long pos = ftell(file);
         fseek(file, 0, SEEK_END);
-        uint32_t fileSize = ftell(file);
-        if(fileSize-pos != m_size[0]*m_size[1]*m_size[2]*3*sizeof(float))
+        uint64_t fileSize = ftell(file);
+        uint64_t dataSize = 3*sizeof(float)*(uint64_t)nbCells();
+        if(fileSize-pos != dataSize)
         {
             ERROR << "the current file may be broken\n";
             return;
         }
         fseek(file, pos, SEEK_SET);
-        m_velocity = (float*)malloc(3*sizeof(float*)*m_size[0]*m_size[1]*m_size[2]);
 
-        //read data
-        //We do not precompute magnitude or so because of memory issue. We prefer using CPU time instead of RAM
-        //However we store the ampltitude range
-        uint32_t velID = 0;
-        float amplitude[2] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::min()};
-        do
+        //Read everything at once, then convert in parallel
+        uint8_t* data = (uint8_t*)malloc(dataSize);
+        if(data == NULL || fread(data, sizeof(uint8_t), dataSize, file) != dataSize)
         {
-            readSize = fread(buffer, sizeof(uint8_t), BUFFER_SIZE, file);
-            for(uint32_t j = 0; j < readSize; j+=sizeof(float)*3, velID+=3)
-            {
-                float amp = 0.0;
-                for(uint32_t k = 0; k < 3; k++)
-                {
-                    m_velocity[velID+k] = uint8ToFloat(buffer+j+k*sizeof(float));
-                    amp += m_velocity[velID+k]*m_velocity[velID+k];
-                }
+            ERROR << "Could not read the velocities\n";
+            free(data);
+            return;
+        }
 
-                //Update the amplitude. We store the square of the amplitude for better performances (the square root is done only at the end)
-                if(amp < amplitude[0])
-                    amplitude[0] = amp;
-                else if(amp > amplitude[1])
-                    amplitude[1] = amp;
-            }
-        }while(readSize != 0);
+        initPointFieldDesc();
+        m_valuesLoaded = setRawVelocities(data);
+        free(data);
+    }
 
-        //Save the amplitude
-        for(int i = 0; i < 2; i++)
-            m_amplitude[i] = sqrt(amplitude[i]);
-#undef BUFFER_SIZE
+    VectorFieldDataset::VectorFieldDataset(const std::string& path) : Dataset(), m_filePath(path)
+    {
+        uint8_t buffer[3*sizeof(uint32_t)];
+
+        std::error_code err;
+        uint64_t fileSize = std::filesystem::file_size(path, err);
+        FILE*    file     = (err ? NULL : fopen(path.c_str(), "rb"));
+        if(file == NULL)
+        {
+            ERROR << "Could not open the file " << path << ". Abort\n";
+            return;
+        }
+
+        //Read widthxheightxdepth
+        bool succeed = (fread(buffer, sizeof(uint8_t), 3*sizeof(uint32_t), file) == 3*sizeof(uint32_t));
+        fclose(file);
+        if(!succeed)
+        {
+            ERROR << "Could not read the file " << path << ". Abort\n";
+            return;
+        }
+        for(uint8_t i = 0; i < 3; i++)
+            m_size[i] = uint8ToUint32(buffer+sizeof(uint32_t)*i);
+
+        if(fileSize - 3*sizeof(uint32_t) != 3*sizeof(float)*(uint64_t)nbCells())
+        {
+            ERROR << "the current file may be broken\n";
+            for(uint8_t i = 0; i < 3; i++)
+                m_size[i] = 0;
+            return;
+        }
+
+        initPointFieldDesc();
     }
 
     VectorFieldDataset::VectorFieldDataset(const VectorFieldDataset& copy) : Dataset(copy)
@@ -69,8 +145,19 @@ namespace sereno
     {
         for(uint8_t i = 0; i < 3; i++)
             m_size[i] = mvt.m_size[i];
-        m_velocity = mvt.m_velocity;
-        mvt.m_velocity = NULL;
+        for(uint8_t i = 0; i < 2; i++)
+            m_amplitude[i] = mvt.m_amplitude[i];
+        m_pointFieldDescs = std::move(mvt.m_pointFieldDescs);
+        m_valuesLoaded    = mvt.m_valuesLoaded;
+        m_filePath        = mvt.m_filePath;
+        m_velocity        = mvt.m_velocity;
+        m_rotations       = std::move(mvt.m_rotations);
+        m_rotationStride  = mvt.m_rotationStride;
+        m_directions      = std::move(mvt.m_directions);
+        m_directionStride = mvt.m_directionStride;
+        mvt.m_velocity        = NULL;
+        mvt.m_rotationStride  = 0;
+        mvt.m_directionStride = 0;
     }
 
     VectorFieldDataset& VectorFieldDataset::operator=(const VectorFieldDataset& copy)
@@ -78,24 +165,33 @@ namespace sereno
         if(this == &copy)
             return *this;
 
+        //The velocities are read-only once loaded: share them
         for(uint8_t i = 0; i < 3; i++)
             m_size[i] = copy.m_size[i];
-        uint32_t s = sizeof(float*)*m_size[0]*m_size[1]*m_size[2];
-        m_velocity = (float*)malloc(s);
-        memcpy(m_velocity, copy.m_velocity,s);
+        for(uint8_t i = 0; i < 2; i++)
+            m_amplitude[i] = copy.m_amplitude[i];
+        m_pointFieldDescs = copy.m_pointFieldDescs;
+        m_valuesLoaded    = copy.m_valuesLoaded;
+        m_filePath        = copy.m_filePath;
+        m_velocity        = copy.m_velocity;
+        m_rotations       = copy.m_rotations;
+        m_rotationStride  = copy.m_rotationStride;
+        m_directions      = copy.m_directions;
+        m_directionStride = copy.m_directionStride;
         return *this;
     }
 
     VectorFieldDataset::~VectorFieldDataset()
     {
-        if(m_velocity)
-            free(m_velocity);
+        //m_velocity is owned by the "velocity" point field
+        if(m_readThread.joinable())
+            m_readThread.join();
     }
 
     VectorFieldDataset* VectorFieldDataset::readFromFilePath(const std::string& path)
     {
         //Open and check the file
-        FILE* file = fopen(path.c_str(), "r");
+        FILE* file = fopen(path.c_str(), "rb");
         if(file == NULL)
             return NULL;
 
@@ -106,7 +202,7 @@ namespace sereno
         VectorFieldDataset* data = new VectorFieldDataset(file, filename);
 
         //Check if the data is valid or not
-        if(!data->getSubDataset(0)->isValid())
+        if(!data->areValuesLoaded())
         {
             delete data;
             data = NULL;
@@ -116,14 +212,199 @@ namespace sereno
         return data;
     }
 
+    void VectorFieldDataset::initPointFieldDesc()
+    {
+        m_pointFieldDescs.resize(1);
+        m_pointFieldDescs[0].id              = 0;
+        m_pointFieldDescs[0].minVal          = m_pointFieldDescs[0].maxVal = 0.0f;
+        m_pointFieldDescs[0].format          = VTK_FLOAT;
+        m_pointFieldDescs[0].nbTuples        = nbCells();
+        m_pointFieldDescs[0].nbValuePerTuple = 3;
+        m_pointFieldDescs[0].name            = "velocity";
+    }
+
+    bool VectorFieldDataset::setRawVelocities(const uint8_t* data)
+    {
+        const size_t nbValues = 3*(size_t)nbCells();
+        float* velocity = (float*)malloc(sizeof(float)*nbValues);
+        if(velocity == NULL)
+        {
+            ERROR << "Could not allocate the memory to load " << nbCells() << " cells\n";
+            return false;
+        }
+
+        //We do not precompute magnitude or so because of memory issue. We prefer using CPU time instead of RAM
+        //However we store the ampltitude range. We store the square of the amplitude for better performances (the square root is done only at the end)
+        float minAmp = std::numeric_limits<float>::max();
+        float maxAmp = 0.0f;
+        {
+#ifdef _OPENMP
+            std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+            const size_t  CHUNK_SIZE = 1 << 16; //In cells
+            const int64_t nbChunks   = (nbCells() + CHUNK_SIZE - 1)/CHUNK_SIZE;
+
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(static) reduction(min:minAmp) reduction(max:maxAmp)
+#endif
+            for(int64_t c = 0; c < nbChunks; c++)
+            {
+                size_t begin = c*CHUNK_SIZE;
+                size_t end   = MIN(begin+CHUNK_SIZE, (size_t)nbCells());
+
+                bigEndianToFloats(velocity + 3*begin, data + 3*sizeof(float)*begin, 3*(end-begin));
+                for(size_t i = begin; i < end; i++)
+                {
+                    float amp = velocity[3*i]*velocity[3*i] + velocity[3*i+1]*velocity[3*i+1] + velocity[3*i+2]*velocity[3*i+2];
+                    minAmp = MIN(minAmp, amp);
+                    maxAmp = MAX(maxAmp, amp);
+                }
+            }
+        }
+
+        //Save the amplitude
+        m_amplitude[0] = (nbCells() ? sqrt(minAmp) : 0.0f);
+        m_amplitude[1] = sqrt(maxAmp);
+
+        m_velocity = velocity;
+        m_rotationStride  = 0;
+        m_directionStride = 0;
+        m_pointFieldDescs[0].minVal = m_amplitude[0];
+        m_pointFieldDescs[0].maxVal = m_amplitude[1];
+        m_pointFieldDescs[0].values.emplace_back(velocity, _FreeDeleter());
+        return true;
+    }
+
+    std::thread* VectorFieldDataset::loadValues(LoadCallback clbk, void* userData)
+    {
+        //Already loaded (FILE* constructor) or invalid file
+        if(m_valuesLoaded || m_filePath.size() == 0 || m_pointFieldDescs.size() == 0)
+        {
+            if(clbk)
+                clbk(this, m_valuesLoaded, userData);
+            return NULL;
+        }
+
+        if(m_readThreadRunning == false)
+        {
+            m_readThreadRunning = true;
+            m_readThread = std::thread([this, clbk, userData]()
+            {
+                MappedFile file(m_filePath);
+                bool succeed = file.isOpen() && file.getSize() >= 3*sizeof(uint32_t) + 3*sizeof(float)*(uint64_t)nbCells() &&
+                               setRawVelocities(file.getData() + 3*sizeof(uint32_t));
+
+                m_valuesLoaded = succeed;
+                if(clbk)
+                    clbk(this, succeed, userData);
+                m_readThreadRunning = false;
+            });
+
+            return &m_readThread;
+        }
+        return NULL;
+    }
+
+    bool VectorFieldDataset::create1DHistogram(uint32_t* output, uint32_t width, uint32_t ptFieldXID) const
+    {
+        //Check property
+        if(ptFieldXID >= m_pointFieldDescs.size() || !m_valuesLoaded)
+        {
+            ERROR << "Point Field X could not be found." << std::endl;
+            return false;
+        }
+
+        computePointField1DHistogram(m_pointFieldDescs[ptFieldXID], output, width);
+        return true;
+    }
+
     Quaternionf VectorFieldDataset::getRotationQuaternion(uint32_t x, uint32_t y, uint32_t z) const
     {
-        uint32_t ind = x + m_size[0]*y + m_size[0]*m_size[1]*z;
-        float vel[3] = {m_velocity[3*ind], m_velocity[3*ind+1], m_velocity[3*ind+2]};
-        float pitch  = atan2(vel[1], vel[0]);
-        float roll   = asin(vel[2]);
+        size_t ind = x + m_size[0]*y + (size_t)m_size[0]*m_size[1]*z;
+        return _velocityToQuaternion(m_velocity + 3*ind);
+    }
 
-        return Quaternionf(pitch, roll, 0);
+    void VectorFieldDataset::getStridedGridSize(uint32_t stride, uint32_t* size) const
+    {
+        stride = MAX(stride, 1u);
+        for(uint8_t i = 0; i < 3; i++)
+            size[i] = (m_size[i] + stride - 1)/stride;
+    }
+
+    const Quaternionf* VectorFieldDataset::getRotationQuaternions(uint32_t stride)
+    {
+        if(m_velocity == NULL || !m_valuesLoaded)
+            return NULL;
+
+        stride = MAX(stride, 1u);
+        if(m_rotationStride != stride)
+        {
+            uint32_t subSize[3];
+            getStridedGridSize(stride, subSize);
+            m_rotations.resize((size_t)subSize[0]*subSize[1]*subSize[2]);
+
+            _forEachStridedCell(m_size, stride, [this](size_t subGridID, size_t gridID, uint32_t, uint32_t, uint32_t)
+            {
+                m_rotations[subGridID] = _velocityToQuaternion(m_velocity + 3*gridID);
+            });
+            m_rotationStride = stride;
+        }
+
+        return m_rotations.data();
+    }
+
+    const uint32_t* VectorFieldDataset::getOctahedralDirections(uint32_t stride)
+    {
+        if(m_velocity == NULL || !m_valuesLoaded)
+            return NULL;
+
+        stride = MAX(stride, 1u);
+        if(m_directionStride != stride)
+        {
+            uint32_t subSize[3];
+            getStridedGridSize(stride, subSize);
+            m_directions.resize((size_t)subSize[0]*subSize[1]*subSize[2]);
+
+            _forEachStridedCell(m_size, stride, [this](size_t subGridID, size_t gridID, uint32_t, uint32_t, uint32_t)
+            {
+                m_directions[subGridID] = octahedralEncode(m_velocity + 3*gridID);
+            });
+            m_directionStride = stride;
+        }
+
+        return m_directions.data();
+    }
+
+    bool VectorFieldDataset::computeGlyphs(uint32_t stride, float minAmplitude, std::vector<VectorFieldGlyph>& output) const
+    {
+        output.clear();
+        if(m_velocity == NULL || !m_valuesLoaded)
+            return false;
+
+        stride = MAX(stride, 1u);
+        uint32_t subSize[3];
+        getStridedGridSize(stride, subSize);
+
+        //One list per sub-grid row, concatenated afterward to keep the grid order
+        std::vector<std::vector<VectorFieldGlyph>> rows((size_t)subSize[1]*subSize[2]);
+        const float minAmplitude2 = (minAmplitude > 0.0f ? minAmplitude*minAmplitude : 0.0f);
+
+        _forEachStridedCell(m_size, stride, [&](size_t subGridID, size_t gridID, uint32_t x, uint32_t y, uint32_t z)
+        {
+            const float* vel  = m_velocity + 3*gridID;
+            float        amp2 = vel[0]*vel[0] + vel[1]*vel[1] + vel[2]*vel[2];
+            if(amp2 >= minAmplitude2)
+                rows[subGridID/subSize[0]].push_back({x, y, z, std::sqrt(amp2), _velocityToQuaternion(vel)});
+        });
+
+        size_t nbGlyphs = 0;
+        for(const auto& row : rows)
+            nbGlyphs += row.size();
+        output.reserve(nbGlyphs);
+        for(const auto& row : rows)
+            output.insert(output.end(), row.begin(), row.end());
+
+        return true;
     }
 
 }
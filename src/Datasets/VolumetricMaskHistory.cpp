@@ -0,0 +1,257 @@
+#include "Datasets/VolumetricMaskHistory.h"
+#include <utility>
+
+namespace sereno
+{
+    /** \brief  The run types of an encoded delta */
+    enum DeltaRunType
+    {
+        DELTA_RUN_ZERO    = 0, //Bytes not modified
+        DELTA_RUN_FULL    = 1, //Bytes whose bits are all flipped
+        DELTA_RUN_LITERAL = 2  //Bytes stored as is
+    };
+
+    /** \brief  Literal runs are interrupted only by zero/full runs at least this long, so that short runs do not cost more than they save */
+    #define DELTA_MIN_RUN 3
+
+    /** \brief  Append an unsigned LEB128 varint
+     * \param v the value to write
+     * \param output[out] the buffer to append to */
+    static inline void _writeVarint(uint64_t v, std::vector<uint8_t>& output)
+    {
+        while(v >= 0x80)
+        {
+            output.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        output.push_back((uint8_t)v);
+    }
+
+    /** \brief  Read an unsigned LEB128 varint
+     * \param data the buffer to read
+     * \param size the size of data
+     * \param offset[in, out] the reading offset, advanced past the varint
+     * \param v[out] the value read
+     * \return   false if the buffer ends before the varint, true otherwise */
+    static inline bool _readVarint(const uint8_t* data, size_t size, size_t& offset, uint64_t& v)
+    {
+        v = 0;
+        for(uint32_t shift = 0; offset < size && shift < 64; shift += 7)
+        {
+            uint8_t b = data[offset++];
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if(!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    VolumetricMaskHistory::VolumetricMaskHistory(size_t maxMemory) : m_maxMemory(maxMemory)
+    {}
+
+    bool VolumetricMaskHistory::encodeDelta(const Bitmask& before, const Bitmask& after, std::vector<uint8_t>& output)
+    {
+        output.clear();
+        if(before.size() != after.size())
+            return false;
+
+        const uint8_t*  b0      = before.data();
+        const uint8_t*  b1      = after.data();
+        const uint64_t* w0      = before.getWords();
+        const uint64_t* w1      = after.getWords();
+        const size_t    nbBytes = before.getNbBytes();
+
+        //Length of the run of XOR bytes equal to "value" starting at i. Unmodified words are skipped at once
+        auto runLength = [&](size_t i, uint8_t value)
+        {
+            size_t j = i;
+            while(j < nbBytes)
+            {
+                if(j % sizeof(uint64_t) == 0 && j + sizeof(uint64_t) <= nbBytes)
+                {
+                    uint64_t x = w0[j/sizeof(uint64_t)] ^ w1[j/sizeof(uint64_t)];
+                    if(x == (value ? ~(uint64_t)0 : 0))
+                    {
+                        j += sizeof(uint64_t);
+                        continue;
+                    }
+                }
+                if((uint8_t)(b0[j] ^ b1[j]) != value)
+                    break;
+                j++;
+            }
+            return j - i;
+        };
+
+        _writeVarint(before.size(), output);
+
+        size_t i = 0;
+        while(i < nbBytes)
+        {
+            uint8_t d = b0[i] ^ b1[i];
+            if(d == 0x00 || d == 0xff)
+            {
+                size_t len = runLength(i, d);
+                _writeVarint((len << 2) | (d ? DELTA_RUN_FULL : DELTA_RUN_ZERO), output);
+                i += len;
+                continue;
+            }
+
+            //Literal run: stops at the first zero/full run long enough to be worth a header
+            size_t end = i+1;
+            while(end < nbBytes)
+            {
+                uint8_t e = b0[end] ^ b1[end];
+                if((e == 0x00 || e == 0xff) && runLength(end, e) >= DELTA_MIN_RUN)
+                    break;
+                end++;
+            }
+
+            _writeVarint(((end-i) << 2) | DELTA_RUN_LITERAL, output);
+            for(; i < end; i++)
+                output.push_back(b0[i] ^ b1[i]);
+        }
+
+        return true;
+    }
+
+    bool VolumetricMaskHistory::applyDelta(Bitmask& mask, const uint8_t* delta, size_t size)
+    {
+        //First pass: validation, so that a malformed delta leaves the mask untouched
+        size_t   offset = 0;
+        uint64_t nbBits;
+        if(!_readVarint(delta, size, offset, nbBits) || nbBits != mask.size())
+            return false;
+
+        const size_t dataOffset = offset;
+        size_t       nbBytes    = 0;
+        while(offset < size)
+        {
+            uint64_t header;
+            if(!_readVarint(delta, size, offset, header))
+                return false;
+            uint64_t len = header >> 2;
+            uint8_t  type = header & 0x03;
+            if(type > DELTA_RUN_LITERAL || len > mask.getNbBytes() - nbBytes)
+                return false;
+            if(type == DELTA_RUN_LITERAL)
+            {
+                if(len > size - offset)
+                    return false;
+                offset += len;
+            }
+            nbBytes += len;
+        }
+        if(nbBytes != mask.getNbBytes())
+            return false;
+
+        //Second pass: XOR the runs
+        uint8_t* bytes = mask.data();
+        size_t   b     = 0;
+        offset = dataOffset;
+        while(offset < size)
+        {
+            uint64_t header;
+            _readVarint(delta, size, offset, header);
+            size_t len = header >> 2;
+            switch(header & 0x03)
+            {
+                case DELTA_RUN_FULL:
+                    for(size_t i = 0; i < len; i++)
+                        bytes[b+i] ^= 0xff;
+                    break;
+                case DELTA_RUN_LITERAL:
+                    for(size_t i = 0; i < len; i++)
+                        bytes[b+i] ^= delta[offset+i];
+                    offset += len;
+                    break;
+                default:
+                    break;
+            }
+            b += len;
+        }
+
+        //Full runs may have flipped the padding bits of the last byte
+        if(mask.size() % 8)
+            bytes[mask.getNbBytes()-1] &= (1 << (mask.size()%8)) - 1;
+        return true;
+    }
+
+    bool VolumetricMaskHistory::push(const Bitmask& before, const Bitmask& after)
+    {
+        std::vector<uint8_t> delta;
+        if(!encodeDelta(before, after, delta))
+            return false;
+
+        //Only the header and zero runs: nothing changed
+        bool modified = false;
+        size_t offset = 0;
+        uint64_t v;
+        _readVarint(delta.data(), delta.size(), offset, v);
+        while(offset < delta.size() && !modified)
+        {
+            _readVarint(delta.data(), delta.size(), offset, v);
+            modified = (v & 0x03) != DELTA_RUN_ZERO;
+        }
+        if(!modified)
+            return false;
+
+        pushDelta(std::move(delta));
+        return true;
+    }
+
+    void VolumetricMaskHistory::pushDelta(std::vector<uint8_t>&& delta)
+    {
+        //Discard the undone edits
+        for(size_t i = m_current; i < m_deltas.size(); i++)
+            m_memorySize -= m_deltas[i].size();
+        m_deltas.resize(m_current);
+
+        m_memorySize += delta.size();
+        m_deltas.push_back(std::move(delta));
+        m_current++;
+        trim();
+    }
+
+    bool VolumetricMaskHistory::undo(Bitmask& mask)
+    {
+        if(!canUndo())
+            return false;
+        const std::vector<uint8_t>& delta = m_deltas[m_current-1];
+        if(!applyDelta(mask, delta.data(), delta.size()))
+            return false;
+        m_current--;
+        return true;
+    }
+
+    bool VolumetricMaskHistory::redo(Bitmask& mask)
+    {
+        if(!canRedo())
+            return false;
+        const std::vector<uint8_t>& delta = m_deltas[m_current];
+        if(!applyDelta(mask, delta.data(), delta.size()))
+            return false;
+        m_current++;
+        return true;
+    }
+
+    void VolumetricMaskHistory::clear()
+    {
+        m_deltas.clear();
+        m_current    = 0;
+        m_memorySize = 0;
+    }
+
+    void VolumetricMaskHistory::trim()
+    {
+        size_t nbRemoved = 0;
+        while(m_memorySize > m_maxMemory && m_deltas.size() - nbRemoved > 1 && nbRemoved < m_current)
+            m_memorySize -= m_deltas[nbRemoved++].size();
+
+        if(nbRemoved)
+        {
+            m_deltas.erase(m_deltas.begin(), m_deltas.begin() + nbRemoved);
+            m_current -= nbRemoved;
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#include "MappedFile.h"
+#include "sciVisUtils.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <filesystem>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPEDFILE_USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifndef MIN
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#endif
+
+namespace sereno
+{
+    MappedFile::MappedFile(const std::string& path)
+    {
+#ifdef MAPPEDFILE_USE_MMAP
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            ERROR << "Could not open the file " << path << std::endl;
+            return;
+        }
+
+        struct stat fileStat;
+        if(fstat(fd, &fileStat) < 0)
+        {
+            ERROR << "Could not get the size of the file " << path << std::endl;
+            close(fd);
+            return;
+        }
+
+        m_size   = fileStat.st_size;
+        m_isOpen = true;
+        if(m_size == 0)
+        {
+            close(fd);
+            return;
+        }
+
+        void* data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(data != MAP_FAILED)
+        {
+            //We mostly read datasets from the beginning to the end
+            madvise(data, m_size, MADV_SEQUENTIAL);
+            m_data     = (uint8_t*)data;
+            m_isMapped = true;
+            return;
+        }
+        WARNING << "Could not memory-map the file " << path << ". Reading it instead\n";
+#endif
+
+        //Fallback: read the whole file using large blocks
+        //std::filesystem::file_size is 64 bits everywhere, contrary to ftell (32 bits on Windows)
+        std::error_code err;
+        uint64_t fileSize = std::filesystem::file_size(path, err);
+        if(err)
+        {
+            ERROR << "Could not get the size of the file " << path << std::endl;
+            m_isOpen = false;
+            return;
+        }
+
+        FILE* file = fopen(path.c_str(), "rb");
+        if(file == NULL)
+        {
+            ERROR << "Could not open the file " << path << std::endl;
+            m_isOpen = false;
+            return;
+        }
+
+        m_size   = fileSize;
+        m_isOpen = true;
+        if(m_size == 0)
+        {
+            fclose(file);
+            return;
+        }
+
+        m_data = (uint8_t*)malloc(m_size);
+        if(m_data == NULL)
+        {
+            ERROR << "Could not allocate " << m_size << " bytes to read the file " << path << std::endl;
+            m_isOpen = false;
+            m_size   = 0;
+            fclose(file);
+            return;
+        }
+
+        const uint64_t BLOCK_SIZE = 16*1024*1024;
+        for(uint64_t offset = 0; offset < m_size;)
+        {
+            size_t readSize = fread(m_data+offset, sizeof(uint8_t), MIN(BLOCK_SIZE, m_size-offset), file);
+            if(readSize == 0)
+            {
+                ERROR << "Could not read the whole file " << path << std::endl;
+                free(m_data);
+                m_data   = NULL;
+                m_size   = 0;
+                m_isOpen = false;
+                break;
+            }
+            offset += readSize;
+        }
+        fclose(file);
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if(m_data == NULL)
+            return;
+#ifdef MAPPEDFILE_USE_MMAP
+        if(m_isMapped)
+        {
+            munmap(m_data, m_size);
+            return;
+        }
+#endif
+        free(m_data);
+    }
+}
@@ -0,0 +1,242 @@
+#include "SciVis/Streamlines.h"
+#include "sciVisUtils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef MIN
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#endif
+
+#ifndef MAX
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+#endif
+
+namespace sereno
+{
+    /** \brief  Dormand-Prince 5(4) coefficients (J.R. Dormand and P.J. Prince, "A family of embedded Runge-Kutta formulae", 1980) */
+    static const float DP_A[6][6] = {{1.0f/5.0f},
+                                     {3.0f/40.0f,       9.0f/40.0f},
+                                     {44.0f/45.0f,      -56.0f/15.0f,      32.0f/9.0f},
+                                     {19372.0f/6561.0f, -25360.0f/2187.0f, 64448.0f/6561.0f, -212.0f/729.0f},
+                                     {9017.0f/3168.0f,  -355.0f/33.0f,     46732.0f/5247.0f, 49.0f/176.0f,  -5103.0f/18656.0f},
+                                     {35.0f/384.0f,     0.0f,              500.0f/1113.0f,   125.0f/192.0f, -2187.0f/6784.0f,  11.0f/84.0f}};
+    static const float DP_B5[7] = {35.0f/384.0f,     0.0f, 500.0f/1113.0f,   125.0f/192.0f, -2187.0f/6784.0f,    11.0f/84.0f,    0.0f};
+    static const float DP_B4[7] = {5179.0f/57600.0f, 0.0f, 7571.0f/16695.0f, 393.0f/640.0f, -92097.0f/339200.0f, 187.0f/2100.0f, 1.0f/40.0f};
+
+    /** \brief  Linear interpolation between two vectors
+     * \param a the vector at t == 0
+     * \param b the vector at t == 1
+     * \param t the interpolation factor
+     * \return   a + t*(b-a) */
+    static inline glm::vec3 _lerp(const glm::vec3& a, const glm::vec3& b, float t)
+    {
+        return a + t*(b-a);
+    }
+
+    bool sampleVelocity(const VectorFieldDataset& vf, const glm::vec3& pos, glm::vec3& vel)
+    {
+        const uint32_t* size     = vf.getGridSize();
+        const float*    velocity = vf.getVelocity();
+
+        //Per axis: the two surrounding cells and the interpolation factor
+        size_t i0[3], i1[3];
+        float  t[3];
+        for(uint8_t k = 0; k < 3; k++)
+        {
+            if(!(pos[k] >= 0.0f && pos[k] <= size[k]-1.0f))
+                return false;
+            i0[k] = MIN((size_t)pos[k], (size_t)MAX(size[k], 2u)-2);
+            i1[k] = MIN(i0[k]+1, (size_t)size[k]-1);
+            t[k]  = pos[k] - i0[k];
+        }
+
+        const size_t strideY = size[0];
+        const size_t strideZ = (size_t)size[0]*size[1];
+        auto cell = [&](size_t x, size_t y, size_t z)
+        {
+            const float* v = velocity + 3*(x + y*strideY + z*strideZ);
+            return glm::vec3(v[0], v[1], v[2]);
+        };
+
+        glm::vec3 c00 = _lerp(cell(i0[0], i0[1], i0[2]), cell(i1[0], i0[1], i0[2]), t[0]);
+        glm::vec3 c10 = _lerp(cell(i0[0], i1[1], i0[2]), cell(i1[0], i1[1], i0[2]), t[0]);
+        glm::vec3 c01 = _lerp(cell(i0[0], i0[1], i1[2]), cell(i1[0], i0[1], i1[2]), t[0]);
+        glm::vec3 c11 = _lerp(cell(i0[0], i1[1], i1[2]), cell(i1[0], i1[1], i1[2]), t[0]);
+        vel = _lerp(_lerp(c00, c10, t[1]), _lerp(c01, c11, t[1]), t[2]);
+        return true;
+    }
+
+    /** \brief  Integrate a streamline in one direction
+     * \param vf the loaded vector field
+     * \param seed the starting position, inside the grid
+     * \param params the integration parameters
+     * \param direction 1.0f to integrate forward, -1.0f to integrate backward
+     * \param output[out] the vertices (the seed excluded) are appended to this array */
+    static void _integrate(const VectorFieldDataset& vf, const glm::vec3& seed, const StreamlineParameters& params, float direction, std::vector<glm::vec3>& output)
+    {
+        glm::vec3 pos    = seed;
+        float     h      = params.stepSize;
+        float     length = 0.0f;
+
+        for(uint32_t step = 0; step < params.maxSteps && length < params.maxLength; step++)
+        {
+            glm::vec3 k[7];
+            if(!sampleVelocity(vf, pos, k[0]) || glm::length(k[0]) < params.minVelocity)
+                return;
+            k[0] *= direction;
+
+            glm::vec3 next;
+            if(params.integrator == STREAMLINE_RK4)
+            {
+                if(!sampleVelocity(vf, pos + 0.5f*h*k[0], k[1]))
+                    return;
+                k[1] *= direction;
+                if(!sampleVelocity(vf, pos + 0.5f*h*k[1], k[2]))
+                    return;
+                k[2] *= direction;
+                if(!sampleVelocity(vf, pos + h*k[2], k[3]))
+                    return;
+                k[3] *= direction;
+                next = pos + h/6.0f*(k[0] + 2.0f*k[1] + 2.0f*k[2] + k[3]);
+            }
+            else
+            {
+                //Retry with smaller steps until the error is acceptable
+                while(true)
+                {
+                    bool inside = true;
+                    for(uint8_t s = 0; s < 6 && inside; s++)
+                    {
+                        glm::vec3 p = pos;
+                        for(uint8_t j = 0; j <= s; j++)
+                            p += h*DP_A[s][j]*k[j];
+                        inside = sampleVelocity(vf, p, k[s+1]);
+                        if(inside)
+                            k[s+1] *= direction;
+                    }
+
+                    glm::vec3 y5 = pos, y4 = pos;
+                    if(inside)
+                    {
+                        for(uint8_t j = 0; j < 7; j++)
+                        {
+                            y5 += h*DP_B5[j]*k[j];
+                            y4 += h*DP_B4[j]*k[j];
+                        }
+                    }
+
+                    //Leaving the grid: shrink the step to get closer to the border
+                    float err = (inside ? glm::length(y5 - y4) : std::numeric_limits<float>::infinity());
+                    if(err <= params.tolerance || h <= params.minStepSize)
+                    {
+                        if(!inside)
+                            return;
+                        next = y5;
+                        float factor = (err > 0.0f ? 0.9f*std::pow(params.tolerance/err, 0.2f) : 5.0f);
+                        h = MIN(params.maxStepSize, h*MIN(5.0f, MAX(0.2f, factor)));
+                        break;
+                    }
+                    h = MAX(params.minStepSize, h*(inside ? MAX(0.2f, 0.9f*std::pow(params.tolerance/err, 0.25f)) : 0.5f));
+                }
+            }
+
+            length += glm::length(next - pos);
+            pos     = next;
+            output.push_back(pos);
+        }
+    }
+
+    bool computeStreamlines(const VectorFieldDataset& vf, const glm::vec3* seeds, size_t nbSeeds, const StreamlineParameters& params, Streamlines& output)
+    {
+        output.vertices.clear();
+        output.offsets.clear();
+        if(!vf.areValuesLoaded() || vf.getVelocity() == NULL)
+            return false;
+
+        const size_t batchSize = MAX(params.seedBatchSize, 1u);
+        const size_t nbBatches = (nbSeeds + batchSize - 1)/batchSize;
+
+        //Each batch is traced in its own buffer, then all the buffers are gathered in one allocation
+        std::vector<std::vector<glm::vec3>> batchVertices(nbBatches);
+        output.offsets.resize(nbSeeds+1, 0);
+
+        {
+#ifdef _OPENMP
+            std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(dynamic)
+#endif
+            for(int64_t b = 0; b < (int64_t)nbBatches; b++)
+            {
+                std::vector<glm::vec3>& vertices = batchVertices[b];
+                std::vector<glm::vec3>  backward;
+                for(size_t i = b*batchSize; i < MIN((b+1)*batchSize, nbSeeds); i++)
+                {
+                    size_t    lineBegin = vertices.size();
+                    glm::vec3 vel;
+                    if(sampleVelocity(vf, seeds[i], vel))
+                    {
+                        if(params.bothDirections)
+                        {
+                            backward.clear();
+                            _integrate(vf, seeds[i], params, -1.0f, backward);
+                            vertices.insert(vertices.end(), backward.rbegin(), backward.rend());
+                        }
+                        vertices.push_back(seeds[i]);
+                        _integrate(vf, seeds[i], params, 1.0f, vertices);
+                    }
+
+                    //Store the line size for now. Turned into offsets once every batch is done
+                    output.offsets[i+1] = vertices.size() - lineBegin;
+                }
+            }
+
+            for(size_t i = 0; i < nbSeeds; i++)
+                output.offsets[i+1] += output.offsets[i];
+            output.vertices.resize(output.offsets[nbSeeds]);
+
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(static)
+#endif
+            for(int64_t b = 0; b < (int64_t)nbBatches; b++)
+                if(batchVertices[b].size())
+                    memcpy(output.vertices.data() + output.offsets[b*batchSize], batchVertices[b].data(), batchVertices[b].size()*sizeof(glm::vec3));
+        }
+
+        return true;
+    }
+
+    void seedsFromLine(const glm::vec3& p0, const glm::vec3& p1, uint32_t nbSeeds, std::vector<glm::vec3>& output)
+    {
+        if(nbSeeds == 1)
+        {
+            output.push_back(0.5f*(p0+p1));
+            return;
+        }
+
+        output.reserve(output.size() + nbSeeds);
+        for(uint32_t i = 0; i < nbSeeds; i++)
+            output.push_back(_lerp(p0, p1, i/(float)(nbSeeds-1)));
+    }
+
+    void seedsFromVolumetricMask(const SubDataset& sd, uint32_t stride, std::vector<glm::vec3>& output)
+    {
+        const VectorFieldDataset* vf   = (const VectorFieldDataset*)sd.getParent();
+        const uint32_t*           size = vf->getGridSize();
+        const bool                useMask = sd.isVolumetricMaskEnabled();
+
+        stride = MAX(stride, 1u);
+        for(uint32_t z = 0; z < size[2]; z+=stride)
+            for(uint32_t y = 0; y < size[1]; y+=stride)
+                for(uint32_t x = 0; x < size[0]; x+=stride)
+                    if(!useMask || sd.getVolumetricMaskAt(x + size[0]*(y + size[1]*z)))
+                        output.push_back(glm::vec3(x, y, z));
+    }
+}
@@ -1,5 +1,7 @@
 #include "SciVis/computeVisualization.h"
 #include "Datasets/VTKDataset.h"
+#include "Datasets/CloudPointDataset.h"
+#include "Datasets/Histogram.h"
 #include "SciVisColor.h"
 #include "writeData.h"
 #include <filesystem>
@@ -7,126 +9,233 @@
 #include <omp.h>
 #include <limits>
 #include <cstdlib>
+#include <cstring>
 
 namespace sereno
 {
-    uint8_t* getVTKStructuredGridColorArray(SubDataset* sd, uint32_t* sizeOutput)
-    {
-        std::shared_ptr<TF>        tf      = sd->getTransferFunction();
-        VTKDataset*                dataset = (VTKDataset*)sd->getParent();
-        std::shared_ptr<VTKParser> parser  = dataset->getParser();
+    /** \brief  The number of data points the color kernel handles per batch */
+    static const size_t COLOR_BATCH_SIZE = 4096;
 
-        if(parser->getDatasetType() != VTK_STRUCTURED_POINTS)
-        {
-            ERROR << "The SubDataset is not a VTK_STRUCTURED_POINTS. Returning..." << std::endl;
-            return nullptr;
-        }
+    /** \brief  The transfer function state shared by the batch color kernel, computed once per SubDataset */
+    struct TFColorContext
+    {
+        std::shared_ptr<TF>                tf;                  /*!< The transfer function to apply*/
+        const std::vector<PointFieldDesc>* ptFieldDescs = NULL; /*!< The point field descriptors of the dataset*/
+        DatasetGradient*                   grad         = NULL; /*!< The gradient of the enabled point fields, if any*/
+        uint32_t                           t1           = 0;    /*!< The first timestep to interpolate*/
+        uint32_t                           t2           = 0;    /*!< The second timestep to interpolate*/
+        float                              tFrac        = 0.0f; /*!< The interpolation factor between t1 and t2*/
+    };
 
-        const VTKStructuredPoints&         ptsDesc      = parser->getStructuredPointsDescriptor();
-        const std::vector<PointFieldDesc>& ptFieldDescs = dataset->getPointFieldDescs();
+    /** \brief  Initialize the transfer function state of a SubDataset
+     * \param sd the SubDataset to evaluate
+     * \param ctx[out] the context to initialize
+     * \return   true if the SubDataset has a valid transfer function, false otherwise */
+    static bool initTFColorContext(SubDataset* sd, TFColorContext& ctx)
+    {
+        Dataset* dataset  = sd->getParent();
+        ctx.tf            = sd->getTransferFunction();
+        ctx.ptFieldDescs  = &dataset->getPointFieldDescs();
 
-        if(!tf || tf->getDimension() - tf->hasGradient() > ptFieldDescs.size())
+        if(!ctx.tf || ctx.tf->getDimension() - ctx.tf->hasGradient() > ctx.ptFieldDescs->size())
         {
             ERROR << "The SubDataset does not contain a valid Transfer function. Returning..." << std::endl;
-            return nullptr;
+            return false;
         }
 
-        //The RGBA data variables (nb values and array of colors)
-        size_t   nbValues  = ptsDesc.size[0] * ptsDesc.size[1] * ptsDesc.size[2];
-        uint8_t* cols      = (uint8_t*)malloc(sizeof(uint8_t)*nbValues*4);
-
         //Check for the indice enabled
         std::vector<uint32_t> indices;
-        for(uint32_t h = 0; h < tf->getDimension() - tf->hasGradient(); h++)
-            if(tf->getEnabledDimensions()[h])
-                indices.push_back(ptFieldDescs[h].id);
+        for(uint32_t h = 0; h < ctx.tf->getDimension() - ctx.tf->hasGradient(); h++)
+            if(ctx.tf->getEnabledDimensions()[h])
+                indices.push_back((*ctx.ptFieldDescs)[h].id);
 
         //Get the associated gradient
-        DatasetGradient* grad = dataset->getOrComputeGradient(indices);
+        if(ctx.tf->hasGradient())
+            ctx.grad = dataset->getOrComputeGradient(indices);
 
-        float    t  = tf->getCurrentTimestep();
-        uint32_t t1 = std::min((uint32_t)floor(t), dataset->getNbTimesteps());
-        uint32_t t2 = std::min((uint32_t)ceil (t), dataset->getNbTimesteps());
+        float    t      = ctx.tf->getCurrentTimestep();
+        uint32_t lastT  = std::max(dataset->getNbTimesteps(), 1u) - 1;
+        ctx.t1          = std::min((uint32_t)floor(t), lastT);
+        ctx.t2          = std::min((uint32_t)ceil (t), lastT);
+        ctx.tFrac       = t - floor(t);
+        return true;
+    }
 
-        //Use the transfer function to generate the 3D texture
-        #pragma omp parallel
+    /** \brief  Compute the colors of a batch of data points with the transfer function of a SubDataset
+     * @tparam Visible the type of visible
+     * \param ctx the transfer function state (see initTFColorContext)
+     * \param ids the data point IDs to evaluate. If NULL, the data points evaluated are [firstID, firstID+count[
+     * \param firstID the first data point ID to evaluate if ids == NULL
+     * \param count the number of data points to evaluate
+     * \param visible function telling whether a data point ID is visible. Invisible data points are transparent black
+     * \param scratch working memory. Size: 2*ctx.tf->getDimension() floats
+     * \param cols[out] the RGBA colors. Size: 4*count */
+    template <typename Visible>
+    static void computeTFColorBatch(const TFColorContext& ctx, const uint32_t* ids, size_t firstID, size_t count, const Visible& visible, float* scratch, uint8_t* cols)
+    {
+        const TF*                          tf           = ctx.tf.get();
+        const std::vector<PointFieldDesc>& ptFieldDescs = *ctx.ptFieldDescs;
+        const uint32_t                     nbFields     = tf->getDimension() - tf->hasGradient();
+
+        float* tfIndT1 = scratch;                      //The indice of the transfer function for the first timestep
+        float* tfIndT2 = scratch + tf->getDimension(); //The indice of the transfer function for the second timestep
+        struct {float* tfInd; uint32_t t;} tfInds[] = {{tfIndT1, ctx.t1}, {tfIndT2, ctx.t2}};
+
+        for(size_t i = 0; i < count; i++)
         {
-            float* tfIndT1 = (float*)malloc(2*tf->getDimension()*sizeof(float)); //The indice of the transfer function for the first timestep
-            float* tfIndT2 = tfIndT1 + tf->getDimension(); //The indice of the transfer function for the second timestep. DO NOT FREE
+            size_t   destID = (ids ? ids[i] : firstID+i);
+            uint8_t* col    = cols + 4*i;
 
-            struct {float* tfInd; uint32_t t;} tfInds[] = {{tfIndT1, t1}, {tfIndT2, t2}};
+            if(!visible(destID))
+            {
+                for(uint8_t h = 0; h < 4; h++)
+                    col[h] = 0;
+                continue;
+            }
 
-            #pragma omp for schedule(static)
-            //For all values in the grid
-            for(uint32_t k = 0; k < ptsDesc.size[2]; k++)
+            for(const auto& tfInd : tfInds)
             {
-                for(uint32_t j = 0; j < ptsDesc.size[1]; j++)
+                //For each parameter (e.g., temperature, presure, etc.)
+                for(uint32_t h = 0; h < nbFields; h++)
                 {
-                    for(uint32_t i = 0; i < ptsDesc.size[0]; i++)
+                    if(tf->getEnabledDimensions()[h])
                     {
-                        size_t destID = i+
-                                        j*ptsDesc.size[0]+
-                                        k*ptsDesc.size[0]*ptsDesc.size[1];
-
-                        if(!dataset->getMask(destID) ||
-                           (sd->isVolumetricMaskEnabled() && !sd->getVolumetricMaskAt(destID)))
-                        {
-                            for(uint8_t h = 0; h < 3; h++)
-                                cols[4*destID+h] = 0;
-                            cols[4*destID+3] = 0;
-                            continue;
-                        }
-
-                        for(const auto& tfInd : tfInds)
-                        {
-                            //For each parameter (e.g., temperature, presure, etc.)
-                            for(uint32_t h = 0; h < tf->getDimension() - tf->hasGradient(); h++)
-                            {
-                                if(tf->getEnabledDimensions()[h])
-                                {
-                                    const PointFieldDesc& val            = ptFieldDescs[h];
-                                    uint8_t               valueFormatInt = VTKValueFormatInt(val.format);
-
-                                    //Compute the vector magnitude
-                                    float mag = 0;
-                                    for(uint32_t l = 0; l < val.nbValuePerTuple; l++)
-                                    {
-                                        float readVal = readParsedVTKValue<float>((uint8_t*)(val.values[tfInd.t].get()) + destID*valueFormatInt*val.nbValuePerTuple + l*valueFormatInt, val.format);
-                                        mag = readVal*readVal;
-                                    }
-                                    mag = sqrt(mag);
-
-                                    //Save it at the correct indice in the TF indice (clamped into [0,1])
-                                    tfInd.tfInd[h] = (mag-val.minVal)/(val.maxVal-val.minVal);
-                                }
-                                else
-                                    tfInd.tfInd[h] = 0;
-                            }
-
-                            //Do not forget the gradient (clamped)!
-                            if(tf->hasGradient())
-                            {
-                                if(grad)
-                                    tfInd.tfInd[tf->getDimension()-1] = grad->grads[0].get()[destID];
-                                else
-                                    tfInd.tfInd[tf->getDimension()-1] = 0;
-                            }
-                        }
-
-                        //Apply the transfer function
-                        double intPart;
-                        uint8_t outColT1[4];
-                        tf->computeColor(tfIndT1, outColT1);
-                        uint8_t outColT2[4];
-                        tf->computeColor(tfIndT2, outColT2);
-                        for(uint8_t h = 0; h < 3; h++)
-                            cols[4*destID+h] = ((float)outColT1[h] * (1.0f-modf(t, &intPart)) + (float)outColT2[h] * modf(t, &intPart));
-                        cols[4*destID+3] = tf->computeAlpha(tfIndT1);
+                        //Read the value (or the vector magnitude)
+                        const PointFieldDesc& val = ptFieldDescs[h];
+                        float mag = readPointFieldMagnitude((const uint8_t*)val.values[tfInd.t].get(), val, destID);
+
+                        //Save it at the correct indice in the TF indice (clamped into [0,1])
+                        tfInd.tfInd[h] = (mag-val.minVal)/(val.maxVal-val.minVal);
                     }
+                    else
+                        tfInd.tfInd[h] = 0;
+                }
+
+                //Do not forget the gradient (clamped)!
+                if(tf->hasGradient())
+                {
+                    if(ctx.grad)
+                        tfInd.tfInd[tf->getDimension()-1] = ctx.grad->grads[0].get()[destID];
+                    else
+                        tfInd.tfInd[tf->getDimension()-1] = 0;
                 }
             }
-            free(tfIndT1);
+
+            //Apply the transfer function
+            uint8_t outColT1[4];
+            tf->computeColor(tfIndT1, outColT1);
+            uint8_t outColT2[4];
+            tf->computeColor(tfIndT2, outColT2);
+            for(uint8_t h = 0; h < 3; h++)
+                col[h] = ((float)outColT1[h] * (1.0f-ctx.tFrac) + (float)outColT2[h] * ctx.tFrac);
+            col[3] = tf->computeAlpha(tfIndT1);
         }
+    }
+
+    /** \brief  Compute the colors of the data points [begin, begin+count[ with the transfer function of a SubDataset
+     * @tparam Mask the type of visibility: Bitmask or CompressedBitmask
+     * \param ctx the transfer function state (see initTFColorContext)
+     * \param visibility the visible data points, or NULL if all are visible. Batches without any visible data point are filled at once
+     * \param begin the first data point ID to evaluate
+     * \param count the number of data points to evaluate
+     * \param scratch working memory. Size: 2*ctx.tf->getDimension() floats
+     * \param cols[out] the RGBA colors. Size: 4*count */
+    template <typename Mask>
+    static void computeTFColorRange(const TFColorContext& ctx, const Mask* visibility, size_t begin, size_t count, float* scratch, uint8_t* cols)
+    {
+        if(visibility == NULL)
+            computeTFColorBatch(ctx, NULL, begin, count, [](size_t) {return true;}, scratch, cols);
+        else if(visibility->findNext(begin, begin+count) >= begin+count)
+            memset(cols, 0, 4*count);
+        else
+            computeTFColorBatch(ctx, NULL, begin, count, [visibility](size_t destID) {return visibility->get(destID);}, scratch, cols);
+    }
+
+    /** \brief  Compute the colors of the data points [0, nbValues[ with the transfer function of a SubDataset, in parallel batches
+     * @tparam Mask the type of visibility: Bitmask or CompressedBitmask
+     * \param ctx the transfer function state (see initTFColorContext)
+     * \param visibility the visible data points, or NULL if all are visible
+     * \param nbValues the number of data points
+     * \param cols[out] the RGBA colors. Size: 4*nbValues */
+    template <typename Mask>
+    static void computeTFColors(const TFColorContext& ctx, const Mask* visibility, size_t nbValues, uint8_t* cols)
+    {
+#ifdef _OPENMP
+        std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+
+#if defined(_OPENMP)
+        #pragma omp parallel
+#endif
+        {
+            float* scratch = (float*)malloc(2*ctx.tf->getDimension()*sizeof(float));
+
+#if defined(_OPENMP)
+            #pragma omp for schedule(static)
+#endif
+            for(int64_t b = 0; b < (int64_t)((nbValues + COLOR_BATCH_SIZE - 1)/COLOR_BATCH_SIZE); b++)
+            {
+                size_t begin = b*COLOR_BATCH_SIZE;
+                computeTFColorRange(ctx, visibility, begin, std::min(COLOR_BATCH_SIZE, nbValues - begin), scratch, cols + 4*begin);
+            }
+            free(scratch);
+        }
+    }
+
+    /** \brief  Compute the colors of the data points [0, nbValues[ with the transfer function of a SubDataset, hiding the data points outside its volumetric mask (if enabled).
+     * A compressed volumetric mask is used as is
+     * \param ctx the transfer function state (see initTFColorContext)
+     * \param sd the SubDataset
+     * \param nbValues the number of data points
+     * \param cols[out] the RGBA colors. Size: 4*nbValues */
+    static void computeTFColors(const TFColorContext& ctx, const SubDataset* sd, size_t nbValues, uint8_t* cols)
+    {
+        if(!sd->isVolumetricMaskEnabled())
+            computeTFColors(ctx, (const Bitmask*)NULL, nbValues, cols);
+        else if(sd->isVolumetricMaskCompressed())
+        {
+            CompressedBitmask visibility = sd->getCompressedVolumetricMask();
+            computeTFColors(ctx, &visibility, nbValues, cols);
+        }
+        else
+        {
+            Bitmask visibility(nbValues, true);
+            sd->combineVolumetricMaskInto(visibility, BITMASK_OP_AND);
+            computeTFColors(ctx, &visibility, nbValues, cols);
+        }
+    }
+
+    uint8_t* getVTKStructuredGridColorArray(SubDataset* sd, uint32_t* sizeOutput)
+    {
+        VTKDataset*                dataset = (VTKDataset*)sd->getParent();
+        std::shared_ptr<VTKParser> parser  = dataset->getParser();
+
+        if(parser->getDatasetType() != VTK_STRUCTURED_POINTS)
+        {
+            ERROR << "The SubDataset is not a VTK_STRUCTURED_POINTS. Returning..." << std::endl;
+            return nullptr;
+        }
+
+        TFColorContext ctx;
+        if(!initTFColorContext(sd, ctx))
+            return nullptr;
+
+        const VTKStructuredPoints& ptsDesc = parser->getStructuredPointsDescriptor();
+
+        //The RGBA data variables (nb values and array of colors)
+        const size_t nbValues = (size_t)ptsDesc.size[0] * ptsDesc.size[1] * ptsDesc.size[2];
+        uint8_t*     cols     = (uint8_t*)malloc(sizeof(uint8_t)*nbValues*4);
+
+        //Combine the dataset and the volumetric masks once
+        if(dataset->hasMaskComputed())
+        {
+            Bitmask visibility = *dataset->getMaskBitmask();
+            if(sd->isVolumetricMaskEnabled())
+                sd->combineVolumetricMaskInto(visibility, BITMASK_OP_AND);
+            computeTFColors(ctx, &visibility, nbValues, cols);
+        }
+        else
+            computeTFColors(ctx, sd, nbValues, cols);
 
         if(sizeOutput)
             for(uint8_t i = 0; i < 3; i++)
@@ -134,6 +243,27 @@ namespace sereno
         return cols;
     }
 
+    uint8_t* getCloudPointColorArray(SubDataset* sd)
+    {
+        CloudPointDataset* dataset = (CloudPointDataset*)sd->getParent();
+        if(!dataset->areValuesLoaded())
+        {
+            ERROR << "The cloud point is not loaded yet. Returning..." << std::endl;
+            return nullptr;
+        }
+
+        TFColorContext ctx;
+        if(!initTFColorContext(sd, ctx))
+            return nullptr;
+
+        const size_t nbPoints = dataset->getNbPoints();
+        uint8_t*     cols     = (uint8_t*)malloc(sizeof(uint8_t)*nbPoints*4);
+
+        computeTFColors(ctx, sd, nbPoints, cols);
+
+        return cols;
+    }
+
     bool createDirectories(const std::string& path)
     {
         std::filesystem::path p(path);
@@ -151,43 +281,155 @@ namespace sereno
         }
 
         //Compute the color
-        uint32_t size[3];
-        size_t   totalSize = sizeof(uint32_t)*(size[0] * size[1] * size[2]);
-        uint8_t* color = getVTKStructuredGridColorArray(sd, size);
-        
+        uint32_t size[3] = {0, 0, 0};
+        uint8_t* color   = getVTKStructuredGridColorArray(sd, size);
+        if(color == nullptr)
+            return false;
+
         //Create the file
         FILE* file = fopen(path.c_str(), "wb");
-
-        //Buffer + save size
-        const size_t BUFFER_SIZE = 4096;
-        uint8_t  data[BUFFER_SIZE];
-        uint16_t offset = 0;
-        writeUint32(data,                      size[0]);
-        writeUint32(data +   sizeof(uint32_t), size[1]);
-        writeUint32(data + 2*sizeof(uint32_t), size[2]);
-        offset = 3*sizeof(uint32_t);
-
-        //Store data and save in batches
-        for(size_t i = 0; i < totalSize;)
+        if(file == NULL)
         {
-            for(; offset < BUFFER_SIZE && i < totalSize; offset += sizeof(uint32_t), i+= sizeof(uint32_t))
-                writeUint32(data+offset, color[i]);
-            fwrite(data, offset, 1, file);
-            offset = 0;
+            ERROR << "Could not open the file " << path << std::endl;
+            free(color);
+            return false;
         }
 
+        //Save the size, then the colors (one uint8_t per component)
+        uint8_t header[3*sizeof(uint32_t)];
+        for(uint8_t i = 0; i < 3; i++)
+            writeUint32(header + i*sizeof(uint32_t), size[i]);
+
+        const size_t totalSize = 4*(size_t)size[0]*size[1]*size[2];
+        bool succeed = (fwrite(header, sizeof(header), 1, file) == 1) &&
+                       (fwrite(color, sizeof(uint8_t), totalSize, file) == totalSize);
+        if(!succeed)
+            ERROR << "Could not write the file " << path << std::endl;
+
         fclose(file);
-        return true;
+        free(color);
+        return succeed;
     }
 
-    bool saveCloudPointVisual(SubDataset* sd, const std::string& path)
+    bool saveCloudPointVisual(SubDataset* sd, const std::string& path, bool onlySelected)
     {
+        CloudPointDataset* dataset = (CloudPointDataset*)sd->getParent();
+        if(!dataset->areValuesLoaded())
+        {
+            ERROR << "The cloud point is not loaded yet. Returning..." << std::endl;
+            return false;
+        }
+
+        TFColorContext ctx;
+        if(!initTFColorContext(sd, ctx))
+            return false;
+
         if(!createDirectories(path))
         {
             ERROR << "Could not create the directories required to create the file " << path << std::endl;
             return false;
         }
 
-        return true;
+        FILE* file = fopen(path.c_str(), "wb");
+        if(file == NULL)
+        {
+            ERROR << "Could not open the file " << path << std::endl;
+            return false;
+        }
+
+        const float*    positions   = dataset->getPointPositions();
+        const uint32_t  nbPoints    = dataset->getNbPoints();
+        const uint32_t* originalIDs = dataset->getPointOriginalIDs();
+        const bool      useMask     = sd->isVolumetricMaskEnabled();
+
+        //The points to write, in the file order of the dataset
+        std::vector<uint32_t> ids;
+        {
+#ifdef _OPENMP
+            std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+            std::vector<uint32_t> currentIDs(nbPoints);
+#if defined(_OPENMP)
+            #pragma omp parallel for schedule(static)
+#endif
+            for(int64_t i = 0; i < (int64_t)nbPoints; i++)
+                currentIDs[(originalIDs ? originalIDs[i] : i)] = i;
+
+            if(onlySelected && useMask)
+            {
+                ids.reserve(sd->countVolumetricMask());
+                for(uint32_t i = 0; i < nbPoints; i++)
+                    if(sd->getVolumetricMaskAt(currentIDs[i]))
+                        ids.push_back(currentIDs[i]);
+            }
+            else
+                ids = std::move(currentIDs);
+        }
+
+        //Write per chunk of points. Each chunk is converted in parallel, then streamed to the disk
+        const size_t CHUNK_SIZE = 1 << 18;
+        uint8_t*     buffer     = (uint8_t*)malloc(CHUNK_SIZE*3*sizeof(float));
+        bool         succeed    = (buffer != NULL);
+
+        uint8_t header[sizeof(uint32_t)];
+        writeUint32(header, ids.size());
+        succeed = succeed && fwrite(header, sizeof(header), 1, file) == 1;
+
+        //Positions
+        for(size_t c = 0; c < ids.size() && succeed; c += CHUNK_SIZE)
+        {
+            size_t count = std::min(CHUNK_SIZE, ids.size() - c);
+            {
+#ifdef _OPENMP
+                std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+#if defined(_OPENMP)
+                #pragma omp parallel for schedule(static)
+#endif
+                for(int64_t i = 0; i < (int64_t)count; i++)
+                    for(uint8_t k = 0; k < 3; k++)
+                        writeFloat(buffer + (3*i+k)*sizeof(float), positions[3*ids[c+i]+k]);
+            }
+            succeed = fwrite(buffer, 3*sizeof(float), count, file) == count;
+        }
+
+        //Colors. Unselected points are transparent black (if they are written)
+        auto visible = [sd, useMask](size_t destID)
+        {
+            return !useMask || sd->getVolumetricMaskAt(destID);
+        };
+
+        for(size_t c = 0; c < ids.size() && succeed; c += CHUNK_SIZE)
+        {
+            size_t count = std::min(CHUNK_SIZE, ids.size() - c);
+            {
+#ifdef _OPENMP
+                std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+#if defined(_OPENMP)
+                #pragma omp parallel
+#endif
+                {
+                    float* scratch = (float*)malloc(2*ctx.tf->getDimension()*sizeof(float));
+#if defined(_OPENMP)
+                    #pragma omp for schedule(static)
+#endif
+                    for(int64_t b = 0; b < (int64_t)((count + COLOR_BATCH_SIZE - 1)/COLOR_BATCH_SIZE); b++)
+                    {
+                        size_t begin = b*COLOR_BATCH_SIZE;
+                        computeTFColorBatch(ctx, ids.data() + c + begin, 0, std::min(COLOR_BATCH_SIZE, count - begin), visible, scratch, buffer + 4*begin);
+                    }
+                    free(scratch);
+                }
+            }
+            succeed = fwrite(buffer, 4*sizeof(uint8_t), count, file) == count;
+        }
+
+        if(!succeed)
+            ERROR << "Could not write the file " << path << std::endl;
+
+        free(buffer);
+        fclose(file);
+        return succeed;
     }
 }
@@ -0,0 +1,131 @@
+#include "SpaceFillingCurve.h"
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace sereno
+{
+    void computeSpaceFillingCurveCodes(const float* positions, size_t nbPoints, const float* minPos, const float* maxPos, SpaceFillingCurveType type, uint64_t* codes)
+    {
+        float invExtent[3];
+        for(uint8_t k = 0; k < 3; k++)
+            invExtent[k] = (maxPos[k] > minPos[k] ? 1.0f/(maxPos[k] - minPos[k]) : 0.0f);
+
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(static)
+#endif
+        for(int64_t i = 0; i < (int64_t)nbPoints; i++)
+        {
+            uint32_t x = quantizeCoordinate(positions[3*i+0], minPos[0], invExtent[0]);
+            uint32_t y = quantizeCoordinate(positions[3*i+1], minPos[1], invExtent[1]);
+            uint32_t z = quantizeCoordinate(positions[3*i+2], minPos[2], invExtent[2]);
+            codes[i]   = (type == SPACE_FILLING_CURVE_HILBERT ? hilbertEncode3D(x, y, z) : mortonEncode3D(x, y, z));
+        }
+    }
+
+    bool radixSort(uint64_t* keys, uint32_t* values, size_t n, uint32_t nbBits)
+    {
+        if(n < 2)
+            return true;
+
+        uint64_t* tmpKeys   = (uint64_t*)malloc(sizeof(uint64_t)*n);
+        uint32_t* tmpValues = (uint32_t*)malloc(sizeof(uint32_t)*n);
+        if(tmpKeys == NULL || tmpValues == NULL)
+        {
+            free(tmpKeys);
+            free(tmpValues);
+            return false;
+        }
+        uint64_t* srcKeys   = keys;
+        uint32_t* srcValues = values;
+
+#ifdef _OPENMP
+        const int maxThreads = omp_get_max_threads();
+#else
+        const int maxThreads = 1;
+#endif
+        std::vector<size_t> histo(256*maxThreads);
+
+        for(uint32_t shift = 0; shift < nbBits; shift += 8)
+        {
+            bool skipPass = false;
+#ifdef _OPENMP
+            #pragma omp parallel num_threads(maxThreads)
+#endif
+            {
+#ifdef _OPENMP
+                const int tID = omp_get_thread_num();
+                const int nbT = omp_get_num_threads();
+#else
+                const int tID = 0;
+                const int nbT = 1;
+#endif
+                const size_t begin = n*tID/nbT;
+                const size_t end   = n*(tID+1)/nbT;
+                size_t* h = histo.data() + 256*tID;
+
+                //Local histogram of the current digit
+                memset(h, 0x00, sizeof(size_t)*256);
+                for(size_t i = begin; i < end; i++)
+                    h[(srcKeys[i] >> shift) & 0xff]++;
+
+#ifdef _OPENMP
+                #pragma omp barrier
+                #pragma omp single
+#endif
+                {
+                    //Turn the histograms into scatter offsets (digit-major, then thread-major to keep the sort stable)
+                    size_t offset = 0;
+                    for(uint32_t d = 0; d < 256; d++)
+                    {
+                        size_t digitCount = 0;
+                        for(int t = 0; t < nbT; t++)
+                        {
+                            size_t count = histo[256*t+d];
+                            histo[256*t+d] = offset;
+                            offset     += count;
+                            digitCount += count;
+                        }
+                        //All the keys share the same digit: nothing to do for this pass
+                        if(digitCount == n)
+                            skipPass = true;
+                    }
+                }
+
+                if(!skipPass)
+                {
+                    for(size_t i = begin; i < end; i++)
+                    {
+                        size_t dst = h[(srcKeys[i] >> shift) & 0xff]++;
+                        tmpKeys[dst]   = srcKeys[i];
+                        tmpValues[dst] = srcValues[i];
+                    }
+                }
+            }
+
+            if(!skipPass)
+            {
+                std::swap(srcKeys,   tmpKeys);
+                std::swap(srcValues, tmpValues);
+            }
+        }
+
+        //The result may be stored in our temporary buffers
+        if(srcKeys != keys)
+        {
+            memcpy(keys,   srcKeys,   sizeof(uint64_t)*n);
+            memcpy(values, srcValues, sizeof(uint32_t)*n);
+            std::swap(srcKeys,   tmpKeys);
+            std::swap(srcValues, tmpValues);
+        }
+
+        free(tmpKeys);
+        free(tmpValues);
+        return true;
+    }
+}
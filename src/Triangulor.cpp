@@ -1,65 +1,643 @@
 #include "Triangulor.h"
+#include <deque>
+#include <limits>
+#include <cmath>
 
 namespace sereno
 {
-    std::vector<int> triangulate(const std::vector<glm::vec2>& points)
+    /** \brief  A polygon vertex of the ear clipping, stored in doubly linked lists (polygon order and z-order) */
+    struct EarNode
     {
-        std::vector<int> indices;
+        uint32_t i;                /*!< The index of the vertex in the input points*/
+        double   x;                /*!< The x coordinate*/
+        double   y;                /*!< The y coordinate*/
+        int32_t  z       = -1;     /*!< The z-order code of the vertex, -1 if not computed yet*/
+        EarNode* prev    = NULL;   /*!< The previous vertex in the polygon*/
+        EarNode* next    = NULL;   /*!< The next vertex in the polygon*/
+        EarNode* prevZ   = NULL;   /*!< The previous vertex in z-order*/
+        EarNode* nextZ   = NULL;   /*!< The next vertex in z-order*/
+        bool     steiner = false;  /*!< Is this vertex a one-point hole? Those must not be filtered out*/
 
-        int n = points.size();
-        if (n < 3)
-            return indices;
+        EarNode(uint32_t _i, double _x, double _y) : i(_i), x(_x), y(_y) {}
+    };
+
+    /** \brief  The state of one triangulation */
+    struct EarcutContext
+    {
+        std::deque<EarNode>    nodes;          /*!< The vertices. A deque keeps the addresses stable while nodes are added*/
+        std::vector<uint32_t>* output;         /*!< The triangle indices*/
+        double                 minX    = 0.0;  /*!< The bounding box origin, for the z-order codes*/
+        double                 minY    = 0.0;  /*!< The bounding box origin, for the z-order codes*/
+        double                 invSize = 0.0;  /*!< 32767 / the bounding box size. 0 if the z-order index is not used*/
+    };
+
+    /** \brief  Polygons below this number of vertices are triangulated without the z-order index */
+    #define EARCUT_HASH_THRESHOLD 80
+
+    /** \brief  Twice the signed area of the triangle pqr. Positive if pqr turns clockwise */
+    static inline double _earArea(const EarNode* p, const EarNode* q, const EarNode* r)
+    {
+        return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+    }
+
+    static inline bool _earEquals(const EarNode* p, const EarNode* q)
+    {
+        return p->x == q->x && p->y == q->y;
+    }
+
+    /** \brief  Is the point p inside the counter-clockwise triangle abc (borders included)? */
+    static inline bool _earPointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py)
+    {
+        return (cx - px) * (ay - py) >= (ax - px) * (cy - py) &&
+               (ax - px) * (by - py) >= (bx - px) * (ay - py) &&
+               (bx - px) * (cy - py) >= (cx - px) * (by - py);
+    }
+
+    /** \brief  Compute the z-order code of a point, on 15 bits per axis */
+    static inline int32_t _earZOrder(double px, double py, const EarcutContext& ctx)
+    {
+        uint32_t x = (uint32_t)((px - ctx.minX) * ctx.invSize);
+        uint32_t y = (uint32_t)((py - ctx.minY) * ctx.invSize);
+
+        x = (x | (x << 8)) & 0x00FF00FF;
+        x = (x | (x << 4)) & 0x0F0F0F0F;
+        x = (x | (x << 2)) & 0x33333333;
+        x = (x | (x << 1)) & 0x55555555;
+
+        y = (y | (y << 8)) & 0x00FF00FF;
+        y = (y | (y << 4)) & 0x0F0F0F0F;
+        y = (y | (y << 2)) & 0x33333333;
+        y = (y | (y << 1)) & 0x55555555;
 
-        int* V = new int[n];
-        if(area(points) > 0)
+        return (int32_t)(x | (y << 1));
+    }
+
+    static EarNode* _earInsertNode(EarcutContext& ctx, uint32_t i, const glm::vec2& point, EarNode* last)
+    {
+        ctx.nodes.emplace_back(i, point.x, point.y);
+        EarNode* p = &ctx.nodes.back();
+        if(!last)
         {
-            for (int v = 0; v < n; v++)
-                V[v] = v;
+            p->prev = p;
+            p->next = p;
         }
         else
         {
-            for (int v = 0; v < n; v++)
-                V[v] = (n - 1) - v;
+            p->next = last->next;
+            p->prev = last;
+            last->next->prev = p;
+            last->next = p;
         }
+        return p;
+    }
 
-        int nv = n;
-        int count = 2 * nv;
-        for (int v = nv - 1; nv > 2;)
+    static void _earRemoveNode(EarNode* p)
+    {
+        p->next->prev = p->prev;
+        p->prev->next = p->next;
+        if(p->prevZ)
+            p->prevZ->nextZ = p->nextZ;
+        if(p->nextZ)
+            p->nextZ->prevZ = p->prevZ;
+    }
+
+    /** \brief  Create a circular linked list from a ring of points
+     * \param counterClockwise the orientation the list must have
+     * \return   the last node of the list, NULL if the ring is empty */
+    static EarNode* _earLinkedList(EarcutContext& ctx, const std::vector<glm::vec2>& points, uint32_t start, uint32_t end, bool counterClockwise)
+    {
+        double signedArea = 0.0;
+        for(uint32_t i = start, j = end-1; i < end; j = i++)
+            signedArea += ((double)points[j].x - points[i].x) * ((double)points[i].y + points[j].y);
+
+        EarNode* last = NULL;
+        if(counterClockwise == (signedArea > 0))
+            for(uint32_t i = start; i < end; i++)
+                last = _earInsertNode(ctx, i, points[i], last);
+        else
+            for(uint32_t i = end; i-- > start;)
+                last = _earInsertNode(ctx, i, points[i], last);
+
+        if(last && _earEquals(last, last->next))
         {
-            if ((count--) <= 0)
-                goto endTriangular;
+            _earRemoveNode(last);
+            last = last->next;
+        }
+        return last;
+    }
 
-            int u = v;
-            if (nv <= u)
-                u = 0;
-            v = u + 1;
-            if (nv <= v)
-                v = 0;
-            int w = v + 1;
-            if (nv <= w)
-                w = 0;
+    /** \brief  Remove the duplicated and collinear points of a list, between start and end
+     * \return   a node still in the list */
+    static EarNode* _earFilterPoints(EarNode* start, EarNode* end = NULL)
+    {
+        if(!start)
+            return start;
+        if(!end)
+            end = start;
 
-            if (snip(points, u, v, w, nv, V))
+        EarNode* p = start;
+        bool again;
+        do
+        {
+            again = false;
+            if(!p->steiner && (_earEquals(p, p->next) || _earArea(p->prev, p, p->next) == 0))
             {
-                int a, b, c, s, t;
-                a = V[u];
-                b = V[v];
-                c = V[w];
-                indices.push_back(a);
-                indices.push_back(b);
-                indices.push_back(c);
-                for (s = v, t = v + 1; t < nv; s++, t++)
-                    V[s] = V[t];
-                nv--;
-                count = 2 * nv;
+                _earRemoveNode(p);
+                p = end = p->prev;
+                if(p == p->next)
+                    break;
+                again = true;
             }
+            else
+                p = p->next;
+        }while(again || p != end);
+
+        return end;
+    }
+
+    /** \brief  Sort a list linked through nextZ by z-order (bottom-up merge sort, Simon Tatham's algorithm) */
+    static void _earSortLinked(EarNode* list)
+    {
+        uint32_t inSize = 1;
+        uint32_t nbMerges;
+        do
+        {
+            EarNode* p    = list;
+            EarNode* tail = NULL;
+            list     = NULL;
+            nbMerges = 0;
+
+            while(p)
+            {
+                nbMerges++;
+                EarNode* q     = p;
+                uint32_t pSize = 0;
+                for(uint32_t i = 0; i < inSize && q; i++)
+                {
+                    pSize++;
+                    q = q->nextZ;
+                }
+                uint32_t qSize = inSize;
+
+                while(pSize > 0 || (qSize > 0 && q))
+                {
+                    EarNode* e;
+                    if(pSize != 0 && (qSize == 0 || !q || p->z <= q->z))
+                    {
+                        e = p;
+                        p = p->nextZ;
+                        pSize--;
+                    }
+                    else
+                    {
+                        e = q;
+                        q = q->nextZ;
+                        qSize--;
+                    }
+
+                    if(tail)
+                        tail->nextZ = e;
+                    else
+                        list = e;
+                    e->prevZ = tail;
+                    tail     = e;
+                }
+                p = q;
+            }
+
+            tail->nextZ = NULL;
+            inSize *= 2;
+        }while(nbMerges > 1);
+    }
+
+    /** \brief  Compute the z-order codes of a list and link its nodes in z-order */
+    static void _earIndexCurve(EarNode* start, const EarcutContext& ctx)
+    {
+        EarNode* p = start;
+        do
+        {
+            if(p->z < 0)
+                p->z = _earZOrder(p->x, p->y, ctx);
+            p->prevZ = p->prev;
+            p->nextZ = p->next;
+            p = p->next;
+        }while(p != start);
+
+        p->prevZ->nextZ = NULL;
+        p->prevZ = NULL;
+        _earSortLinked(p);
+    }
+
+    /** \brief  Is the node "p" a reflex vertex lying in the triangle abc? If so, abc cannot be clipped */
+    static inline bool _earBlocksEar(const EarNode* p, const EarNode* a, const EarNode* b, const EarNode* c, double x0, double y0, double x1, double y1)
+    {
+        return p->x >= x0 && p->x <= x1 && p->y >= y0 && p->y <= y1 && p != a && p != c &&
+               _earPointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) && _earArea(p->prev, p, p->next) >= 0;
+    }
+
+    /** \brief  Is the vertex ear the tip of an ear, testing all the other vertices? */
+    static bool _earIsEar(const EarNode* ear)
+    {
+        const EarNode* a = ear->prev;
+        const EarNode* b = ear;
+        const EarNode* c = ear->next;
+        if(_earArea(a, b, c) >= 0)
+            return false; //Reflex
+
+        double x0 = std::min({a->x, b->x, c->x}), y0 = std::min({a->y, b->y, c->y});
+        double x1 = std::max({a->x, b->x, c->x}), y1 = std::max({a->y, b->y, c->y});
+
+        for(const EarNode* p = c->next; p != a; p = p->next)
+            if(_earBlocksEar(p, a, b, c, x0, y0, x1, y1))
+                return false;
+        return true;
+    }
+
+    /** \brief  Is the vertex ear the tip of an ear, testing only the vertices whose z-order code lies in the ear's bounding box? */
+    static bool _earIsEarHashed(const EarNode* ear, const EarcutContext& ctx)
+    {
+        const EarNode* a = ear->prev;
+        const EarNode* b = ear;
+        const EarNode* c = ear->next;
+        if(_earArea(a, b, c) >= 0)
+            return false; //Reflex
+
+        double x0 = std::min({a->x, b->x, c->x}), y0 = std::min({a->y, b->y, c->y});
+        double x1 = std::max({a->x, b->x, c->x}), y1 = std::max({a->y, b->y, c->y});
+
+        int32_t minZ = _earZOrder(x0, y0, ctx);
+        int32_t maxZ = _earZOrder(x1, y1, ctx);
+
+        //Look in both directions from the ear along the z-order curve
+        const EarNode* p = ear->prevZ;
+        const EarNode* n = ear->nextZ;
+        while(p && p->z >= minZ && n && n->z <= maxZ)
+        {
+            if(_earBlocksEar(p, a, b, c, x0, y0, x1, y1))
+                return false;
+            p = p->prevZ;
+
+            if(_earBlocksEar(n, a, b, c, x0, y0, x1, y1))
+                return false;
+            n = n->nextZ;
         }
 
-        std::reverse(indices.begin(), indices.end());
+        for(; p && p->z >= minZ; p = p->prevZ)
+            if(_earBlocksEar(p, a, b, c, x0, y0, x1, y1))
+                return false;
+
+        for(; n && n->z <= maxZ; n = n->nextZ)
+            if(_earBlocksEar(n, a, b, c, x0, y0, x1, y1))
+                return false;
+
+        return true;
+    }
+
+    static inline int _earSign(double v)
+    {
+        return (v > 0) - (v < 0);
+    }
+
+    /** \brief  Knowing p, q and r collinear, does q lie on the segment pr? */
+    static inline bool _earOnSegment(const EarNode* p, const EarNode* q, const EarNode* r)
+    {
+        return q->x <= std::max(p->x, r->x) && q->x >= std::min(p->x, r->x) && q->y <= std::max(p->y, r->y) && q->y >= std::min(p->y, r->y);
+    }
+
+    /** \brief  Do the segments p1q1 and p2q2 intersect? */
+    static bool _earIntersects(const EarNode* p1, const EarNode* q1, const EarNode* p2, const EarNode* q2)
+    {
+        int o1 = _earSign(_earArea(p1, q1, p2));
+        int o2 = _earSign(_earArea(p1, q1, q2));
+        int o3 = _earSign(_earArea(p2, q2, p1));
+        int o4 = _earSign(_earArea(p2, q2, q1));
+
+        if(o1 != o2 && o3 != o4)
+            return true;
+
+        //Collinear cases
+        return (o1 == 0 && _earOnSegment(p1, p2, q1)) || (o2 == 0 && _earOnSegment(p1, q2, q1)) ||
+               (o3 == 0 && _earOnSegment(p2, p1, q2)) || (o4 == 0 && _earOnSegment(p2, q1, q2));
+    }
+
+    /** \brief  Does the diagonal ab intersect an edge of the polygon? */
+    static bool _earIntersectsPolygon(const EarNode* a, const EarNode* b)
+    {
+        const EarNode* p = a;
+        do
+        {
+            if(p->i != a->i && p->next->i != a->i && p->i != b->i && p->next->i != b->i && _earIntersects(p, p->next, a, b))
+                return true;
+            p = p->next;
+        }while(p != a);
+        return false;
+    }
+
+    /** \brief  Is the diagonal ab locally inside the polygon, around a? */
+    static bool _earLocallyInside(const EarNode* a, const EarNode* b)
+    {
+        return _earArea(a->prev, a, a->next) < 0 ?
+            _earArea(a, b, a->next) >= 0 && _earArea(a, a->prev, b) >= 0 :
+            _earArea(a, b, a->prev) < 0 || _earArea(a, a->next, b) < 0;
+    }
+
+    /** \brief  Is the middle of the diagonal ab inside the polygon? */
+    static bool _earMiddleInside(const EarNode* a, const EarNode* b)
+    {
+        const EarNode* p  = a;
+        bool           inside = false;
+        double         px = (a->x + b->x) / 2;
+        double         py = (a->y + b->y) / 2;
+        do
+        {
+            if(((p->y > py) != (p->next->y > py)) && p->next->y != p->y &&
+               (px < (p->next->x - p->x) * (py - p->y) / (p->next->y - p->y) + p->x))
+                inside = !inside;
+            p = p->next;
+        }while(p != a);
+        return inside;
+    }
+
+    /** \brief  Can the polygon be split along the diagonal ab? */
+    static bool _earIsValidDiagonal(const EarNode* a, const EarNode* b)
+    {
+        return a->next->i != b->i && a->prev->i != b->i && !_earIntersectsPolygon(a, b) &&
+               ((_earLocallyInside(a, b) && _earLocallyInside(b, a) && _earMiddleInside(a, b) &&
+                 (_earArea(a->prev, a, b->prev) != 0 || _earArea(a, b->prev, b) != 0)) ||
+                (_earEquals(a, b) && _earArea(a->prev, a, a->next) > 0 && _earArea(b->prev, b, b->next) > 0)); //Self-touching point
+    }
+
+    /** \brief  Link a and b with a diagonal, splitting the polygon in two. a and b are duplicated
+     * \return   the duplicate of b, which belongs to the second polygon */
+    static EarNode* _earSplitPolygon(EarcutContext& ctx, EarNode* a, EarNode* b)
+    {
+        ctx.nodes.emplace_back(a->i, a->x, a->y);
+        EarNode* a2 = &ctx.nodes.back();
+        ctx.nodes.emplace_back(b->i, b->x, b->y);
+        EarNode* b2 = &ctx.nodes.back();
+        EarNode* an = a->next;
+        EarNode* bp = b->prev;
+
+        a->next  = b;
+        b->prev  = a;
+        a2->next = an;
+        an->prev = a2;
+        b2->next = a2;
+        a2->prev = b2;
+        bp->next = b2;
+        b2->prev = bp;
+
+        return b2;
+    }
+
+    static inline void _earPushTriangle(EarcutContext& ctx, const EarNode* a, const EarNode* b, const EarNode* c)
+    {
+        ctx.output->push_back(a->i);
+        ctx.output->push_back(b->i);
+        ctx.output->push_back(c->i);
+    }
+
+    /** \brief  Clip the small self-intersections of the polygon (abcd with ab and cd crossing)
+     * \return   a node still in the polygon */
+    static EarNode* _earCureLocalIntersections(EarcutContext& ctx, EarNode* start)
+    {
+        EarNode* p = start;
+        do
+        {
+            EarNode* a = p->prev;
+            EarNode* b = p->next->next;
+
+            if(!_earEquals(a, b) && _earIntersects(a, p, p->next, b) && _earLocallyInside(a, b) && _earLocallyInside(b, a))
+            {
+                _earPushTriangle(ctx, a, p, b);
+                _earRemoveNode(p);
+                _earRemoveNode(p->next);
+                p = start = b;
+            }
+            p = p->next;
+        }while(p != start);
+
+        return _earFilterPoints(p);
+    }
+
+    static void _earcutLinked(EarcutContext& ctx, EarNode* ear, int pass);
+
+    /** \brief  Split the polygon along a valid diagonal and triangulate both halves. Last resort when no ear can be found */
+    static void _earSplitEarcut(EarcutContext& ctx, EarNode* start)
+    {
+        EarNode* a = start;
+        do
+        {
+            for(EarNode* b = a->next->next; b != a->prev; b = b->next)
+            {
+                if(a->i != b->i && _earIsValidDiagonal(a, b))
+                {
+                    EarNode* c = _earSplitPolygon(ctx, a, b);
+                    a = _earFilterPoints(a, a->next);
+                    c = _earFilterPoints(c, c->next);
+                    _earcutLinked(ctx, a, 0);
+                    _earcutLinked(ctx, c, 0);
+                    return;
+                }
+            }
+            a = a->next;
+        }while(a != start);
+    }
+
+    /** \brief  Clip the ears of a polygon
+     * \param ear the node to start from
+     * \param pass 0 for the first pass, 1 once the points were filtered, 2 once the local intersections were cured */
+    static void _earcutLinked(EarcutContext& ctx, EarNode* ear, int pass)
+    {
+        if(!ear)
+            return;
+
+        if(pass == 0 && ctx.invSize != 0)
+            _earIndexCurve(ear, ctx);
+
+        EarNode* stop = ear;
+        while(ear->prev != ear->next)
+        {
+            EarNode* prev = ear->prev;
+            EarNode* next = ear->next;
+
+            if(ctx.invSize != 0 ? _earIsEarHashed(ear, ctx) : _earIsEar(ear))
+            {
+                _earPushTriangle(ctx, prev, ear, next);
+                _earRemoveNode(ear);
+
+                //Skipping the next vertex leads to less sliver triangles
+                ear  = next->next;
+                stop = next->next;
+                continue;
+            }
+
+            ear = next;
+
+            //A whole loop without any ear: the polygon is not simple
+            if(ear == stop)
+            {
+                if(pass == 0)
+                    _earcutLinked(ctx, _earFilterPoints(ear), 1);
+                else if(pass == 1)
+                    _earcutLinked(ctx, _earCureLocalIntersections(ctx, _earFilterPoints(ear)), 2);
+                else
+                    _earSplitEarcut(ctx, ear);
+                break;
+            }
+        }
+    }
+
+    /** \brief  Get the leftmost (then lowest) node of a list */
+    static EarNode* _earGetLeftmost(EarNode* start)
+    {
+        EarNode* p        = start;
+        EarNode* leftmost = start;
+        do
+        {
+            if(p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y))
+                leftmost = p;
+            p = p->next;
+        }while(p != start);
+        return leftmost;
+    }
+
+    /** \brief  Find a vertex of the outer polygon which can be linked to the leftmost vertex of a hole (David Eberly's algorithm)
+     * \return   the vertex found, NULL if none */
+    static EarNode* _earFindHoleBridge(EarNode* hole, EarNode* outerNode)
+    {
+        EarNode* p  = outerNode;
+        EarNode* m  = NULL;
+        double   hx = hole->x;
+        double   hy = hole->y;
+        double   qx = -std::numeric_limits<double>::infinity();
+
+        //Find the segment's endpoint on the left of the hole, intersected by the horizontal ray going through the hole's leftmost point
+        do
+        {
+            if(hy <= p->y && hy >= p->next->y && p->next->y != p->y)
+            {
+                double x = p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
+                if(x <= hx && x > qx)
+                {
+                    qx = x;
+                    m  = p->x < p->next->x ? p : p->next;
+                    if(x == hx)
+                        return m; //The hole touches the outer segment
+                }
+            }
+            p = p->next;
+        }while(p != outerNode);
+
+        if(!m)
+            return NULL;
+
+        //Look for the points inside the triangle (hole point, segment intersection, endpoint). If any, the bridge goes to the one with the minimum angle with the ray
+        EarNode* stop   = m;
+        double   mx     = m->x;
+        double   my     = m->y;
+        double   tanMin = std::numeric_limits<double>::infinity();
+
+        p = m;
+        do
+        {
+            if(hx >= p->x && p->x >= mx && hx != p->x &&
+               _earPointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, p->x, p->y))
+            {
+                double tan = std::abs(hy - p->y) / (hx - p->x);
+                if(_earLocallyInside(p, hole) &&
+                   (tan < tanMin || (tan == tanMin && (p->x > m->x || (p->x == m->x && _earArea(m->prev, m, p->prev) < 0 && _earArea(p->next, m, m->next) < 0)))))
+                {
+                    m      = p;
+                    tanMin = tan;
+                }
+            }
+            p = p->next;
+        }while(p != stop);
+
+        return m;
+    }
+
+    /** \brief  Link every hole to the outer polygon, producing a single (weakly simple) polygon
+     * \return   a node of the resulting polygon */
+    static EarNode* _earEliminateHoles(EarcutContext& ctx, const std::vector<glm::vec2>& points, const std::vector<uint32_t>& holeIndices, EarNode* outerNode)
+    {
+        std::vector<EarNode*> queue;
+        queue.reserve(holeIndices.size());
+        for(size_t h = 0; h < holeIndices.size(); h++)
+        {
+            uint32_t start = holeIndices[h];
+            uint32_t end   = (h+1 < holeIndices.size() ? holeIndices[h+1] : points.size());
+            EarNode* list  = _earLinkedList(ctx, points, start, end, false);
+            if(!list)
+                continue;
+            if(list == list->next)
+                list->steiner = true;
+            queue.push_back(_earGetLeftmost(list));
+        }
+
+        //Process the holes from left to right
+        std::sort(queue.begin(), queue.end(), [](const EarNode* a, const EarNode* b) {return a->x < b->x;});
+
+        for(EarNode* hole : queue)
+        {
+            EarNode* bridge = _earFindHoleBridge(hole, outerNode);
+            if(!bridge)
+                continue;
+
+            EarNode* bridgeReverse = _earSplitPolygon(ctx, bridge, hole);
+            _earFilterPoints(bridgeReverse, bridgeReverse->next);
+            outerNode = _earFilterPoints(bridge, bridge->next);
+        }
+        return outerNode;
+    }
+
+    std::vector<int> triangulate(const std::vector<glm::vec2>& points)
+    {
+        std::vector<uint32_t> triangles;
+        triangulate(points, std::vector<uint32_t>(), triangles);
+
+        //Historically, the triangles are returned clockwise
+        return std::vector<int>(triangles.rbegin(), triangles.rend());
+    }
+
+    size_t triangulate(const std::vector<glm::vec2>& points, const std::vector<uint32_t>& holeIndices, std::vector<uint32_t>& output)
+    {
+        output.clear();
+
+        EarcutContext ctx;
+        ctx.output = &output;
+
+        uint32_t outerEnd  = (holeIndices.size() ? holeIndices[0] : points.size());
+        EarNode* outerNode = _earLinkedList(ctx, points, 0, outerEnd, true);
+        if(!outerNode || outerNode->next == outerNode->prev)
+            return 0;
+
+        //A n-gon with h holes has n+2h-2 triangles
+        output.reserve(3*(points.size() + 2*holeIndices.size()));
+
+        if(holeIndices.size())
+            outerNode = _earEliminateHoles(ctx, points, holeIndices, outerNode);
+
+        //Index the vertices along a z-order curve, unless the polygon is too simple to be worth it
+        if(points.size() > EARCUT_HASH_THRESHOLD)
+        {
+            double maxX, maxY;
+            ctx.minX = maxX = points[0].x;
+            ctx.minY = maxY = points[0].y;
+            for(uint32_t i = 1; i < outerEnd; i++)
+            {
+                ctx.minX = std::min(ctx.minX, (double)points[i].x);
+                ctx.minY = std::min(ctx.minY, (double)points[i].y);
+                maxX     = std::max(maxX, (double)points[i].x);
+                maxY     = std::max(maxY, (double)points[i].y);
+            }
+            double size = std::max(maxX - ctx.minX, maxY - ctx.minY);
+            ctx.invSize = (size != 0 ? 32767.0 / size : 0.0);
+        }
 
-endTriangular:
-        delete[] V;
-        return indices;
+        _earcutLinked(ctx, outerNode, 0);
+        return output.size()/3;
     }
 
     float area(const std::vector<glm::vec2>& points)
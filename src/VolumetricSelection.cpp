@@ -7,6 +7,14 @@
 #include <glm/gtc/matrix_transform.hpp> 
 #include <iostream>
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <functional>
+#include "sciVisUtils.h"
+#include "Bitmask.h"
+#include "Triangulor.h"
 #include "Datasets/CloudPointDataset.h"
 #include "Datasets/VTKDataset.h"
 
@@ -66,179 +74,947 @@ namespace sereno
             return false;
     }
 
-    /**
-     * \brief  Apply the volumetric selection
-     *
-     * @tparam T the type of spatialPosAt
-     *
-     * \param mesh the mesh data to consider
-     * \param sd the subdataset containing the data
-     * \param spatialPosAt function to call to get the 3D position of a cell/object at k
-     */
-    template <typename T>
-    void applyVolumetricSelection(const VolumetricMesh& mesh, SubDataset* sd, const T& spatialPosAt)
+    /** \brief  Evaluate the edge function of a triangle edge projected on the (y, z) plane at a point.
+     * The edge is evaluated from its lexicographically smaller vertex, so that two triangles sharing an edge get exactly opposite values.
+     * A point lying on the edge is considered moved by (+eps, +eps^2) (simulation of simplicity), so that its side is never ambiguous
+     * \param a the first vertex of the edge
+     * \param b the second vertex of the edge
+     * \param y the y coordinate of the point
+     * \param z the z coordinate of the point
+     * \param sign[out] the side of the point: 1, -1, or 0 if the projected edge is degenerate
+     * \return   the value of the edge function (twice the signed area of the projected triangle (a, b, point)) */
+    static inline double edgeFunction(const glm::vec3& a, const glm::vec3& b, double y, double z, int& sign)
     {
-        const int CUBE_SIZE_X = 8;
-        const int CUBE_SIZE_Y = 8;
-        const int CUBE_SIZE_Z = 8;
+        const bool       swap = (b.y < a.y || (b.y == a.y && b.z < a.z));
+        const glm::vec3& p0   = (swap ? b : a);
+        const glm::vec3& p1   = (swap ? a : b);
 
-        const int CUBE_SIZE[] = { CUBE_SIZE_X, CUBE_SIZE_Y, CUBE_SIZE_Z };
+        //Products of float differences are exact in double precision for reasonable ranges of coordinates
+        const double dy = (double)p1.y - p0.y;
+        const double dz = (double)p1.z - p0.z;
+        double       e  = dy*(z - p0.z) - dz*(y - p0.y);
 
-        if (mesh.triangles.size() % 3 != 0)
+        double s = e;
+        if(s == 0.0)
+            s = (-dz != 0.0 ? -dz : dy);
+        sign = (s > 0.0 ? 1 : (s < 0.0 ? -1 : 0));
+        if(swap)
         {
-            std::cerr << "The number of triangles is not a multiple of 3. Abort";
-            return;
+            sign = -sign;
+            e    = -e;
         }
-        
-        //First, transform every point using the provided matrix
-        glm::vec3* points = new glm::vec3[mesh.points.size()];
-        glm::mat4  mat    = glm::inverse(sd->getModelWorldMatrix());
+        return e;
+    }
+
+    /** \brief  Compute where the line parallel to the x axis passing by (y, z) crosses a triangle, with a watertight test:
+     * lines passing by an edge or a vertex shared by several triangles cross exactly one of them (or none at silhouettes), and never miss them all
+     * \param y the y coordinate of the line
+     * \param z the z coordinate of the line
+     * \param triangle array containing the triangle data. Minimal length: 3
+     * \param x[out] the x coordinate of the crossing. Unchanged if the function returns false
+     * \param orientation[out] if not NULL, set to 1 or -1 depending on the side of the triangle the line enters from (for a consistently oriented mesh)
+     * \return   true if the line crosses the triangle, false otherwise */
+    static bool rowTriangleIntersectionWatertight(double y, double z, const glm::vec3* triangle, double* x, int* orientation = NULL)
+    {
+        int s0, s1, s2;
+        double e0 = edgeFunction(triangle[1], triangle[2], y, z, s0);
+        double e1 = edgeFunction(triangle[2], triangle[0], y, z, s1);
+        double e2 = edgeFunction(triangle[0], triangle[1], y, z, s2);
+        if(s0 == 0 || s0 != s1 || s0 != s2)
+            return false;
+
+        //Barycentric interpolation of the x coordinate. Triangles parallel to the line are skipped
+        double det = e0 + e1 + e2;
+        if(det == 0.0)
+            return false;
+        *x = (e0*triangle[0].x + e1*triangle[1].x + e2*triangle[2].x) / det;
+        if(orientation)
+            *orientation = s0;
+        return true;
+    }
+
+    /** \brief  Compute the solid angle of a triangle seen from a point (A. Van Oosterom and J. Strackee, "The Solid Angle of a Plane Triangle", 1983)
+     * \param pos the point
+     * \param triangle array containing the triangle data. Minimal length: 3
+     * \return   the signed solid angle, in steradians. The sign depends on the side of the triangle pos is */
+    static inline double triangleSolidAngle(const glm::vec3& pos, const glm::vec3* triangle)
+    {
+        const glm::dvec3 a = glm::dvec3(triangle[0]) - glm::dvec3(pos);
+        const glm::dvec3 b = glm::dvec3(triangle[1]) - glm::dvec3(pos);
+        const glm::dvec3 c = glm::dvec3(triangle[2]) - glm::dvec3(pos);
+        const double     la = glm::length(a), lb = glm::length(b), lc = glm::length(c);
+
+        double num = glm::dot(a, glm::cross(b, c));
+        double den = la*lb*lc + glm::dot(a, b)*lc + glm::dot(b, c)*la + glm::dot(c, a)*lb;
+        return 2.0*std::atan2(num, den);
+    }
+
+    /** \brief  Ray caster telling whether a position is inside a closed mesh. The mesh is expressed in the dataset local space.
+     * Triangles are indexed by a bounding volume hierarchy, so that a ray only visits the triangles whose bounding boxes it crosses.
+     * The inside/outside test depends on the mesh precision (see VolumetricSelectionPrecision) */
+    class MeshRayCaster
+    {
+        public:
+            /** \brief  Constructor. Transform the mesh in the dataset local space and build the bounding volume hierarchy over its triangles
+             * \param mesh the mesh data to consider
+             * \param sd the subdataset containing the data */
+            MeshRayCaster(const VolumetricMesh& mesh, SubDataset* sd) : m_precision(mesh.precision)
+            {
+                if(mesh.triangles.size() % 3 != 0)
+                {
+                    std::cerr << "The number of triangles is not a multiple of 3. Abort";
+                    return;
+                }
+
+                for(uint32_t id : mesh.triangles)
+                {
+                    if(id >= mesh.points.size())
+                    {
+                        std::cerr << "error in the mesh... exiting" << std::endl;
+                        return;
+                    }
+                }
+
+                //First, transform every point using the provided matrix
+                std::vector<glm::vec3> points(mesh.points.size());
+                glm::mat4 mat = glm::inverse(sd->getModelWorldMatrix());
 
 #if defined(_OPENMP)
-        #pragma omp parallel for
+                #pragma omp parallel for
 #endif
-        for(uint32_t i = 0; i < mesh.points.size(); i++)
-            points[i] = mat * glm::vec4(mesh.points[i], 1.0f);
+                for(int64_t i = 0; i < (int64_t)mesh.points.size(); i++)
+                    points[i] = mat * glm::vec4(mesh.points[i], 1.0f);
 
-        //Second, initialize our raster 3D space. Each cell contains the list of triangles it contains. Indice(x, y, z) = z*CUBE_SIZE_X*CUBE_SIZE_Y + y*CUBE_SIZE_X + x
-        RasteredCube* rasteredSpace = new RasteredCube[CUBE_SIZE_X*CUBE_SIZE_Y*CUBE_SIZE_Z];
+                //The winding number of a closed mesh is the signed number of crossings. Open meshes are closed by caps,
+                //whose winding number is subtracted from the signed number of crossings of the closed mesh (see getCapWindingNumber)
+                std::vector<uint32_t> triangles = mesh.triangles;
+                const size_t nbMeshTriangles    = triangles.size()/3;
+                if(m_precision == SELECTION_PRECISION_WINDING_NUMBER)
+                    m_isClosed = (addMeshCaps(points, triangles) == 0 && nbMeshTriangles > 0);
 
-        //Go through all the triangles. For each triangle, determine in which cells it is
-        for(size_t i = 0; i < mesh.triangles.size()/3; i++)
-        {
-            //Get the bounding box of the triangle
-            glm::vec3 minPos(0,0,0);
-            glm::vec3 maxPos(0,0,0);
+                //Second, compute the bounding box of every triangle
+                const size_t nbTriangles = triangles.size()/3;
+                m_triangleMin.resize(nbTriangles);
+                m_triangleMax.resize(nbTriangles);
+                std::vector<uint32_t>  triangleIDs(nbTriangles);
+                std::vector<glm::vec3> centroids(nbTriangles);
+
+                for(size_t i = 0; i < nbTriangles; i++)
+                {
+                    const glm::vec3& p0 = points[triangles[3*i]];
+                    const glm::vec3& p1 = points[triangles[3*i+1]];
+                    const glm::vec3& p2 = points[triangles[3*i+2]];
+                    m_triangleMin[i] = glm::min(p0, glm::min(p1, p2));
+                    m_triangleMax[i] = glm::max(p0, glm::max(p1, p2));
+                    centroids[i]     = (m_triangleMin[i] + m_triangleMax[i]) * 0.5f;
+                    triangleIDs[i]   = i;
+                }
+
+                //Third, build the hierarchy and store the triangles in the hierarchy order.
+                //The caps get their own subtree (the second child of the root), so that their winding number only visits them
+                m_firstCapTriangle = nbMeshTriangles;
+                if(nbTriangles > nbMeshTriangles)
+                {
+                    m_nodes.reserve(4*(nbTriangles/BVH_LEAF_SIZE+1)+1);
+                    m_nodes.resize(3);
+                    m_nodes[0].first = 1;
+                    m_nodes[0].count = 0;
+                    buildNode(1, 0,               nbMeshTriangles, triangleIDs, centroids);
+                    buildNode(2, nbMeshTriangles, nbTriangles,     triangleIDs, centroids, BVH_CAP_LEAF_SIZE);
+                    m_nodes[0].minPos = glm::min(m_nodes[1].minPos, m_nodes[2].minPos);
+                    m_nodes[0].maxPos = glm::max(m_nodes[1].maxPos, m_nodes[2].maxPos);
+                    m_capRootNode     = 2;
+                }
+                else if(nbTriangles > 0)
+                {
+                    m_nodes.reserve(4*(nbTriangles/BVH_LEAF_SIZE+1));
+                    m_nodes.resize(1);
+                    buildNode(0, 0, nbTriangles, triangleIDs, centroids);
+                }
+
+                if(nbTriangles > 0)
+                {
+                    m_meshMin = m_nodes[0].minPos;
+                    m_meshMax = m_nodes[0].maxPos;
+                }
+
+                m_triangles.resize(3*nbTriangles);
+                for(size_t i = 0; i < nbTriangles; i++)
+                    for(uint8_t j = 0; j < 3; j++)
+                        m_triangles[3*i+j] = points[triangles[3*triangleIDs[i]+j]];
+
+                if(m_capRootNode > 0)
+                    computeNodeDipoles();
+
+                m_isValid = true;
+            }
+
+            /** \brief  A crossing between a line parallel to the x axis and the mesh */
+            struct RowCrossing
+            {
+                float  x;           /*!< The x coordinate of the crossing*/
+                int8_t orientation; /*!< 1 or -1 depending on the side of the mesh the line enters from. 0 with SELECTION_PRECISION_FAST*/
+            };
+
+            MeshRayCaster(const MeshRayCaster&) = delete;
+            MeshRayCaster& operator=(const MeshRayCaster&) = delete;
+
+            /** \brief  Is the mesh valid (i.e., could it be indexed)?
+             * \return   true if valid, false otherwise */
+            bool isValid() const {return m_isValid;}
+
+            /** \brief  Get the number of triangles of the mesh, including the caps closing an open mesh
+             * \return   the number of triangles */
+            size_t getNbTriangles() const {return m_triangleMin.size();}
+
+            /** \brief  Get the inside/outside test in use
+             * \return   the precision mode of the mesh */
+            VolumetricSelectionPrecision getPrecision() const {return m_precision;}
+
+            /** \brief  Get the minimum position of the mesh bounding box (dataset local space)
+             * \return   the minimum position of the mesh */
+            const glm::vec3& getMinPos() const {return m_meshMin;}
+
+            /** \brief  Get the maximum position of the mesh bounding box (dataset local space)
+             * \return   the maximum position of the mesh */
+            const glm::vec3& getMaxPos() const {return m_meshMax;}
+
+            /** \brief  Tell whether the bounding box of a triangle overlaps a box
+             * \param triangleID the triangle to test
+             * \param minPos the minimum position of the box
+             * \param maxPos the maximum position of the box
+             * \return   true if both boxes overlap, false otherwise */
+            bool triangleOverlaps(uint32_t triangleID, const glm::vec3& minPos, const glm::vec3& maxPos) const
+            {
+                for(uint8_t j = 0; j < 3; j++)
+                    if(m_triangleMin[triangleID][j] > maxPos[j] || m_triangleMax[triangleID][j] < minPos[j])
+                        return false;
+                return true;
+            }
+
+            /** \brief  Is a position inside the mesh? This function does not allocate memory and can be called concurrently
+             * \param pos the position to test (dataset local space)
+             * \return   true if pos is inside the mesh, false otherwise */
+            bool isInside(const glm::vec3& pos) const
+            {
+                //Empty mesh or outside the mesh bounding box. The winding number is at most 0.5 there too
+                if(m_nodes.empty())
+                    return false;
+                for(uint8_t j = 0; j < 3; j++)
+                    if(!(pos[j] >= m_meshMin[j] && pos[j] <= m_meshMax[j]))
+                        return false;
+
+                //Cast the ray along the x axis, toward the closest side of the mesh bounding box
+                const bool      positive = (m_meshMax.x - pos.x <= pos.x - m_meshMin.x);
+                const glm::vec3 rayDir(positive ? 1.0f : -1.0f, 0.0f, 0.0f);
+                const bool      watertight = (m_precision != SELECTION_PRECISION_FAST);
+                int nbIntersection = 0;
+                int windingNumber  = 0;
+
+                uint32_t stack[BVH_MAX_DEPTH];
+                uint32_t stackSize = 0;
+                stack[stackSize++] = 0;
 
-            for(uint8_t j = 0; j < 3; j++)
+                while(stackSize)
+                {
+                    const BVHNode& node = m_nodes[stack[--stackSize]];
+
+                    //Axis-aligned ray -- box intersection
+                    if(pos.y < node.minPos.y || pos.y > node.maxPos.y ||
+                       pos.z < node.minPos.z || pos.z > node.maxPos.z ||
+                       (positive ? node.maxPos.x < pos.x : node.minPos.x > pos.x))
+                        continue;
+
+                    if(node.count > 0)
+                    {
+                        for(uint32_t i = node.first; i < node.first + node.count; i++)
+                        {
+                            if(watertight)
+                            {
+                                double x;
+                                int    orientation;
+                                if(rowTriangleIntersectionWatertight(pos.y, pos.z, &m_triangles[3*i], &x, &orientation) && (positive ? x > pos.x : x < pos.x))
+                                {
+                                    nbIntersection++;
+                                    windingNumber += orientation;
+                                }
+                            }
+                            else if(rayTriangleIntersection(pos, rayDir, &m_triangles[3*i]))
+                                nbIntersection++;
+                        }
+                    }
+                    else
+                    {
+                        stack[stackSize++] = node.first;
+                        stack[stackSize++] = node.first+1;
+                    }
+                }
+
+                if(m_precision == SELECTION_PRECISION_WINDING_NUMBER)
+                {
+                    if(m_isClosed)
+                        return windingNumber != 0;
+
+                    //The crossings on both sides of pos cancel out: the crossings behind pos count negatively
+                    return std::fabs((positive ? windingNumber : -windingNumber) - getCapWindingNumber(pos)) > 0.5;
+                }
+                return nbIntersection % 2 == 1;
+            }
+
+            /** \brief  Is the mesh closed? Closed meshes need no cap, and are classified with signed crossings only with SELECTION_PRECISION_WINDING_NUMBER
+             * \return   true if every edge is shared by as many triangles in both directions, false otherwise */
+            bool isClosed() const {return m_isClosed;}
+
+            /** \brief  Compute the generalized winding number of the caps closing an open mesh at a position (A. Jacobson et al., "Robust Inside-Outside Segmentation using Generalized Winding Numbers", 2013).
+             * Winding numbers are additive: the winding number of the open mesh is the signed number of crossings of the closed mesh (an integer, see getRowCrossings), minus the one of the caps.
+             * Far nodes of the cap subtree are approximated by their dipole (G. Barill et al., "Fast Winding Numbers for Soups and Clouds", 2018).
+             * Requires the precision SELECTION_PRECISION_WINDING_NUMBER and an open mesh (see isClosed). This function does not allocate memory and can be called concurrently
+             * \param pos the position to evaluate (dataset local space)
+             * \return   the winding number of the caps, positive behind them */
+            double getCapWindingNumber(const glm::vec3& pos) const
             {
-                if(mesh.triangles[3*i] > mesh.points.size())
+                if(m_nodeDipoles.empty())
+                    return 0.0;
+
+                double solidAngle = 0.0;
+
+                uint32_t stack[BVH_MAX_DEPTH];
+                uint32_t stackSize = 0;
+                stack[stackSize++] = m_capRootNode;
+
+                while(stackSize)
                 {
-                    std::cerr << "error in the mesh... exiting" << std::endl;
+                    uint32_t          nodeID = stack[--stackSize];
+                    const BVHNode&    node   = m_nodes[nodeID];
+                    const NodeDipole& dipole = m_nodeDipoles[nodeID];
+
+                    //Far enough: the caps of the node are seen as one dipole
+                    glm::vec3 d     = dipole.center - pos;
+                    float     dist2 = glm::dot(d, d);
+                    if(dist2 > WINDING_ACCURACY*WINDING_ACCURACY*dipole.radius*dipole.radius)
+                        solidAngle += glm::dot(dipole.areaNormal, d) / (dist2*std::sqrt(dist2));
+                    else if(node.count > 0)
+                    {
+                        for(uint32_t i = node.first; i < node.first + node.count; i++)
+                            solidAngle += triangleSolidAngle(pos, &m_triangles[3*i]);
+                    }
+                    else
+                    {
+                        stack[stackSize++] = node.first;
+                        stack[stackSize++] = node.first+1;
+                    }
+                }
+
+                return solidAngle / (4.0*M_PI);
+            }
+
+            /** \brief  Compute where the line parallel to the x axis passing by (y, z) crosses the mesh. This function can be called concurrently
+             * \param y the y coordinate of the line (dataset local space)
+             * \param z the z coordinate of the line (dataset local space)
+             * \param output[out] the crossings, sorted by x coordinate. The array is cleared first */
+            void getRowCrossings(float y, float z, std::vector<RowCrossing>& output) const
+            {
+                output.clear();
+                if(m_nodes.empty() || !(y >= m_meshMin.y && y <= m_meshMax.y && z >= m_meshMin.z && z <= m_meshMax.z))
                     return;
+
+                const glm::vec3 rayOrigin(m_meshMin.x - 1.0f, y, z);
+                const glm::vec3 rayDir(1.0f, 0.0f, 0.0f);
+                const bool      watertight = (m_precision != SELECTION_PRECISION_FAST);
+
+                uint32_t stack[BVH_MAX_DEPTH];
+                uint32_t stackSize = 0;
+                stack[stackSize++] = 0;
+
+                while(stackSize)
+                {
+                    const BVHNode& node = m_nodes[stack[--stackSize]];
+                    if(y < node.minPos.y || y > node.maxPos.y || z < node.minPos.z || z > node.maxPos.z)
+                        continue;
+
+                    if(node.count > 0)
+                    {
+                        for(uint32_t i = node.first; i < node.first + node.count; i++)
+                        {
+                            if(watertight)
+                            {
+                                double x;
+                                int    orientation;
+                                if(rowTriangleIntersectionWatertight(y, z, &m_triangles[3*i], &x, &orientation))
+                                    output.push_back({(float)x, (int8_t)orientation});
+                            }
+                            else
+                            {
+                                float t;
+                                if(rayTriangleIntersection(rayOrigin, rayDir, &m_triangles[3*i], &t))
+                                    output.push_back({rayOrigin.x + t, 0});
+                            }
+                        }
+                    }
+                    else
+                    {
+                        stack[stackSize++] = node.first;
+                        stack[stackSize++] = node.first+1;
+                    }
+                }
+
+                std::sort(output.begin(), output.end(), [](const RowCrossing& a, const RowCrossing& b) {return a.x < b.x;});
+            }
+        private:
+            /** \brief  A node of the bounding volume hierarchy */
+            struct BVHNode
+            {
+                glm::vec3 minPos; /*!< The minimum position of the node bounding box*/
+                glm::vec3 maxPos; /*!< The maximum position of the node bounding box*/
+                uint32_t  first;  /*!< Leaf: the first triangle (hierarchy order). Inner node: the ID of the first child, the second one following it*/
+                uint32_t  count;  /*!< Leaf: the number of triangles. Inner node: 0*/
+            };
+
+            /** \brief  The first-order approximation of the caps of a node, used to compute winding numbers far from the node */
+            struct NodeDipole
+            {
+                glm::vec3 center;     /*!< The area-weighted centroid of the cap triangles*/
+                glm::vec3 areaNormal; /*!< The sum of the cap triangle normals scaled by the triangle areas*/
+                float     area;       /*!< The sum of the cap triangle areas. 0 if the node has no cap*/
+                float     radius;     /*!< The radius of a sphere centered on center and containing the cap triangles*/
+            };
+
+            /** \brief  Close the boundary of a mesh with caps, so that every edge is used as many times in both directions.
+             * Each boundary loop is triangulated by recursive bisection: most cap triangles join close boundary points, which keeps their dipole approximation effective
+             * \param points the mesh points
+             * \param triangles[in, out] the mesh triangles (three point IDs each). The cap triangles are appended
+             * \return   the number of cap triangles, 0 if the mesh was already closed and consistently oriented */
+            static size_t addMeshCaps(const std::vector<glm::vec3>& points, std::vector<uint32_t>& triangles)
+            {
+                //(smaller point ID, bigger point ID) << 1 | direction
+                std::vector<uint64_t> edges;
+                edges.reserve(triangles.size());
+                for(size_t i = 0; i < triangles.size(); i+=3)
+                {
+                    for(uint8_t j = 0; j < 3; j++)
+                    {
+                        uint64_t a = triangles[i+j];
+                        uint64_t b = triangles[i+(j+1)%3];
+                        edges.push_back(a < b ? ((a << 32 | b) << 1) : ((b << 32 | a) << 1 | 1));
+                    }
+                }
+                std::sort(edges.begin(), edges.end());
+
+                //Boundary edges, once per unbalanced use, in the direction the mesh uses them
+                std::vector<std::pair<uint32_t, uint32_t>> boundary;
+                for(size_t i = 0; i < edges.size();)
+                {
+                    size_t  j       = i;
+                    int64_t balance = 0;
+                    for(; j < edges.size() && (edges[j] >> 1) == (edges[i] >> 1); j++)
+                        balance += (edges[j] & 1 ? -1 : 1);
+
+                    //Edges of degenerate triangles (a == b) bound nothing
+                    uint32_t a = (uint32_t)(edges[i] >> 33);
+                    uint32_t b = (uint32_t)(edges[i] >> 1);
+                    if(a == b)
+                        balance = 0;
+                    for(; balance > 0; balance--)
+                        boundary.push_back({a, b});
+                    for(; balance < 0; balance++)
+                        boundary.push_back({b, a});
+                    i = j;
                 }
+                if(boundary.empty())
+                    return 0;
+                std::sort(boundary.begin(), boundary.end());
 
-                minPos[j] = fmin(points[mesh.triangles[3*i]][j], fmin(points[mesh.triangles[3*i+1]][j], points[mesh.triangles[3*i+2]][j]));
-                maxPos[j] = fmax(points[mesh.triangles[3*i]][j], fmax(points[mesh.triangles[3*i+1]][j], points[mesh.triangles[3*i+2]][j]));
+                //Outgoing boundary edges per point: boundary[firstEdge[p], firstEdge[p+1][
+                std::vector<uint32_t> firstEdge(points.size()+1, 0);
+                for(const auto& e : boundary)
+                    firstEdge[e.first+1]++;
+                for(size_t i = 0; i < points.size(); i++)
+                    firstEdge[i+1] += firstEdge[i];
+                std::vector<uint32_t> nextEdge(firstEdge.begin(), firstEdge.end()-1);
 
-                //Set them as indices in our 3D restered space
-                minPos[j] = CUBE_SIZE[j] * ((minPos[j] - sd->getParent()->getMinPos()[j]) / (sd->getParent()->getMaxPos()[j] - sd->getParent()->getMinPos()[j]));
-                maxPos[j] = CUBE_SIZE[j] * ((maxPos[j] - sd->getParent()->getMinPos()[j]) / (sd->getParent()->getMaxPos()[j] - sd->getParent()->getMinPos()[j]));
+                //Cap of the loop section [a, b]: its boundary is the reversed section, plus the chord loop[a] -> loop[b]
+                std::vector<uint32_t> loop;
+                size_t nbCaps = 0;
+                std::function<void(size_t, size_t)> addCap = [&](size_t a, size_t b)
+                {
+                    if(b - a < 2)
+                        return;
+                    size_t m = (a+b)/2;
+                    uint32_t t[] = {loop[a], loop[b], loop[m]};
+                    triangles.insert(triangles.end(), t, t+3);
+                    nbCaps++;
+                    addCap(a, m);
+                    addCap(m, b);
+                };
 
-                minPos[j] = fmax(0.0f,  minPos[j]);
-                minPos[j] = fmin(CUBE_SIZE[j]-1, minPos[j]);
+                //Every point has as many incoming as outgoing boundary edges: a walk along unused edges always comes back to its start
+                for(const auto& e : boundary)
+                {
+                    if(nextEdge[e.first] == firstEdge[e.first+1])
+                        continue;
 
-                maxPos[j] = fmax(0.0f, maxPos[j]);
-                maxPos[j] = fmin(CUBE_SIZE[j]-1, maxPos[j]);
+                    loop.clear();
+                    uint32_t p = e.first;
+                    do
+                    {
+                        loop.push_back(p);
+                        p = boundary[nextEdge[p]++].second;
+                    } while(p != loop[0] || nextEdge[p] < firstEdge[p+1]);
+                    loop.push_back(p);
+
+                    addCap(0, (loop.size()-1)/2);
+                    addCap((loop.size()-1)/2, loop.size()-1);
+                }
+                return nbCaps;
             }
 
-            //Cross the bounding box and our 3D rastered space
-            for(int kk = (int)minPos[2]; kk <= (int)maxPos[2]; kk++)
-                for(int jj = (int)minPos[1]; jj <= (int)maxPos[1]; jj++)
-                    for(int ii = (int)minPos[0]; ii <= (int)maxPos[0]; ii++)
-                        rasteredSpace[ii + CUBE_SIZE_X*jj + CUBE_SIZE_Y*CUBE_SIZE_X*kk].triangleIDs.push_back(i);
-        }
+            /** \brief  Compute the dipole of the caps of every node of the hierarchy, children before parents. Only the cap subtree uses them */
+            void computeNodeDipoles()
+            {
+                m_nodeDipoles.resize(m_nodes.size());
 
-        //Update the variable "MaxNbTriangles", useful to know the most efficient way to cast a ray
-        for(int k = 0; k < CUBE_SIZE_Z; k++)
-        {
-            for(int j = 0; j < CUBE_SIZE_Y; j++)
+                //Children are always stored after their parent
+                for(int64_t n = (int64_t)m_nodes.size()-1; n >= 0; n--)
+                {
+                    const BVHNode& node      = m_nodes[n];
+                    glm::dvec3     center(0.0);
+                    glm::dvec3     areaNormal(0.0);
+                    double         area = 0.0;
+
+                    auto accumulate = [&](const glm::vec3& c, const glm::vec3& normal)
+                    {
+                        double a    = glm::length(glm::dvec3(normal));
+                        center     += a*glm::dvec3(c);
+                        areaNormal += glm::dvec3(normal);
+                        area       += a;
+                    };
+
+                    if(node.count > 0)
+                    {
+                        for(uint32_t i = node.first; i < node.first + node.count; i++)
+                        {
+                            if(i < m_firstCapTriangle)
+                                continue;
+                            const glm::vec3* t = &m_triangles[3*i];
+                            accumulate((t[0]+t[1]+t[2])/3.0f, 0.5f*glm::cross(t[1]-t[0], t[2]-t[0]));
+                        }
+                    }
+                    else
+                    {
+                        //Children dipoles: their center is weighted back by their area
+                        for(uint32_t c = node.first; c < node.first+2; c++)
+                        {
+                            const NodeDipole& child = m_nodeDipoles[c];
+                            double a    = child.area;
+                            center     += a*glm::dvec3(child.center);
+                            areaNormal += glm::dvec3(child.areaNormal);
+                            area       += a;
+                        }
+                    }
+
+                    NodeDipole& dipole = m_nodeDipoles[n];
+                    dipole.center      = (area > 0.0 ? glm::vec3(center/area) : (node.minPos + node.maxPos)*0.5f);
+                    dipole.areaNormal  = glm::vec3(areaNormal);
+                    dipole.area        = area;
+                    dipole.radius      = 0.0f;
+
+                    //The radius bounds the caps only. Nodes of the mesh subtree get an empty dipole
+                    if(node.count > 0)
+                    {
+                        for(uint32_t i = MAX(node.first, m_firstCapTriangle); i < node.first + node.count; i++)
+                            for(uint8_t j = 0; j < 3; j++)
+                                dipole.radius = MAX(dipole.radius, glm::length(m_triangles[3*i+j] - dipole.center));
+                    }
+                    else
+                    {
+                        for(uint32_t c = node.first; c < node.first+2; c++)
+                            if(m_nodeDipoles[c].area > 0.0f)
+                                dipole.radius = MAX(dipole.radius, glm::length(m_nodeDipoles[c].center - dipole.center) + m_nodeDipoles[c].radius);
+                    }
+                }
+            }
+
+            /** \brief  Build a node of the hierarchy recursively, splitting the triangles at the median of the largest axis of their centroids.
+             * The children of a node are stored consecutively
+             * \param nodeID the (already allocated) node to build
+             * \param begin the first triangle (in triangleIDs) of the node
+             * \param end the last triangle (excluded, in triangleIDs) of the node
+             * \param triangleIDs the triangle IDs, reordered by the function
+             * \param centroids the centroid of each triangle bounding box
+             * \param leafSize the maximum number of triangles per leaf */
+            void buildNode(uint32_t nodeID, size_t begin, size_t end, std::vector<uint32_t>& triangleIDs, const std::vector<glm::vec3>& centroids, uint32_t leafSize = BVH_LEAF_SIZE)
             {
-                int nbTriangles = 0;
-                for(int i = 0; i < CUBE_SIZE_X; i++)
+                glm::vec3 minPos    = m_triangleMin[triangleIDs[begin]];
+                glm::vec3 maxPos    = m_triangleMax[triangleIDs[begin]];
+                glm::vec3 minCenter = centroids[triangleIDs[begin]];
+                glm::vec3 maxCenter = minCenter;
+                for(size_t i = begin+1; i < end; i++)
                 {
-                    nbTriangles += rasteredSpace[i + CUBE_SIZE_X*j + CUBE_SIZE_Y*CUBE_SIZE_X*k].triangleIDs.size();
-                    rasteredSpace[i + CUBE_SIZE_X*j + CUBE_SIZE_Y*CUBE_SIZE_X*k].maxNbTriangle = nbTriangles;
+                    minPos    = glm::min(minPos,    m_triangleMin[triangleIDs[i]]);
+                    maxPos    = glm::max(maxPos,    m_triangleMax[triangleIDs[i]]);
+                    minCenter = glm::min(minCenter, centroids[triangleIDs[i]]);
+                    maxCenter = glm::max(maxCenter, centroids[triangleIDs[i]]);
+                }
+                m_nodes[nodeID].minPos = minPos;
+                m_nodes[nodeID].maxPos = maxPos;
+
+                if(end - begin <= leafSize)
+                {
+                    m_nodes[nodeID].first = begin;
+                    m_nodes[nodeID].count = end - begin;
+                    return;
                 }
+
+                glm::vec3 extent = maxCenter - minCenter;
+                uint8_t   axis   = (extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2));
+                size_t    middle = begin + (end - begin)/2;
+                std::nth_element(triangleIDs.begin() + begin, triangleIDs.begin() + middle, triangleIDs.begin() + end,
+                                 [&](uint32_t a, uint32_t b) {return centroids[a][axis] < centroids[b][axis];});
+
+                uint32_t childID = m_nodes.size();
+                m_nodes.resize(childID+2);
+                m_nodes[nodeID].first = childID;
+                m_nodes[nodeID].count = 0;
+                buildNode(childID,   begin,  middle, triangleIDs, centroids, leafSize);
+                buildNode(childID+1, middle, end,    triangleIDs, centroids, leafSize);
             }
+
+            static const uint32_t BVH_LEAF_SIZE = 4;  /*!< The maximum number of triangles per leaf*/
+            static const uint32_t BVH_CAP_LEAF_SIZE = 1; /*!< The maximum number of triangles per leaf of the cap subtree: single triangles have the tightest dipoles*/
+            static const uint32_t BVH_MAX_DEPTH = 64; /*!< The traversal stack size. Median splits keep the depth below log2(nbTriangles)+2*/
+            static constexpr float WINDING_ACCURACY = 2.0f; /*!< Nodes farther than WINDING_ACCURACY times their radius are approximated by their dipole*/
+
+            VolumetricSelectionPrecision m_precision;       /*!< The inside/outside test to use*/
+            std::vector<glm::vec3> m_triangles;              /*!< The triangle vertices in the dataset local space, in the hierarchy order*/
+            std::vector<BVHNode>   m_nodes;                  /*!< The hierarchy nodes. The root is the first one*/
+            std::vector<NodeDipole> m_nodeDipoles;           /*!< The dipole of the caps of each node (SELECTION_PRECISION_WINDING_NUMBER and open meshes only)*/
+            std::vector<glm::vec3> m_triangleMin;            /*!< The minimum position of each triangle bounding box*/
+            std::vector<glm::vec3> m_triangleMax;            /*!< The maximum position of each triangle bounding box*/
+            glm::vec3              m_meshMin = glm::vec3(std::numeric_limits<float>::max());  /*!< The minimum position of the mesh bounding box*/
+            glm::vec3              m_meshMax = glm::vec3(-std::numeric_limits<float>::max()); /*!< The maximum position of the mesh bounding box*/
+            bool                   m_isValid       = false;  /*!< Is the mesh valid?*/
+            bool                   m_isClosed      = false;  /*!< Is the mesh closed (SELECTION_PRECISION_WINDING_NUMBER only)?*/
+            uint32_t               m_firstCapTriangle = 0;   /*!< The first cap triangle (hierarchy order). The caps close open meshes (SELECTION_PRECISION_WINDING_NUMBER only)*/
+            uint32_t               m_capRootNode   = 0;      /*!< The root node of the cap subtree, 0 if the mesh has no cap*/
+    };
+
+    /** \brief  Apply the boolean operation of a mesh on the volumetric mask of a subdataset, 64 bits at a time
+     * \param op the boolean operation to apply
+     * \param sd the subdataset to modify
+     * \param inside bit mask telling, per spatial data, whether it is inside the mesh. Size: sd->getParent()->getNbSpatialData() bits */
+    static void applySelectionOp(BooleanSelectionOp op, SubDataset* sd, const Bitmask& inside)
+    {
+        switch(op)
+        {
+            case SELECTION_OP_UNION:
+                sd->combineVolumetricMask(inside, BITMASK_OP_OR);
+                break;
+            case SELECTION_OP_INTER:
+                sd->combineVolumetricMask(inside, BITMASK_OP_AND);
+                break;
+            case SELECTION_OP_MINUS:
+                sd->combineVolumetricMask(inside, BITMASK_OP_ANDNOT);
+                break;
+            default:
+                break;
         }
+    }
 
-        //Go through all the points of the dataset and check if it is inside or outside the Mesh
+    /** \brief  Get the word covering the bits [begin, end[ of a bit mask word, in the Bitmask::data() byte layout
+     * \param begin the first bit to set, in [0, 64[
+     * \param end the last bit to set (excluded), in ]begin, 64]
+     * \return   the word having only the bits [begin, end[ set to 1 */
+    static inline uint64_t wordRangeMask(size_t begin, size_t end)
+    {
+        uint8_t bytes[sizeof(uint64_t)];
+        for(size_t i = 0; i < sizeof(uint64_t); i++)
+        {
+            size_t lo = MAX(begin, 8*i);
+            size_t hi = MIN(end,   8*i+8);
+            bytes[i]  = (lo < hi ? (uint8_t)((0xff << (lo - 8*i)) & (0xff >> (8*i+8 - hi))) : 0x00);
+        }
+
+        uint64_t mask;
+        memcpy(&mask, bytes, sizeof(uint64_t));
+        return mask;
+    }
+
+    /** \brief  Atomically OR a word of a bit mask
+     * \param word the word to modify
+     * \param mask the bits to set to 1 */
+    static inline void orWordAtomic(uint64_t* word, uint64_t mask)
+    {
 #if defined(_OPENMP)
-        #pragma omp parallel for
+        #pragma omp atomic
 #endif
-        for(uint32_t k=0; k < sd->getParent()->getNbSpatialData(); k++)
+        *word |= mask;
+    }
+
+    /** \brief  Set to 1 a bit of a bit mask. The word containing the bit is updated atomically, so that concurrent calls are safe
+     * \param words the bit mask words to modify (see Bitmask::getWords())
+     * \param x the bit to set */
+    static inline void setBitAtomic(uint64_t* words, size_t x)
+    {
+        orWordAtomic(words + x/64, wordRangeMask(x%64, x%64+1));
+    }
+
+    /** \brief  Set to 1 the bits [begin, end[ of a bit mask. Words partially covered are updated with an atomic OR, so that concurrent calls on disjoint ranges are safe
+     * \param words the bit mask words to modify (see Bitmask::getWords())
+     * \param begin the first bit to set
+     * \param end the last bit to set (excluded) */
+    static void setBitRangeAtomic(uint64_t* words, size_t begin, size_t end)
+    {
+        if(begin >= end)
+            return;
+
+        //Leading partial word
+        size_t w = begin/64;
+        if(begin % 64 || end - begin < 64)
         {
-            glm::vec3 pos = spatialPosAt(k);
-            glm::vec3 rayDir(1.0f, 0.0f, 0.0f);
-            int nbIntersection = 0;
-            std::vector<int> triangleIDAlready;
+            size_t wordEnd = MIN(end, 64*(w+1));
+            orWordAtomic(words + w, wordRangeMask(begin - 64*w, wordEnd - 64*w));
+            w++;
+        }
 
-            //The particule X position in the rastered space
-            int particuleX = (int)fmin(CUBE_SIZE_X-1, CUBE_SIZE_X * ((pos[0] - sd->getParent()->getMinPos()[0]) / (sd->getParent()->getMaxPos()[0] - sd->getParent()->getMinPos()[0])));
-            int particuleY = (int)fmin(CUBE_SIZE_Y-1, CUBE_SIZE_Y * ((pos[1] - sd->getParent()->getMinPos()[1]) / (sd->getParent()->getMaxPos()[1] - sd->getParent()->getMinPos()[1])));
-            int particuleZ = (int)fmin(CUBE_SIZE_Z-1, CUBE_SIZE_Z * ((pos[2] - sd->getParent()->getMinPos()[2]) / (sd->getParent()->getMaxPos()[2] - sd->getParent()->getMinPos()[2])));
+        //Words entirely covered by the range belong to the caller only
+        for(; 64*(w+1) <= end; w++)
+            words[w] = ~(uint64_t)0;
 
-            particuleX = fmax(particuleX, 0);
-            particuleY = fmax(particuleY, 0);
-            particuleZ = fmax(particuleZ, 0);
+        //Trailing partial word
+        if(64*w < end)
+            orWordAtomic(words + w, wordRangeMask(0, end - 64*w));
+    }
 
-            //Go through all the cubes
-            glm::vec3 triangle[3];
+    /** \brief  Apply the volumetric selection on a structured grid, one scanline at a time.
+     * For each (y, z) row, the crossings between the row and the mesh are computed once, and the inside spans are filled directly in a bit mask.
+     * With SELECTION_PRECISION_WINDING_NUMBER, the spans between two crossings are classified with winding numbers instead of the crossing parity
+     * \param mesh the mesh data to consider
+     * \param sd the subdataset containing the data
+     * \param size the grid size (x, y, z). Voxel (x, y, z) is at the position (x/size[0], y/size[1], z/size[2]) - 0.5 in the dataset local space */
+    static void applyVolumetricSelection_scanline(const VolumetricMesh& mesh, SubDataset* sd, const uint32_t* size)
+    {
+#ifdef _OPENMP
+        std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+        MeshRayCaster caster(mesh, sd);
+        if(!caster.isValid())
+            return;
+
+        Bitmask   inside((size_t)size[0]*size[1]*size[2], false);
+        uint64_t* insideWords = inside.getWords();
+
+#if defined(_OPENMP)
+        #pragma omp parallel
+#endif
+        {
+            std::vector<MeshRayCaster::RowCrossing> crossings;
 
-            auto rayCastAction = [&](int j)
+#if defined(_OPENMP)
+            #pragma omp for schedule(dynamic, 64)
+#endif
+            for(int64_t row = 0; row < (int64_t)size[1]*size[2]; row++)
             {
-                RasteredCube& cube = rasteredSpace[j + particuleY*CUBE_SIZE_X + particuleZ*CUBE_SIZE_X*CUBE_SIZE_Y];
+                const float y = (row % size[1]) / (float)size[1] - 0.5f;
+                const float z = (row / size[1]) / (float)size[2] - 0.5f;
+                caster.getRowCrossings(y, z, crossings);
+                const size_t rowBegin = (size_t)row*size[0];
+
+                //Voxels in [crossings[j-1], crossings[j][
+                auto voxelBoundary = [&](double x) {return (size_t)MAX(0.0, MIN((double)size[0], std::ceil((x + 0.5) * size[0])));};
+                auto spanBegin     = [&](size_t j) {return (j > 0 ? voxelBoundary(crossings[j-1].x) : 0);};
+                auto spanEnd       = [&](size_t j) {return (j < crossings.size() ? voxelBoundary(crossings[j].x) : size[0]);};
 
-                for(int triangleID : cube.triangleIDs)
+                //Open mesh: voxels outside the mesh bounding box have a winding number <= 0.5
+                const bool   openMesh = (caster.getPrecision() == SELECTION_PRECISION_WINDING_NUMBER && !caster.isClosed());
+                const bool   inBox    = (y >= caster.getMinPos().y && y <= caster.getMaxPos().y && z >= caster.getMinPos().z && z <= caster.getMaxPos().z);
+                const size_t minX     = voxelBoundary(caster.getMinPos().x);
+                const size_t maxX     = voxelBoundary(caster.getMaxPos().x + 1.0/size[0]);
+                if(openMesh && !inBox)
+                    continue;
+
+                //A voxel having j crossings at its left (or at its position) has crossings.size()-j crossings at its right:
+                //it is inside if this number is odd (same rule as MeshRayCaster::isInside), or if the crossings at its right do not cancel out (closed mesh winding number)
+                int windingNumber = 0;
+                for(int64_t j = crossings.size(); j >= 0; j--)
                 {
-                    for (int i = 0; i < 3; i++)
-                        triangle[i] = points[mesh.triangles[3*triangleID + i]];
+                    if(j < (int64_t)crossings.size())
+                        windingNumber += crossings[j].orientation;
 
-                    //Ray -- triangle intersection along the positive x axis
-                    float t;
-                    if(rayTriangleIntersection(pos, rayDir, triangle, &t))
+                    //Open mesh: the winding number of the caps only varies smoothly between two crossings. A span whose extremities and middle agree is classified at once
+                    if(openMesh)
                     {
-                        //Do not check multiple times the same triangle
-                        if (std::find(triangleIDAlready.begin(), triangleIDAlready.end(), triangleID) != triangleIDAlready.end())
+                        const size_t begin = MAX(minX, spanBegin(j));
+                        const size_t end   = MIN(maxX, spanEnd(j));
+                        if(end <= begin)
                             continue;
 
-                        nbIntersection++;
-                        triangleIDAlready.push_back(triangleID);
+                        auto isInside = [&](size_t x) {return std::fabs(windingNumber - caster.getCapWindingNumber(glm::vec3(x/(float)size[0] - 0.5f, y, z))) > 0.5;};
+                        bool first    = isInside(begin);
+                        if(end - begin <= 2 || first != isInside(end-1) || first != isInside((begin+end)/2))
+                        {
+                            for(size_t x = begin; x < end; x++)
+                                if(isInside(x))
+                                    setBitAtomic(insideWords, rowBegin + x);
+                        }
+                        else if(first)
+                            setBitRangeAtomic(insideWords, rowBegin + begin, rowBegin + end);
+                        continue;
                     }
+
+                    bool in = (caster.getPrecision() == SELECTION_PRECISION_WINDING_NUMBER ? windingNumber != 0 : (crossings.size() - j) % 2 == 1);
+                    if(in && spanBegin(j) < spanEnd(j))
+                        setBitRangeAtomic(insideWords, rowBegin + spanBegin(j), rowBegin + spanEnd(j));
                 }
-            };
+            }
+        }
+
+        applySelectionOp(mesh.op, sd, inside);
+    }
+
+    /**
+     * \brief  Apply the volumetric selection
+     *
+     * @tparam T the type of spatialPosAt
+     *
+     * \param mesh the mesh data to consider
+     * \param sd the subdataset containing the data
+     * \param spatialPosAt function to call to get the 3D position of a cell/object at k
+     */
+    template <typename T>
+    void applyVolumetricSelection(const VolumetricMesh& mesh, SubDataset* sd, const T& spatialPosAt)
+    {
+#ifdef _OPENMP
+        std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+        MeshRayCaster caster(mesh, sd);
+        if(!caster.isValid())
+            return;
+
+        const uint32_t nbData = sd->getParent()->getNbSpatialData();
+        Bitmask        inside(nbData, false);
+        uint8_t*       insideBytes = inside.data();
+
+        //Go through all the points of the dataset and check if it is inside or outside the Mesh. Each iteration owns a whole byte of the temporary mask
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(dynamic, 512)
+#endif
+        for(int64_t b = 0; b < (int64_t)inside.getNbBytes(); b++)
+        {
+            uint8_t in = 0;
+            for(uint32_t bit = 0; bit < 8 && 8*b+bit < nbData; bit++)
+                if(caster.isInside(spatialPosAt(8*b+bit)))
+                    in |= 1 << bit;
+            insideBytes[b] = in;
+        }
+
+        //Apply the boolean operation
+        applySelectionOp(mesh.op, sd, inside);
+    }
+
+    /** \brief  Apply the volumetric selection on a cloud point using its spatial index.
+     * Nodes outside the mesh bounding box are skipped, and nodes that no triangle crosses are classified with a single ray cast
+     * \param mesh the mesh data to consider
+     * \param sd the subdataset containing the data
+     * \param octree the spatial index of the cloud point */
+    static void applyVolumetricSelection_octree(const VolumetricMesh& mesh, SubDataset* sd, const CloudPointOctree& octree)
+    {
+#ifdef _OPENMP
+        std::lock_guard<std::mutex> ompLock(ompMutex);
+#endif
+        MeshRayCaster caster(mesh, sd);
+        if(!caster.isValid())
+            return;
+
+        const std::vector<CloudPointOctreeNode>& nodes   = octree.getNodes();
+        const std::vector<uint32_t>&             indices = octree.getIndices();
+        Bitmask   inside(sd->getParent()->getNbSpatialData(), false);
+        uint64_t* insideWords = inside.getWords();
+
+        /** \brief  Work to do on a node once the octree is traversed */
+        struct NodeTask
+        {
+            uint32_t nodeID;    /*!< The node to handle*/
+            bool     allInside; /*!< true: every point is inside the mesh. false: test each point*/
+        };
+
+        /** \brief  Node to visit with the triangles which may cross it */
+        struct NodeVisit
+        {
+            uint32_t              nodeID;    /*!< The node to visit*/
+            std::vector<uint32_t> triangles; /*!< The triangles whose bounding box overlaps the parent node*/
+        };
+
+        std::vector<NodeTask>  tasks;
+        std::vector<NodeVisit> stack;
+        if(nodes.size())
+        {
+            stack.push_back({0, std::vector<uint32_t>(caster.getNbTriangles())});
+            for(uint32_t i = 0; i < caster.getNbTriangles(); i++)
+                stack.back().triangles[i] = i;
+        }
+
+        //Traverse the octree and classify the nodes
+        while(stack.size())
+        {
+            NodeVisit visit = std::move(stack.back());
+            stack.pop_back();
+            const CloudPointOctreeNode& node = nodes[visit.nodeID];
+
+            //Outside the mesh bounding box: every point is outside the mesh
+            bool overlap = true;
+            for(uint8_t j = 0; j < 3 && overlap; j++)
+                overlap = (node.maxPos[j] >= caster.getMinPos()[j] && node.minPos[j] <= caster.getMaxPos()[j]);
+            if(!overlap)
+                continue;
 
-            //Select the most efficient direction (i.e., less test)
-            if(2*rasteredSpace[particuleX    + particuleY*CUBE_SIZE_X + particuleZ*CUBE_SIZE_X*CUBE_SIZE_Y].maxNbTriangle - 
-                 rasteredSpace[CUBE_SIZE_X-1 + particuleY*CUBE_SIZE_X + particuleZ*CUBE_SIZE_X*CUBE_SIZE_Y].maxNbTriangle > 0)
-            { 
-                for(int j = particuleX; j < CUBE_SIZE_X; j++)
-                    rayCastAction(j);
+            std::vector<uint32_t> triangles;
+            for(uint32_t t : visit.triangles)
+                if(caster.triangleOverlaps(t, node.minPos, node.maxPos))
+                    triangles.push_back(t);
+
+            //No triangle crosses this node: all its points share the same status
+            if(triangles.empty())
+            {
+                if(caster.isInside(octree.getPosition(indices[node.begin])))
+                    tasks.push_back({visit.nodeID, true});
             }
+            else if(node.isLeaf)
+                tasks.push_back({visit.nodeID, false});
             else
             {
-                rayDir.x *= -1.0f;
-                for(int j = particuleX; j >= 0; j--)
-                    rayCastAction(j);
+                for(uint32_t c = 0; c < 8; c++)
+                    if(node.children[c] >= 0)
+                        stack.push_back({(uint32_t)node.children[c], triangles});
             }
+        }
 
-            //Apply the boolean operation
-            switch (mesh.op)
-            {
-                case SELECTION_OP_UNION:
-                    sd->setVolumetricMaskAt(k, sd->getVolumetricMaskAt(k) || (nbIntersection % 2 == 1));
-                    break;
-                case SELECTION_OP_INTER:
-                    sd->setVolumetricMaskAt(k, sd->getVolumetricMaskAt(k) && (nbIntersection % 2 == 1));
-                    break;
-                case SELECTION_OP_MINUS:
-                    sd->setVolumetricMaskAt(k, sd->getVolumetricMaskAt(k) && !(nbIntersection % 2 == 1));
-                    break;
-                default:
-                    break;
-            }
+        //Handle the nodes in parallel. Nodes do not share points, but their points may share bytes of the mask
+#if defined(_OPENMP)
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for(int64_t i = 0; i < (int64_t)tasks.size(); i++)
+        {
+            const CloudPointOctreeNode& node = nodes[tasks[i].nodeID];
+            for(uint32_t j = node.begin; j < node.end; j++)
+                if(tasks[i].allInside || caster.isInside(octree.getPosition(indices[j])))
+                    setBitAtomic(insideWords, indices[j]);
         }
 
-        delete[] points;
-        delete[] rasteredSpace;
+        applySelectionOp(mesh.op, sd, inside);
     }
 
     void applyVolumetricSelection_cloudPoint(const VolumetricMesh& mesh, SubDataset* sd)
     {
         if(!sd->getParent()->areValuesLoaded())
             return;
-        const float* pos = ((CloudPointDataset*)sd->getParent())->getPointPositions();
+        CloudPointDataset* cloud = (CloudPointDataset*)sd->getParent();
+        if(cloud->getSpatialIndex())
+        {
+            applyVolumetricSelection_octree(mesh, sd, *cloud->getSpatialIndex());
+            return;
+        }
+
+        const float* pos = cloud->getPointPositions();
         applyVolumetricSelection(mesh, sd, [pos](uint32_t k) {return glm::vec3(pos[3*k + 0], pos[3*k + 1], pos[3*k + 2]);});
     }
 
@@ -250,12 +1026,7 @@ namespace sereno
         {
             case VTK_STRUCTURED_POINTS:
             {
-                applyVolumetricSelection(mesh, sd, [vtkParser](uint32_t k) 
-                {
-                    return glm::vec3(k%vtkParser->getStructuredPointsDescriptor().size[0] / (float)vtkParser->getStructuredPointsDescriptor().size[0],
-                                     (k/vtkParser->getStructuredPointsDescriptor().size[0]) % vtkParser->getStructuredPointsDescriptor().size[1] / (float)vtkParser->getStructuredPointsDescriptor().size[1],
-                                     k/(vtkParser->getStructuredPointsDescriptor().size[0]*vtkParser->getStructuredPointsDescriptor().size[1]) / (float)vtkParser->getStructuredPointsDescriptor().size[2]) - glm::vec3(0.5f, 0.5f, 0.5f);
-                });
+                applyVolumetricSelection_scanline(mesh, sd, vtkParser->getStructuredPointsDescriptor().size);
                 break;
             }
             default:
@@ -263,4 +1034,65 @@ namespace sereno
                 return;
         }
     }
+
+    bool buildExtrudedLassoMesh(const std::vector<glm::vec2>& polygon, const std::vector<uint32_t>& holeIndices, const glm::mat4& viewMatrix,
+                                float minDepth, float maxDepth, bool perspective, VolumetricMesh& mesh)
+    {
+        mesh.points.clear();
+        mesh.triangles.clear();
+
+        const uint32_t n = polygon.size();
+        if(n < 3 || !(maxDepth > minDepth))
+            return false;
+
+        //Near cap: the triangulation is written directly into the mesh. Its triangles are counter-clockwise, i.e., facing the view
+        const size_t nbCapTriangles = triangulate(polygon, holeIndices, mesh.triangles);
+        if(nbCapTriangles == 0)
+            return false;
+
+        //Near points are [0, n[, far points are [n, 2n[
+        const glm::mat4 invView = glm::inverse(viewMatrix);
+        mesh.points.resize(2*n);
+        for(uint32_t i = 0; i < n; i++)
+        {
+            glm::vec2 nearPos = (perspective ? polygon[i]*minDepth : polygon[i]);
+            glm::vec2 farPos  = (perspective ? polygon[i]*maxDepth : polygon[i]);
+            mesh.points[i]   = invView * glm::vec4(nearPos.x, nearPos.y, -minDepth, 1.0f);
+            mesh.points[n+i] = invView * glm::vec4(farPos.x,  farPos.y,  -maxDepth, 1.0f);
+        }
+
+        //Far cap: the near cap reversed. Reserving first keeps the references to mesh.triangles valid while appending
+        mesh.triangles.reserve(6*nbCapTriangles + 6*n);
+        for(size_t i = 0; i < nbCapTriangles; i++)
+        {
+            mesh.triangles.push_back(n + mesh.triangles[3*i+2]);
+            mesh.triangles.push_back(n + mesh.triangles[3*i+1]);
+            mesh.triangles.push_back(n + mesh.triangles[3*i+0]);
+        }
+
+        //Side quads. Their normals point outward if the outer ring is counter-clockwise and the holes are clockwise
+        for(size_t r = 0; r <= holeIndices.size(); r++)
+        {
+            uint32_t start = (r == 0 ? 0 : holeIndices[r-1]);
+            uint32_t end   = (r < holeIndices.size() ? holeIndices[r] : n);
+            if(end <= start)
+                continue;
+
+            double ringArea = 0.0;
+            for(uint32_t i = start, j = end-1; i < end; j = i++)
+                ringArea += (double)polygon[j].x*polygon[i].y - (double)polygon[i].x*polygon[j].y;
+            const bool reverse = ((ringArea > 0) != (r == 0));
+
+            for(uint32_t i = start, j = end-1; i < end; j = i++)
+            {
+                uint32_t a = (reverse ? i : j);
+                uint32_t b = (reverse ? j : i);
+                uint32_t quad[6] = {a, n+a, b,
+                                    b, n+a, n+b};
+                mesh.triangles.insert(mesh.triangles.end(), quad, quad+6);
+            }
+        }
+
+        return true;
+    }
 }